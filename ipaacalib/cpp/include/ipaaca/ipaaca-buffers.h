@@ -39,12 +39,98 @@
 #endif
 
 
+/// Hash function for IUId (mixes both halves, counter-mode UIDs differ in the low bits only)
+struct IUIdHash {//{{{
+	IPAACA_HEADER_EXPORT inline size_t operator()(const IUId& uid) const
+	{
+		uint64_t h = (uid.high ^ (uid.low * 0x9e3779b97f4a7c15ULL));
+		h ^= h >> 31;
+		h *= 0xbf58476d1ce4e5b9ULL;
+		h ^= h >> 29;
+		return (size_t) h;
+	}
+};//}}}
+
+/** \brief Map IUId -> IU for concurrent use. <b>Internal type</b>.
+ *
+ * Split into IPAACA_IU_STORE_SHARDS hash maps with a reader/writer lock each:
+ * lookups of different IUs and concurrent lookups of the same IU do not block
+ * each other. No references into the maps are handed out; for_each() visits
+ * one shard at a time, so it does not see a single consistent state of the
+ * whole store.
+ */
+template<class T> class ShardedIUStore//{{{
+{
+	public:
+		typedef boost::shared_ptr<T> value_ptr;
+	protected:
+		struct Shard {
+			mutable boost::shared_mutex mutex;
+			std::unordered_map<IUId, value_ptr, IUIdHash> items;
+		};
+		IPAACA_MEMBER_VAR_EXPORT Shard _shards[IPAACA_IU_STORE_SHARDS];
+		IPAACA_HEADER_EXPORT inline Shard& _shard(const IUId& uid) { return _shards[IUIdHash()(uid) % IPAACA_IU_STORE_SHARDS]; }
+		IPAACA_HEADER_EXPORT inline const Shard& _shard(const IUId& uid) const { return _shards[IUIdHash()(uid) % IPAACA_IU_STORE_SHARDS]; }
+	public:
+		/// The stored IU (null if absent)
+		IPAACA_HEADER_EXPORT inline value_ptr find(const IUId& uid) const
+		{
+			const Shard& shard = _shard(uid);
+			boost::shared_lock<boost::shared_mutex> lock(shard.mutex);
+			auto it = shard.items.find(uid);
+			return (it == shard.items.end()) ? value_ptr() : it->second;
+		}
+		IPAACA_HEADER_EXPORT inline bool contains(const IUId& uid) const { return (bool) find(uid); }
+		/// Add an IU unless one with this id is stored already (then false)
+		IPAACA_HEADER_EXPORT inline bool insert(const IUId& uid, value_ptr iu)
+		{
+			Shard& shard = _shard(uid);
+			boost::unique_lock<boost::shared_mutex> lock(shard.mutex);
+			return shard.items.insert(std::make_pair(uid, iu)).second;
+		}
+		/// Add or replace an IU
+		IPAACA_HEADER_EXPORT inline void set(const IUId& uid, value_ptr iu)
+		{
+			Shard& shard = _shard(uid);
+			boost::unique_lock<boost::shared_mutex> lock(shard.mutex);
+			shard.items[uid] = iu;
+		}
+		/// Remove an IU, returning it (null if absent)
+		IPAACA_HEADER_EXPORT inline value_ptr erase(const IUId& uid)
+		{
+			Shard& shard = _shard(uid);
+			boost::unique_lock<boost::shared_mutex> lock(shard.mutex);
+			auto it = shard.items.find(uid);
+			if (it == shard.items.end()) return value_ptr();
+			value_ptr iu = it->second;
+			shard.items.erase(it);
+			return iu;
+		}
+		IPAACA_HEADER_EXPORT inline size_t size() const
+		{
+			size_t n = 0;
+			for (auto& shard: _shards) {
+				boost::shared_lock<boost::shared_mutex> lock(shard.mutex);
+				n += shard.items.size();
+			}
+			return n;
+		}
+		/// Call f(iu) for all stored IUs (with the lock of one shard held: f must not modify the store)
+		template<typename F> void for_each(F f) const
+		{
+			for (auto& shard: _shards) {
+				boost::shared_lock<boost::shared_mutex> lock(shard.mutex);
+				for (auto& kv: shard.items) f(kv.second);
+			}
+		}
+};//}}}
+
 /// Store for local IUs (used in OutputBuffer)
-class IUStore: public std::map<std::string, boost::shared_ptr<IU> >
+class IUStore: public ShardedIUStore<IU>
 {
 };
 /// Store for RemotePushIUs (used in InputBuffer)
-class RemotePushIUStore: public std::map<std::string, boost::shared_ptr<RemotePushIU> >
+class RemotePushIUStore: public ShardedIUStore<RemotePushIU>
 {
 };
 
@@ -58,6 +144,7 @@ class SmartLinkMap {//{{{
 	friend class IU;
 	friend class IUConverter;
 	friend class MessageConverter;
+	friend class LoopbackHub;
 	public:
 		IPAACA_HEADER_EXPORT const LinkSet& get_links(const std::string& key);
 		IPAACA_HEADER_EXPORT const LinkMap& get_all_links();
@@ -73,6 +160,106 @@ class SmartLinkMap {//{{{
 /// The empty link set is returned if undefined links are read for an IU.
 IPAACA_MEMBER_VAR_EXPORT const LinkSet EMPTY_LINK_SET;
 
+/** \brief Result of a buffer query (see Buffer::query_category() etc.)
+ *
+ * An immutable snapshot of the matching IUs, ordered by IU id. Queries do not
+ * copy: the result shares the list kept by the index, which copies it on the
+ * next change only while a result still refers to it. Later changes of the
+ * buffer are not reflected.
+ */
+class IUQueryResult {//{{{
+	public:
+		typedef std::vector<boost::shared_ptr<IUInterface> > container_type;
+		typedef container_type::const_iterator const_iterator;
+		typedef const_iterator iterator;
+	protected:
+		IPAACA_MEMBER_VAR_EXPORT std::shared_ptr<const container_type> _ius;
+	public:
+		IPAACA_HEADER_EXPORT inline explicit IUQueryResult(std::shared_ptr<const container_type> ius): _ius(ius) { }
+		IPAACA_HEADER_EXPORT inline const_iterator begin() const { return _ius->begin(); }
+		IPAACA_HEADER_EXPORT inline const_iterator end() const { return _ius->end(); }
+		IPAACA_HEADER_EXPORT inline size_t size() const { return _ius->size(); }
+		IPAACA_HEADER_EXPORT inline bool empty() const { return _ius->empty(); }
+		IPAACA_HEADER_EXPORT inline const boost::shared_ptr<IUInterface>& operator[](size_t index) const { return (*_ius)[index]; }
+};//}}}
+
+/** \brief Secondary indexes over the stored IUs of a buffer. <b>Internal type</b>.
+ *
+ * Kept up to date by the buffer when IUs are stored, removed, committed,
+ * retracted or have their links changed. Each bucket keeps its IUs in a
+ * sorted list that queries hand out as is (copy-on-write: a change copies
+ * the list first if a result is still held). Updates for IUs that are not
+ * indexed (e.g. Messages) are ignored.
+ *
+ * Links are indexed in reverse (target -> linking IUs), per link type and
+ * for all types together.
+ */
+class IUIndex {//{{{
+	protected:
+		typedef std::pair<InternedString, std::string> TypedLink; ///< (link type, target uid)
+		struct Bucket {
+			std::shared_ptr<IUQueryResult::container_type> ius; ///< ordered by IU id, shared with results
+			Bucket(): ius(std::make_shared<IUQueryResult::container_type>()) { }
+		};
+		struct Entry {
+			boost::shared_ptr<IUInterface> iu;
+			InternedString category;
+			InternedString owner_name;
+			IUState state;
+			LinkMap links; ///< as indexed
+		};
+		IPAACA_MEMBER_VAR_EXPORT Lock _lock;
+		IPAACA_MEMBER_VAR_EXPORT std::unordered_map<IUId, Entry, IUIdHash> _entries;
+		IPAACA_MEMBER_VAR_EXPORT Bucket _all;
+		IPAACA_MEMBER_VAR_EXPORT std::map<InternedString, Bucket> _by_category;
+		IPAACA_MEMBER_VAR_EXPORT std::map<InternedString, Bucket> _by_owner;
+		IPAACA_MEMBER_VAR_EXPORT Bucket _by_state[3];
+		IPAACA_MEMBER_VAR_EXPORT std::map<std::string, Bucket> _by_link_target;
+		IPAACA_MEMBER_VAR_EXPORT std::map<TypedLink, Bucket> _by_typed_link;
+		IPAACA_HEADER_EXPORT static IUState _state_of(IUInterface* iu);
+		IPAACA_HEADER_EXPORT static LinkSet _link_targets_of(const LinkMap& links);
+		IPAACA_HEADER_EXPORT static bool _has_link(const LinkMap& links, const std::string& type, const std::string& target);
+		/// update the link buckets of an entry to a new link map
+		IPAACA_HEADER_EXPORT void _index_links(const IUId& uid, Entry& entry, const LinkMap& links);
+		/// IUs linking to target_uid (with a link of link_type, unless empty); null if none
+		IPAACA_HEADER_EXPORT const Bucket* _linking_bucket(const std::string& target_uid, const InternedString& link_type) const;
+		/// copy the IU list of a bucket if results still refer to it
+		IPAACA_HEADER_EXPORT static void _make_writable(Bucket& bucket);
+		IPAACA_HEADER_EXPORT static void _add(Bucket& bucket, const IUId& uid, const boost::shared_ptr<IUInterface>& iu);
+		IPAACA_HEADER_EXPORT static void _remove(Bucket& bucket, const IUId& uid);
+		/// remove from a keyed bucket, dropping the bucket once empty
+		template<class K> static void _remove(std::map<K, Bucket>& buckets, const K& key, const IUId& uid)
+		{
+			auto it = buckets.find(key);
+			if (it == buckets.end()) return;
+			_remove(it->second, uid);
+			if (it->second.ius->empty()) buckets.erase(it);
+		}
+		IPAACA_HEADER_EXPORT static IUQueryResult _result(Bucket& bucket);
+		template<class K> static IUQueryResult _result(std::map<K, Bucket>& buckets, const K& key)
+		{
+			auto it = buckets.find(key);
+			return (it == buckets.end()) ? _empty_result() : _result(it->second);
+		}
+		IPAACA_HEADER_EXPORT static IUQueryResult _empty_result();
+	public:
+		/// Index an IU (again, if it was indexed already)
+		IPAACA_HEADER_EXPORT void insert(boost::shared_ptr<IUInterface> iu);
+		IPAACA_HEADER_EXPORT void erase(const IUId& uid);
+		/// Re-read committed / retracted flags of an IU
+		IPAACA_HEADER_EXPORT void update_state(IUInterface* iu);
+		/// Re-read the links of an IU
+		IPAACA_HEADER_EXPORT void update_links(IUInterface* iu);
+		IPAACA_HEADER_EXPORT IUQueryResult all();
+		IPAACA_HEADER_EXPORT IUQueryResult by_category(const InternedString& category);
+		IPAACA_HEADER_EXPORT IUQueryResult by_owner(const InternedString& owner_name);
+		IPAACA_HEADER_EXPORT IUQueryResult by_state(IUState state);
+		IPAACA_HEADER_EXPORT IUQueryResult linking_to(const std::string& target_uid);
+		IPAACA_HEADER_EXPORT IUQueryResult linking_to(const std::string& target_uid, const InternedString& link_type);
+		/// IUs linking to target_uid directly or indirectly, at most max_depth links away, nearest first (breadth-first)
+		IPAACA_HEADER_EXPORT IUQueryResult linking_to_closure(const std::string& target_uid, const InternedString& link_type, size_t max_depth);
+};//}}}
+
 /// Configuration object that can be passed to Buffer constructors.
 class BufferConfiguration//{{{
 {
@@ -80,16 +267,68 @@ class BufferConfiguration//{{{
 		IPAACA_MEMBER_VAR_EXPORT std::string _basename;
 		IPAACA_MEMBER_VAR_EXPORT std::vector<std::string> _category_interests;
 		IPAACA_MEMBER_VAR_EXPORT std::string _channel;
+		IPAACA_MEMBER_VAR_EXPORT bool _async_publish;
+		IPAACA_MEMBER_VAR_EXPORT size_t _publish_queue_capacity;
+		IPAACA_MEMBER_VAR_EXPORT unsigned int _batch_window_ms;
+		IPAACA_MEMBER_VAR_EXPORT size_t _batch_max_events;
+		IPAACA_MEMBER_VAR_EXPORT size_t _batch_max_bytes;
+		IPAACA_MEMBER_VAR_EXPORT size_t _retention_max_ius;
+		IPAACA_MEMBER_VAR_EXPORT size_t _retention_max_bytes;
+		IPAACA_MEMBER_VAR_EXPORT unsigned int _retention_ttl_after_commit_ms;
+		IPAACA_MEMBER_VAR_EXPORT unsigned int _retention_ttl_after_retract_ms;
+		IPAACA_MEMBER_VAR_EXPORT bool _retention_lru;
+		IPAACA_MEMBER_VAR_EXPORT size_t _retention_tombstones;
+		IPAACA_MEMBER_VAR_EXPORT unsigned int _retire_after_commit_ms;
+		IPAACA_MEMBER_VAR_EXPORT unsigned int _retire_after_inactivity_ms;
 	public:
-		IPAACA_HEADER_EXPORT inline BufferConfiguration(const std::string& basename): _basename(basename), _channel(__ipaaca_static_option_default_channel) { }
+		IPAACA_HEADER_EXPORT inline BufferConfiguration(const std::string& basename): _basename(basename), _channel(__ipaaca_static_option_default_channel), _async_publish(false), _publish_queue_capacity(1024), _batch_window_ms(0), _batch_max_events(64), _batch_max_bytes(65536), _retention_max_ius(0), _retention_max_bytes(0), _retention_ttl_after_commit_ms(0), _retention_ttl_after_retract_ms(0), _retention_lru(false), _retention_tombstones(4096), _retire_after_commit_ms(0), _retire_after_inactivity_ms(0) { }
 		IPAACA_HEADER_EXPORT inline const std::string& get_basename() const { return _basename; }
 		IPAACA_HEADER_EXPORT inline const std::vector<std::string>& get_category_interests() const { return _category_interests; }
 		IPAACA_HEADER_EXPORT inline const std::string& get_channel() const { return _channel; }
+		IPAACA_HEADER_EXPORT inline bool get_async_publish() const { return _async_publish; }
+		IPAACA_HEADER_EXPORT inline size_t get_publish_queue_capacity() const { return _publish_queue_capacity; }
+		IPAACA_HEADER_EXPORT inline unsigned int get_batch_window_ms() const { return _batch_window_ms; }
+		IPAACA_HEADER_EXPORT inline size_t get_batch_max_events() const { return _batch_max_events; }
+		IPAACA_HEADER_EXPORT inline size_t get_batch_max_bytes() const { return _batch_max_bytes; }
+		IPAACA_HEADER_EXPORT inline size_t get_retention_max_ius() const { return _retention_max_ius; }
+		IPAACA_HEADER_EXPORT inline size_t get_retention_max_bytes() const { return _retention_max_bytes; }
+		IPAACA_HEADER_EXPORT inline unsigned int get_retention_ttl_after_commit_ms() const { return _retention_ttl_after_commit_ms; }
+		IPAACA_HEADER_EXPORT inline unsigned int get_retention_ttl_after_retract_ms() const { return _retention_ttl_after_retract_ms; }
+		IPAACA_HEADER_EXPORT inline bool get_retention_lru() const { return _retention_lru; }
+		IPAACA_HEADER_EXPORT inline size_t get_retention_tombstones() const { return _retention_tombstones; }
+		IPAACA_HEADER_EXPORT inline unsigned int get_retire_after_commit_ms() const { return _retire_after_commit_ms; }
+		IPAACA_HEADER_EXPORT inline unsigned int get_retire_after_inactivity_ms() const { return _retire_after_inactivity_ms; }
 	public:
 		// setters, initialization helpers
 		IPAACA_HEADER_EXPORT inline BufferConfiguration& set_basename(const std::string& basename) { _basename = basename; return *this; }
 		IPAACA_HEADER_EXPORT inline BufferConfiguration& add_category_interest(const std::string& category) { _category_interests.push_back(category); return *this; }
 		IPAACA_HEADER_EXPORT inline BufferConfiguration& set_channel(const std::string& channel) { _channel = channel; return *this; }
+		/// OutputBuffer only: send events from a background thread instead of the calling thread
+		IPAACA_HEADER_EXPORT inline BufferConfiguration& set_async_publish(bool async_publish) { _async_publish = async_publish; return *this; }
+		/// OutputBuffer only: max. number of events waiting for the sender thread (callers block when full)
+		IPAACA_HEADER_EXPORT inline BufferConfiguration& set_publish_queue_capacity(size_t capacity) { _publish_queue_capacity = capacity; return *this; }
+		/// OutputBuffer only: combine events of a category sent within this many ms into one frame (0: off)
+		IPAACA_HEADER_EXPORT inline BufferConfiguration& set_batch_window_ms(unsigned int window_ms) { _batch_window_ms = window_ms; return *this; }
+		/// OutputBuffer only: send a batch frame early once it holds this many events
+		IPAACA_HEADER_EXPORT inline BufferConfiguration& set_batch_max_events(size_t max_events) { _batch_max_events = max_events; return *this; }
+		/// OutputBuffer only: send a batch frame early once it holds this many serialized bytes
+		IPAACA_HEADER_EXPORT inline BufferConfiguration& set_batch_max_bytes(size_t max_bytes) { _batch_max_bytes = max_bytes; return *this; }
+		/// InputBuffer only: keep at most this many remote IUs, evicting the oldest (0: unlimited)
+		IPAACA_HEADER_EXPORT inline BufferConfiguration& set_retention_max_ius(size_t max_ius) { _retention_max_ius = max_ius; return *this; }
+		/// InputBuffer only: keep remote IUs of at most about this many bytes in total, evicting the oldest (0: unlimited)
+		IPAACA_HEADER_EXPORT inline BufferConfiguration& set_retention_max_bytes(size_t max_bytes) { _retention_max_bytes = max_bytes; return *this; }
+		/// InputBuffer only: evict remote IUs this many ms after their commission (0: keep)
+		IPAACA_HEADER_EXPORT inline BufferConfiguration& set_retention_ttl_after_commit_ms(unsigned int ttl_ms) { _retention_ttl_after_commit_ms = ttl_ms; return *this; }
+		/// InputBuffer only: evict remote IUs this many ms after their retraction (0: keep)
+		IPAACA_HEADER_EXPORT inline BufferConfiguration& set_retention_ttl_after_retract_ms(unsigned int ttl_ms) { _retention_ttl_after_retract_ms = ttl_ms; return *this; }
+		/// InputBuffer only: for the count and byte limits, evict the least recently used (updated or looked up) IU instead of the oldest one
+		IPAACA_HEADER_EXPORT inline BufferConfiguration& set_retention_lru(bool lru) { _retention_lru = lru; return *this; }
+		/// InputBuffer only: remember this many evicted IUs, whose later updates are then ignored instead of causing resend requests
+		IPAACA_HEADER_EXPORT inline BufferConfiguration& set_retention_tombstones(size_t tombstones) { _retention_tombstones = tombstones; return *this; }
+		/// OutputBuffer only: retract and drop own IUs this many ms after their commission (0: off)
+		IPAACA_HEADER_EXPORT inline BufferConfiguration& set_retire_after_commit_ms(unsigned int grace_ms) { _retire_after_commit_ms = grace_ms; return *this; }
+		/// OutputBuffer only: retract and drop own IUs that were not changed for this many ms (0: off)
+		IPAACA_HEADER_EXPORT inline BufferConfiguration& set_retire_after_inactivity_ms(unsigned int inactivity_ms) { _retire_after_inactivity_ms = inactivity_ms; return *this; }
 };//}}}
 
 /// Builder object for BufferConfiguration, not required for C++ [DEPRECATED]
@@ -133,16 +372,16 @@ class IUEventHandler {//{{{
 		IPAACA_MEMBER_VAR_EXPORT IUEventHandlerFunction _function;
 		IPAACA_MEMBER_VAR_EXPORT IUEventType _event_mask;
 		IPAACA_MEMBER_VAR_EXPORT bool _for_all_categories;
-		IPAACA_MEMBER_VAR_EXPORT std::set<std::string> _categories;
+		IPAACA_MEMBER_VAR_EXPORT std::set<InternedString> _categories; // interned: matching compares handles only
 	protected:
-		IPAACA_HEADER_EXPORT inline bool _condition_met(IUEventType event_type, const std::string& category)
+		IPAACA_HEADER_EXPORT inline bool _condition_met(IUEventType event_type, const InternedString& category)
 		{
 			return ((_event_mask&event_type)!=0) && (_for_all_categories || (_categories.count(category)>0));
 		}
 	public:
 		IPAACA_HEADER_EXPORT IUEventHandler(IUEventHandlerFunction function, IUEventType event_mask, const std::string& category);
 		IPAACA_HEADER_EXPORT IUEventHandler(IUEventHandlerFunction function, IUEventType event_mask, const std::set<std::string>& categories);
-		IPAACA_HEADER_EXPORT void call(Buffer* buffer, boost::shared_ptr<IUInterface> iu, bool local, IUEventType event_type, const std::string& category);
+		IPAACA_HEADER_EXPORT void call(Buffer* buffer, boost::shared_ptr<IUInterface> iu, bool local, IUEventType event_type, const InternedString& category);
 	typedef boost::shared_ptr<IUEventHandler> ptr;
 };//}}}
 
@@ -152,6 +391,7 @@ class IUEventHandler {//{{{
  * \b Note: This class is never instantiated directly (use OutputBuffer and InputBuffer, respectively).
  */
 class Buffer { //: public boost::enable_shared_from_this<Buffer> {//{{{
+	friend class IUInterface;
 	friend class IU;
 	friend class RemotePushIU;
 	friend class CallbackIUPayloadUpdate;
@@ -162,10 +402,14 @@ class Buffer { //: public boost::enable_shared_from_this<Buffer> {//{{{
 		IPAACA_MEMBER_VAR_EXPORT std::string _uuid;
 		IPAACA_MEMBER_VAR_EXPORT std::string _basename;
 		IPAACA_MEMBER_VAR_EXPORT std::string _unique_name;
+		IPAACA_MEMBER_VAR_EXPORT InternedString _interned_unique_name; // for comparing against writer names
 		IPAACA_MEMBER_VAR_EXPORT std::string _id_prefix;
 		IPAACA_MEMBER_VAR_EXPORT std::string _channel;
 		IPAACA_MEMBER_VAR_EXPORT std::vector<IUEventHandler::ptr> _event_handlers;
+		IPAACA_MEMBER_VAR_EXPORT IUIndex _iu_index; ///< secondary indexes over the stored IUs (for the query functions)
 	protected:
+		/// (called by IUs of this buffer after changing their links)
+		IPAACA_HEADER_EXPORT inline void _iu_links_changed(IUInterface* iu) { _iu_index.update_links(iu); }
 		IPAACA_HEADER_EXPORT _IPAACA_ABSTRACT_ virtual void _publish_iu_resend(boost::shared_ptr<IU> iu, const std::string& hidden_scope_name) = 0;
 
 
@@ -177,7 +421,7 @@ class Buffer { //: public boost::enable_shared_from_this<Buffer> {//{{{
 			_allocate_unique_name(basename, function);
 			_channel = __ipaaca_static_option_default_channel;
 		}
-		IPAACA_HEADER_EXPORT void call_iu_event_handlers(boost::shared_ptr<IUInterface> iu, bool local, IUEventType event_type, const std::string& category);
+		IPAACA_HEADER_EXPORT void call_iu_event_handlers(boost::shared_ptr<IUInterface> iu, bool local, IUEventType event_type, const InternedString& category);
 	public:
 		IPAACA_HEADER_EXPORT virtual inline ~Buffer() { }
 		IPAACA_HEADER_EXPORT inline const std::string& unique_name() { return _unique_name; }
@@ -227,11 +471,68 @@ class Buffer { //: public boost::enable_shared_from_this<Buffer> {//{{{
 		IPAACA_HEADER_EXPORT void register_handler(IUEventHandlerFunction function, IUEventType event_mask = IU_ALL_EVENTS, const std::string& category="");
 		IPAACA_HEADER_EXPORT _IPAACA_ABSTRACT_ virtual boost::shared_ptr<IUInterface> get(const std::string& iu_uid) = 0;
 		IPAACA_HEADER_EXPORT _IPAACA_ABSTRACT_ virtual std::set<boost::shared_ptr<IUInterface> > get_ius() = 0;
+		/** \brief Query functions: the stored IUs with some property, from incrementally maintained indexes
+		 *
+		 * Results are shared snapshots (see IUQueryResult): a query costs no
+		 * more than a lookup. Messages are not stored, hence never returned.
+		 */
+		IPAACA_HEADER_EXPORT inline IUQueryResult query_all() { return _iu_index.all(); }
+		/// Stored IUs of a category
+		IPAACA_HEADER_EXPORT inline IUQueryResult query_category(const std::string& category) { return _iu_index.by_category(InternedString(category)); }
+		/// Stored IUs owned by a buffer (by its unique name, see IUInterface::owner_name())
+		IPAACA_HEADER_EXPORT inline IUQueryResult query_owner(const std::string& owner_name) { return _iu_index.by_owner(InternedString(owner_name)); }
+		/// Stored IUs that are open, committed or retracted
+		IPAACA_HEADER_EXPORT inline IUQueryResult query_state(IUState state) { return _iu_index.by_state(state); }
+		/// Stored IUs that have a link (of any type) to the IU target_uid
+		IPAACA_HEADER_EXPORT inline IUQueryResult query_linking_to(const std::string& target_uid) { return _iu_index.linking_to(target_uid); }
+		/// Stored IUs that have a link of type link_type (e.g. "grounded_in") to the IU target_uid
+		IPAACA_HEADER_EXPORT inline IUQueryResult query_linking_to(const std::string& target_uid, const std::string& link_type) { return _iu_index.linking_to(target_uid, InternedString(link_type)); }
+		/** \brief Stored IUs that link to the IU target_uid directly, or via other stored IUs
+		 *
+		 * Follows links of type link_type (all types if empty) backwards, at most
+		 * max_depth steps (1 is the same as query_linking_to()). Every IU is
+		 * returned once, nearest first; cycles are harmless. This is a
+		 * fresh result, not a cached snapshot.
+		 */
+		IPAACA_HEADER_EXPORT inline IUQueryResult query_linking_to_closure(const std::string& target_uid, const std::string& link_type, size_t max_depth) { return _iu_index.linking_to_closure(target_uid, InternedString(link_type), max_depth); }
 
 		IPAACA_HEADER_EXPORT inline const std::string& channel() { return _channel; }
 };
 //}}}
 
+/// Event waiting for the sender thread of an OutputBuffer in asynchronous mode
+class PendingPublication {//{{{
+	public:
+		IPAACA_MEMBER_VAR_EXPORT std::string category;
+		IPAACA_MEMBER_VAR_EXPORT std::string type;
+		IPAACA_MEMBER_VAR_EXPORT boost::shared_ptr<void> data;
+		IPAACA_MEMBER_VAR_EXPORT bool private_scope;
+};//}}}
+
+/// Remote write collected by an InputBuffer between begin_remote_write_batch() and flush_remote_write_batch()
+class PendingRemoteWrite {//{{{
+	public:
+		IPAACA_MEMBER_VAR_EXPORT std::string type;
+		IPAACA_MEMBER_VAR_EXPORT boost::shared_ptr<void> data;
+		IPAACA_MEMBER_VAR_EXPORT boost::shared_ptr<std::promise<revision_t> > result;
+		IPAACA_MEMBER_VAR_EXPORT boost::weak_ptr<IUInterface> iu;
+};//}}}
+
+/// Serialized events of one category collected by an OutputBuffer in batching mode
+class PendingEventBatch {//{{{
+	public:
+		IPAACA_MEMBER_VAR_EXPORT boost::shared_ptr<protobuf::IUEventBatch> frame;
+		IPAACA_MEMBER_VAR_EXPORT size_t bytes;
+		IPAACA_MEMBER_VAR_EXPORT boost::system_time deadline;
+};//}}}
+
+/// Retention bookkeeping of an InputBuffer for one remote IU
+class RetainedIUInfo {//{{{
+	public:
+		IPAACA_MEMBER_VAR_EXPORT std::list<IUId>::iterator order_position; ///< position in the eviction order
+		IPAACA_MEMBER_VAR_EXPORT size_t bytes; ///< estimated memory use
+};//}}}
+
 /**
  * \brief A buffer to which own IUs can be added to publish them
  *
@@ -242,6 +543,20 @@ class Buffer { //: public boost::enable_shared_from_this<Buffer> {//{{{
  * Use OutputBuffer::remove() to remove (= retract) an IU.
  *
  * Use Buffer::register_handler() to register a handler that will respond to remote changes to own published IUs.
+ *
+ * With BufferConfiguration::set_async_publish(), all sending (serialization
+ * and transport) is done by a sender thread of the buffer, in the original order.
+ * IUs are captured in their state at the time of the call. Use flush() to wait
+ * until everything queued so far has been sent.
+ *
+ * With BufferConfiguration::set_batch_window_ms(), events are not sent one by one,
+ * but per category collected into frames that are sent when the window has
+ * elapsed (or the event / byte limits are reached). Receivers unpack the
+ * frames in order. Batch frames are only understood by the C++ implementation
+ * at this point. flush() also sends out all pending frames.
+ *
+ * With BufferConfiguration::set_retire_after_commit_ms() or set_retire_after_inactivity_ms(),
+ * IUs are retracted and dropped from the buffer automatically by a background thread.
  */
 class OutputBuffer: public Buffer { //, public boost::enable_shared_from_this<OutputBuffer>  {//{{{
 	friend class IU;
@@ -251,11 +566,63 @@ class OutputBuffer: public Buffer { //, public boost::enable_shared_from_this<Ou
 	protected:
 		IPAACA_MEMBER_VAR_EXPORT IUStore _iu_store;
 		IPAACA_MEMBER_VAR_EXPORT Lock _iu_id_counter_lock;
+		// asynchronous publishing
+		IPAACA_MEMBER_VAR_EXPORT bool _async_publish;
+		IPAACA_MEMBER_VAR_EXPORT size_t _publish_queue_capacity;
+		IPAACA_MEMBER_VAR_EXPORT std::deque<PendingPublication> _publish_queue;
+		IPAACA_MEMBER_VAR_EXPORT size_t _publish_in_flight;
+		IPAACA_MEMBER_VAR_EXPORT bool _publish_thread_running;
+		IPAACA_MEMBER_VAR_EXPORT boost::mutex _publish_queue_mutex;
+		IPAACA_MEMBER_VAR_EXPORT boost::condition_variable _publish_queue_cond;
+		IPAACA_MEMBER_VAR_EXPORT boost::thread _publish_thread;
+		IPAACA_HEADER_EXPORT void _publish_worker();
+		IPAACA_HEADER_EXPORT void _stop_publish_thread();
+		// wire-level batching
+		IPAACA_MEMBER_VAR_EXPORT unsigned int _batch_window_ms;
+		IPAACA_MEMBER_VAR_EXPORT size_t _batch_max_events;
+		IPAACA_MEMBER_VAR_EXPORT size_t _batch_max_bytes;
+		IPAACA_MEMBER_VAR_EXPORT std::map<std::string, PendingEventBatch> _pending_batches;
+		IPAACA_MEMBER_VAR_EXPORT bool _batch_thread_running;
+		IPAACA_MEMBER_VAR_EXPORT boost::mutex _batch_mutex;
+		IPAACA_MEMBER_VAR_EXPORT boost::condition_variable _batch_cond;
+		IPAACA_MEMBER_VAR_EXPORT boost::thread _batch_thread;
+		IPAACA_HEADER_EXPORT void _batch_worker();
+		IPAACA_HEADER_EXPORT void _stop_batch_thread();
+		/// send out pending batch frames (all, or only those past their deadline); _batch_mutex must be held
+		IPAACA_HEADER_EXPORT void _flush_batches_locked(bool only_expired);
+		IPAACA_HEADER_EXPORT void _flush_batch_locked(const std::string& category, PendingEventBatch& batch);
+		// automatic retirement
+		IPAACA_MEMBER_VAR_EXPORT unsigned int _retire_after_commit_ms;
+		IPAACA_MEMBER_VAR_EXPORT unsigned int _retire_after_inactivity_ms;
+		IPAACA_MEMBER_VAR_EXPORT std::map<IUId, boost::system_time> _last_activity; ///< (inactivity mode only; IUs with a pending deadline)
+		IPAACA_MEMBER_VAR_EXPORT std::deque<std::pair<boost::system_time, IUId> > _retire_after_commit_queue;
+		IPAACA_MEMBER_VAR_EXPORT std::multimap<boost::system_time, IUId> _retire_after_inactivity_queue; ///< one deadline per IU, re-armed if it was active meanwhile
+		IPAACA_MEMBER_VAR_EXPORT bool _retire_thread_running;
+		IPAACA_MEMBER_VAR_EXPORT boost::mutex _retire_mutex;
+		IPAACA_MEMBER_VAR_EXPORT boost::condition_variable _retire_cond;
+		IPAACA_MEMBER_VAR_EXPORT boost::thread _retire_thread;
+		IPAACA_HEADER_EXPORT inline bool _auto_retire() const { return _retire_after_commit_ms || _retire_after_inactivity_ms; }
+		/// restart the inactivity period of an IU, or start its grace period after commission
+		IPAACA_HEADER_EXPORT void _note_iu_activity(IUInterface* iu, bool committed);
+		IPAACA_HEADER_EXPORT void _retire_worker();
+		IPAACA_HEADER_EXPORT void _stop_retire_thread();
+		/// remove the IUs that are due from the queues; _retire_mutex must be held
+		IPAACA_HEADER_EXPORT void _collect_due_ius_locked(std::vector<IUId>& due);
+		/// earliest pending retirement deadline (pos_infin if none); _retire_mutex must be held
+		IPAACA_HEADER_EXPORT boost::system_time _next_retire_deadline_locked() const;
 #ifdef IPAACA_EXPOSE_FULL_RSB_API
 	protected:
 		IPAACA_MEMBER_VAR_EXPORT std::map<std::string, rsb::Informer<rsb::AnyType>::Ptr> _informer_store;
 		IPAACA_MEMBER_VAR_EXPORT rsb::patterns::LocalServerPtr _server;
 		IPAACA_HEADER_EXPORT rsb::Informer<rsb::AnyType>::Ptr _get_informer(const std::string& category);
+		/// hand an event to the sender thread (asynchronous mode) or send it right away; private_scope: category is the hidden scope of one InputBuffer
+		IPAACA_HEADER_EXPORT void _publish_event(const std::string& category, const std::string& type, rsb::VoidPtr data, bool private_scope=false);
+		/// hand an event to the in-process loopback and/or the transport
+		IPAACA_HEADER_EXPORT void _send_event(const std::string& category, const std::string& type, rsb::VoidPtr data, bool private_scope=false);
+		/// add an event to the pending batch frame of its category
+		IPAACA_HEADER_EXPORT void _batch_event(const std::string& category, const std::string& type, rsb::VoidPtr data);
+		/// hand an event to the transport (shared memory or RSB)
+		IPAACA_HEADER_EXPORT void _transmit_event(const std::string& category, const std::string& type, rsb::VoidPtr data, bool private_scope=false);
 #endif
 	protected:
 		IPAACA_HEADER_EXPORT void _send_iu_link_update(IUInterface* iu, bool is_delta, revision_t revision, const LinkMap& new_links, const LinkMap& links_to_remove, const std::string& writer_name="undef") _IPAACA_OVERRIDE_;
@@ -265,14 +632,21 @@ class OutputBuffer: public Buffer { //, public boost::enable_shared_from_this<Ou
 		IPAACA_HEADER_EXPORT void _publish_iu(boost::shared_ptr<IU> iu);
 		/// mark and send IU retraction on own IU (removal from buffer is in remove(IU))
 		IPAACA_HEADER_EXPORT void _retract_iu(boost::shared_ptr<IU> iu);
+		/// mark and send retractions of several own IUs (collected into batch frames only in batching mode)
+		IPAACA_HEADER_EXPORT void _retract_ius(const std::vector<boost::shared_ptr<IU> >& ius);
 		/// mark and send retraction for all unretracted IUs (without removal, used in ~OutputBuffer)
 		IPAACA_HEADER_EXPORT void _retract_all_internal();
 	protected:
 		/// \b Note: constructor is protected. Use create()
 		IPAACA_HEADER_EXPORT OutputBuffer(const std::string& basename, const std::string& channel=""); // empty string auto-replaced with __ipaaca_static_option_default_channel
+		IPAACA_HEADER_EXPORT OutputBuffer(const BufferConfiguration& bufferconfiguration);
 		IPAACA_HEADER_EXPORT void _initialize_server();
 	public:
 		IPAACA_HEADER_EXPORT static boost::shared_ptr<OutputBuffer> create(const std::string& basename);
+		/// Create OutputBuffer according to configuration in BufferConfiguration object (category interests are ignored)
+		IPAACA_HEADER_EXPORT static boost::shared_ptr<OutputBuffer> create(const BufferConfiguration& bufferconfiguration);
+		/// Block until all events queued so far have been sent (no effect unless publishing asynchronously or batching)
+		IPAACA_HEADER_EXPORT void flush();
 		/// OutputBuffer destructor will retract all IUs that are still live
 		IPAACA_HEADER_EXPORT ~OutputBuffer();
 		IPAACA_HEADER_EXPORT void add(boost::shared_ptr<IU> iu);
@@ -292,20 +666,75 @@ class OutputBuffer: public Buffer { //, public boost::enable_shared_from_this<Ou
  * Set category interests (IU filter) via the different versions of create().
  *
  * Use Buffer::register_handler() to register a handler that will respond to relevant remote IUs.
+ *
+ * Received IUs are kept until the buffer is destroyed, unless retention limits are
+ * set in the BufferConfiguration (max. count / bytes, time to live after commission
+ * or retraction). Evicted IUs disappear from get() and get_ius(); handlers are not
+ * called for them, and their later updates are ignored (no resend requests).
  */
 class InputBuffer: public Buffer { //, public boost::enable_shared_from_this<InputBuffer>  {//{{{
 	friend class IU;
 	friend class RemotePushIU;
 	friend class InputBufferRsbAdaptor;
+	friend class LoopbackHub;
+	friend class LoopbackReceiver;
+	friend class ShmReader;
+	protected:
+		// remote write batching (by owner name)
+		IPAACA_MEMBER_VAR_EXPORT Lock _remote_write_batch_lock;
+		IPAACA_MEMBER_VAR_EXPORT bool _remote_write_batching;
+		IPAACA_MEMBER_VAR_EXPORT std::map<std::string, std::vector<PendingRemoteWrite> > _remote_write_batch;
+		/// collect a remote write if batching is active; false if it has to be sent directly
+		IPAACA_HEADER_EXPORT bool _enqueue_remote_write(const std::string& owner_name, const std::string& type, boost::shared_ptr<void> data, boost::weak_ptr<IUInterface> iu, RevisionFuture& result);
 #ifdef IPAACA_EXPOSE_FULL_RSB_API
 	protected:
 		IPAACA_MEMBER_VAR_EXPORT std::map<std::string, rsb::ListenerPtr> _listener_store;
+		IPAACA_MEMBER_VAR_EXPORT boost::shared_ptr<LoopbackReceiver> _loopback_receiver;
+		IPAACA_MEMBER_VAR_EXPORT Lock _shm_reader_lock; ///< protects _shm_reader_store (the private reader is added on demand)
+		IPAACA_MEMBER_VAR_EXPORT std::map<std::string, boost::shared_ptr<ShmReader> > _shm_reader_store;
+		IPAACA_MEMBER_VAR_EXPORT bool _shm_readers_stopped;
+		/// start reading the shm ring of a category (no-op if reading already, or after destruction began)
+		IPAACA_HEADER_EXPORT void _start_shm_reader(const std::string& category);
 		IPAACA_MEMBER_VAR_EXPORT std::map<std::string, rsb::patterns::RemoteServerPtr> _remote_server_store;
 		IPAACA_MEMBER_VAR_EXPORT RemotePushIUStore _iu_store;
+		// retention (see BufferConfiguration::set_retention_max_ius() etc.)
+		IPAACA_MEMBER_VAR_EXPORT Lock _retention_lock; ///< protects the retention state
+		IPAACA_MEMBER_VAR_EXPORT size_t _retention_max_ius;
+		IPAACA_MEMBER_VAR_EXPORT size_t _retention_max_bytes;
+		IPAACA_MEMBER_VAR_EXPORT unsigned int _retention_ttl_after_commit_ms;
+		IPAACA_MEMBER_VAR_EXPORT unsigned int _retention_ttl_after_retract_ms;
+		IPAACA_MEMBER_VAR_EXPORT bool _retention_lru;
+		IPAACA_MEMBER_VAR_EXPORT size_t _retention_tombstones;
+		IPAACA_MEMBER_VAR_EXPORT std::list<IUId> _retention_order; ///< eviction candidates, next one first
+		IPAACA_MEMBER_VAR_EXPORT std::map<IUId, RetainedIUInfo> _retained;
+		IPAACA_MEMBER_VAR_EXPORT size_t _retained_bytes;
+		IPAACA_MEMBER_VAR_EXPORT std::deque<std::pair<boost::system_time, IUId> > _commit_expiries;
+		IPAACA_MEMBER_VAR_EXPORT std::deque<std::pair<boost::system_time, IUId> > _retract_expiries;
+		IPAACA_MEMBER_VAR_EXPORT std::set<IUId> _tombstones; ///< recently evicted IUs
+		IPAACA_MEMBER_VAR_EXPORT std::deque<IUId> _tombstone_order;
+		IPAACA_HEADER_EXPORT void _init_retention(const BufferConfiguration& bufferconfiguration);
+		IPAACA_HEADER_EXPORT inline bool _retention_active() const { return _retention_max_ius || _retention_max_bytes || _retention_ttl_after_commit_ms || _retention_ttl_after_retract_ms; }
+		/// add a new IU to the store and the retention state
+		IPAACA_HEADER_EXPORT void _store_iu(boost::shared_ptr<RemotePushIU> iu);
+		/// account for a change of an IU (size, recency); starts its time to live on IU_COMMITTED and IU_RETRACTED
+		IPAACA_HEADER_EXPORT void _retention_note_change(boost::shared_ptr<RemotePushIU> iu, IUEventType event_type);
+		/// mark an IU as used (for LRU order)
+		IPAACA_HEADER_EXPORT void _retention_touch(const IUId& uid);
+		/// evict IUs over the limits or past their TTL
+		IPAACA_HEADER_EXPORT void _enforce_retention();
+		IPAACA_HEADER_EXPORT void _evict(const IUId& uid);
+		/// whether the IU was evicted recently (its updates are to be ignored)
+		IPAACA_HEADER_EXPORT bool _was_evicted(const IUId& uid);
 		IPAACA_HEADER_EXPORT rsb::patterns::RemoteServerPtr _get_remote_server(const std::string& unique_server_name);
 		IPAACA_HEADER_EXPORT rsb::ListenerPtr _create_category_listener_if_needed(const std::string& category);
 		IPAACA_HEADER_EXPORT void _handle_iu_events(rsb::EventPtr event);
+		/// RSB handler: skips events from local informers (already delivered in-process), forwards the rest
+		IPAACA_HEADER_EXPORT void _handle_wire_iu_events(rsb::EventPtr event);
 		IPAACA_HEADER_EXPORT void _trigger_resend_request(rsb::EventPtr event);
+		/// ask server_name to resend the IU to our hidden scope (throws IUResendRequestFailedError)
+		IPAACA_HEADER_EXPORT void _send_resend_request(const std::string& uid, const std::string& server_name);
+		/// ask the owner for the full IU after a payload patch did not match
+		IPAACA_HEADER_EXPORT void _request_resync(boost::shared_ptr<RemotePushIU> iu);
 #endif
 	protected:
 		IPAACA_HEADER_EXPORT inline void _send_iu_link_update(IUInterface* iu, bool is_delta, revision_t revision, const LinkMap& new_links, const LinkMap& links_to_remove, const std::string& writer_name="undef") _IPAACA_OVERRIDE_
@@ -344,6 +773,18 @@ class InputBuffer: public Buffer { //, public boost::enable_shared_from_this<Inp
 		/// Specify whether old but previously unseen IUs should be requested to be sent to the buffer over a hidden channel.
 		IPAACA_HEADER_EXPORT void set_resend(bool resendActive);
 		IPAACA_HEADER_EXPORT bool get_resend();
+		/**
+		 * \brief Start collecting remote writes to IUs of this buffer (from any thread)
+		 *
+		 * Payload and link changes and commits of RemotePushIUs do not block and are
+		 * held back until flush_remote_write_batch(), which sends them with one
+		 * round trip per owning OutputBuffer. Each write is still checked and
+		 * answered individually; results are available from the futures
+		 * (RemotePushIU::last_write(), RemotePushIU::commit_async()).
+		 */
+		IPAACA_HEADER_EXPORT void begin_remote_write_batch();
+		/// Send the writes collected since begin_remote_write_batch() and end batching. Returns the number of failed writes.
+		IPAACA_HEADER_EXPORT size_t flush_remote_write_batch();
 		/// Create InputBuffer according to configuration in BufferConfiguration object
 		IPAACA_HEADER_EXPORT static boost::shared_ptr<InputBuffer> create(const BufferConfiguration& bufferconfiguration);
 		/// Create InputBuffer from name and set of category interests
@@ -361,11 +802,11 @@ class InputBuffer: public Buffer { //, public boost::enable_shared_from_this<Inp
 		/// Convenience function: create InputBuffer from name and four category interests [DEPRECATED]
 		[[deprecated("Use create(string, set<string>) instead")]]
 		IPAACA_HEADER_EXPORT static boost::shared_ptr<InputBuffer> create(const std::string& basename, const std::string& category_interest1, const std::string& category_interest2, const std::string& category_interest3, const std::string& category_interest4);
-		IPAACA_HEADER_EXPORT ~InputBuffer() {
-			IPAACA_IMPLEMENT_ME
-		}
+		IPAACA_HEADER_EXPORT ~InputBuffer();
 		IPAACA_HEADER_EXPORT boost::shared_ptr<IUInterface> get(const std::string& iu_uid) _IPAACA_OVERRIDE_;
 		IPAACA_HEADER_EXPORT std::set<boost::shared_ptr<IUInterface> > get_ius() _IPAACA_OVERRIDE_;
+		/// Number of remote IUs currently kept (see BufferConfiguration::set_retention_max_ius())
+		IPAACA_HEADER_EXPORT size_t retained_iu_count();
 	typedef boost::shared_ptr<InputBuffer> ptr;
 };
 //}}}
@@ -375,11 +816,15 @@ class IUPayloadUpdate {//{{{
 	public:
 		IPAACA_MEMBER_VAR_EXPORT std::string uid;
 		IPAACA_MEMBER_VAR_EXPORT revision_t revision;
-		IPAACA_MEMBER_VAR_EXPORT std::string writer_name;
+		IPAACA_MEMBER_VAR_EXPORT InternedString writer_name;
 		IPAACA_MEMBER_VAR_EXPORT bool is_delta;
 		IPAACA_MEMBER_VAR_EXPORT std::map<std::string, PayloadDocumentEntry::ptr> new_items;
 		IPAACA_MEMBER_VAR_EXPORT std::vector<std::string> keys_to_remove;
 		IPAACA_MEMBER_VAR_EXPORT std::string payload_type; // to handle legacy mode
+		IPAACA_MEMBER_VAR_EXPORT PayloadType payload_type_tag; ///< interned payload_type, set together with it
+		IPAACA_MEMBER_VAR_EXPORT bool binary_encoding; ///< whether the receiver(s) can decode binary payload items
+		IPAACA_MEMBER_VAR_EXPORT bool patch_encoding; ///< whether the receiver(s) can apply payload patches (entries are sent with their ids)
+		IPAACA_HEADER_EXPORT inline IUPayloadUpdate(): revision(0), is_delta(false), payload_type_tag(PAYLOAD_TYPE_UNKNOWN), binary_encoding(false), patch_encoding(false) { }
 	friend std::ostream& operator<<(std::ostream& os, const IUPayloadUpdate& obj);
 	typedef boost::shared_ptr<IUPayloadUpdate> ptr;
 };//}}}
@@ -389,7 +834,7 @@ class IULinkUpdate {//{{{
 	public:
 		IPAACA_MEMBER_VAR_EXPORT std::string uid;
 		IPAACA_MEMBER_VAR_EXPORT revision_t revision;
-		IPAACA_MEMBER_VAR_EXPORT std::string writer_name;
+		IPAACA_MEMBER_VAR_EXPORT InternedString writer_name;
 		IPAACA_MEMBER_VAR_EXPORT bool is_delta;
 		IPAACA_MEMBER_VAR_EXPORT std::map<std::string, std::set<std::string> > new_links;
 		IPAACA_MEMBER_VAR_EXPORT std::map<std::string, std::set<std::string> > links_to_remove;
@@ -51,6 +51,9 @@
 
 typedef uint32_t revision_t;
 
+/// Result of an asynchronous remote write: the new revision of the IU (or the failure, on get())
+typedef std::shared_future<revision_t> RevisionFuture;
+
 /// Type of the IU event. Realized as an integer to enable bit masks for filters. One of: IU_ADDED, IU_COMMITTED, IU_DELETED, IU_RETRACTED, IU_UPDATED, IU_LINKSUPDATED, IU_MESSAGE
 typedef uint32_t IUEventType;
 #define IU_ADDED         1
@@ -93,9 +96,95 @@ enum IUAccessMode {
 	IU_ACCESS_MESSAGE
 };
 
+/// Lifecycle state of an IU, as indexed by the buffers (see Buffer::query_state())
+enum IUState {
+	IU_STATE_OPEN,      ///< neither committed nor retracted
+	IU_STATE_COMMITTED, ///< committed, but not retracted
+	IU_STATE_RETRACTED
+};
+
+/// Interned form of an IU payload type string ("JSON", or legacy "MAP" / "STR"), determined once per IU
+enum PayloadType {
+	PAYLOAD_TYPE_JSON,
+	PAYLOAD_TYPE_MAP,
+	PAYLOAD_TYPE_STR,
+	PAYLOAD_TYPE_UNKNOWN
+};
+
+/// Map a payload type string to its PayloadType tag
+IPAACA_HEADER_EXPORT inline PayloadType payload_type_from_string(const std::string& payload_type)
+{
+	if (payload_type == "JSON") return PAYLOAD_TYPE_JSON;
+	if (payload_type == "MAP") return PAYLOAD_TYPE_MAP;
+	if (payload_type == "STR") return PAYLOAD_TYPE_STR;
+	return PAYLOAD_TYPE_UNKNOWN;
+}
+
 /// generate a UUID as an ASCII string
 IPAACA_HEADER_EXPORT std::string generate_uuid_string();
 
+/** \brief Compact 128-bit form of an IU UID, used as key in the IU stores
+ *
+ * UIDs in canonical UUID text form (8-4-4-4-12 hex digits) map to their
+ * 128 bits exactly and back (to_string()). Other UID strings (e.g. from
+ * foreign implementations) map to a 128-bit digest, which is unique with
+ * the same (probabilistic) confidence as UUIDs themselves.
+ */
+class IUId {//{{{
+	public:
+		IPAACA_MEMBER_VAR_EXPORT uint64_t high;
+		IPAACA_MEMBER_VAR_EXPORT uint64_t low;
+		IPAACA_HEADER_EXPORT inline IUId(): high(0), low(0) { }
+		IPAACA_HEADER_EXPORT inline IUId(uint64_t high_, uint64_t low_): high(high_), low(low_) { }
+		/// Binary form of a UID string (see class description)
+		IPAACA_HEADER_EXPORT explicit IUId(const std::string& uid);
+		/// Canonical UUID text form
+		IPAACA_HEADER_EXPORT std::string to_string() const;
+		/// Parse canonical (lowercase) UUID text form only; returns false (leaving result untouched) otherwise
+		IPAACA_HEADER_EXPORT static bool parse(const std::string& uid, IUId& result);
+		IPAACA_HEADER_EXPORT inline bool operator==(const IUId& other) const { return (high == other.high) && (low == other.low); }
+		IPAACA_HEADER_EXPORT inline bool operator!=(const IUId& other) const { return (high != other.high) || (low != other.low); }
+		IPAACA_HEADER_EXPORT inline bool operator<(const IUId& other) const { return (high < other.high) || ((high == other.high) && (low < other.low)); }
+};//}}}
+
+/// Generate a new IU UID string according to the UID mode (see --ipaaca-uid-mode), also returning its binary form
+IPAACA_HEADER_EXPORT std::string generate_iu_uid(IUId& binary_uid);
+
+/** \brief Handle to a string in the process-wide intern table
+ *
+ * Used for the strings that recur across many IUs and events (categories,
+ * owner and writer names, payload types): all equal strings share one
+ * stored instance, and InternedStrings compare equal iff they point to
+ * the same instance. The handles are reference-counted; a string leaves
+ * the table when its last handle is released, so names of buffers that
+ * are gone do not accumulate. Not meant for per-IU strings like UIDs.
+ */
+class InternedString {//{{{
+	protected:
+		IPAACA_MEMBER_VAR_EXPORT std::shared_ptr<const std::string> _str; // empty for the empty string
+		IPAACA_HEADER_EXPORT static std::shared_ptr<const std::string> _intern(const std::string& str);
+		IPAACA_HEADER_EXPORT static const std::string& _empty();
+	public:
+		IPAACA_HEADER_EXPORT inline InternedString() { }
+		IPAACA_HEADER_EXPORT inline InternedString(const std::string& str): _str(_intern(str)) { }
+		IPAACA_HEADER_EXPORT inline InternedString(const char* str): _str(_intern(str)) { }
+		IPAACA_HEADER_EXPORT inline const std::string& str() const { return _str ? *_str : _empty(); }
+		IPAACA_HEADER_EXPORT inline operator const std::string&() const { return str(); }
+		IPAACA_HEADER_EXPORT inline const char* c_str() const { return str().c_str(); }
+		IPAACA_HEADER_EXPORT inline bool empty() const { return !_str; }
+		IPAACA_HEADER_EXPORT inline bool operator==(const InternedString& other) const { return _str == other._str; }
+		IPAACA_HEADER_EXPORT inline bool operator!=(const InternedString& other) const { return _str != other._str; }
+		/// Arbitrary but consistent order (by instance), for use as a set / map key
+		IPAACA_HEADER_EXPORT inline bool operator<(const InternedString& other) const { return std::less<const std::string*>()(_str.get(), other._str.get()); }
+		/// Number of strings currently in the intern table
+		IPAACA_HEADER_EXPORT static size_t table_size();
+};//}}}
+IPAACA_HEADER_EXPORT inline bool operator==(const InternedString& a, const std::string& b) { return a.str() == b; }
+IPAACA_HEADER_EXPORT inline bool operator==(const std::string& a, const InternedString& b) { return a == b.str(); }
+IPAACA_HEADER_EXPORT inline bool operator!=(const InternedString& a, const std::string& b) { return a.str() != b; }
+IPAACA_HEADER_EXPORT inline bool operator!=(const std::string& a, const InternedString& b) { return a != b.str(); }
+IPAACA_HEADER_EXPORT inline std::ostream& operator<<(std::ostream& os, const InternedString& str) { return os << str.str(); }
+
 /**
  * Exception with string description
  */
@@ -266,6 +355,24 @@ class JsonParsingError: public Exception//{{{
 			_description = "JsonParsingError";
 		}
 };//}}}
+/// Malformed binary-encoded payload entry was received
+class BinaryPayloadError: public Exception//{{{
+{
+	public:
+		IPAACA_HEADER_EXPORT inline ~BinaryPayloadError() throw() { }
+		IPAACA_HEADER_EXPORT inline BinaryPayloadError() {
+			_description = "BinaryPayloadError";
+		}
+};//}}}
+/// Payload patch could not be applied (unknown base entry or invalid path)
+class PayloadPatchError: public Exception//{{{
+{
+	public:
+		IPAACA_HEADER_EXPORT inline ~PayloadPatchError() throw() { }
+		IPAACA_HEADER_EXPORT inline PayloadPatchError(const std::string& reason = "") {
+			_description = "PayloadPatchError(" + reason + ")";
+		}
+};//}}}
 /// PayloadEntryProxy invalidated (unused)
 class PayloadEntryProxyInvalidatedError: public Exception//{{{
 {
@@ -284,6 +391,16 @@ class PayloadIteratorInvalidError: public Exception//{{{
 			_description = "PayloadIteratorInvalidError";
 		}
 };//}}}
+/// Shared-memory ring for the 'shm' transport could not be created, mapped or written
+class ShmTransportError: public Exception//{{{
+{
+	public:
+		IPAACA_HEADER_EXPORT inline ~ShmTransportError() throw() { }
+		IPAACA_HEADER_EXPORT inline ShmTransportError(const std::string& reason="") {
+			_description = "ShmTransportError";
+			if (reason!="") _description += ": " + reason;
+		}
+};//}}}
 
 /** \brief Static library initialization for backend
  *
@@ -331,6 +448,11 @@ class Initializer
  * --ipaaca-default-channel <name> | Set default channel name (default 'default')
  * --ipaaca-enable-logging <level> | Set console log level, one of NONE, DEBUG, INFO, WARNING, ERROR, CRITICAL
  * --rsb-enable-logging <level>    | Set rsb (transport) log level
+ * --ipaaca-loopback <mode>        | In-process delivery between local buffers, one of off, on, exclusive (default off)
+ * --ipaaca-binary-payload <mode>  | Binary encoding of JSON payload entries, one of off, on (all receivers on the channel support it)
+ * --ipaaca-uid-mode <mode>        | IU UID generation, one of uuid (default), counter (process prefix plus counter, much cheaper)
+ * --ipaaca-payload-patches <mode> | Send nested payload writes as path-level patches, one of off, on (all receivers on the channel support it)
+ * --rsb-transport <name>          | Set transport, one of spread, socket, shm (shared memory for IU events on one host)
  *
  */
 class CommandLineOptions {
@@ -367,6 +489,11 @@ class CommandLineOptions {
  * --ipaaca-default-channel <name> | Set default channel name (default 'default')
  * --ipaaca-enable-logging <level> | Set console log level, one of NONE, DEBUG, INFO, WARNING, ERROR, CRITICAL
  * --rsb-enable-logging <level>    | Set rsb (transport) log level
+ * --ipaaca-loopback <mode>        | In-process delivery between local buffers, one of off, on, exclusive (default off)
+ * --ipaaca-binary-payload <mode>  | Binary encoding of JSON payload entries, one of off, on (all receivers on the channel support it)
+ * --ipaaca-uid-mode <mode>        | IU UID generation, one of uuid (default), counter (process prefix plus counter, much cheaper)
+ * --ipaaca-payload-patches <mode> | Send nested payload writes as path-level patches, one of off, on (all receivers on the channel support it)
+ * --rsb-transport <name>          | Set transport, one of spread, socket, shm (shared memory for IU events on one host)
  *
  */
 class CommandLineParser {
@@ -56,8 +56,13 @@ class PayloadDocumentEntry;
 
 class PayloadBatchUpdateLock;
 class PayloadEntryProxy;
+class PayloadPath;
 class Payload;
 class PayloadIterator;
+class PayloadView;
+class PayloadItemView;
+class PayloadValueView;
+class PayloadMemberView;
 class IUInterface;
 class IU;
 class Message;
@@ -66,6 +71,8 @@ class IULinkUpdate;
 class IUPayloadUpdate;
 class IUStore;
 class FrozenIUStore;
+class IUIndex;
+class IUQueryResult;
 class Buffer;
 class InputBuffer;
 class OutputBuffer;
@@ -75,11 +82,20 @@ class CallbackIULinkUpdate;
 class CallbackIUCommission;
 class CallbackIUResendRequest;
 class CallbackIURetraction;
+class CallbackIUWriteBatch;
 
 class IUConverter;
 class MessageConverter;
 class IUPayloadUpdateConverter;
 class IULinkUpdateConverter;
+class ConverterRegistry;
+
+class LoopbackEvent;
+class LoopbackReceiver;
+class LoopbackHub;
+class ShmRing;
+class ShmReader;
+class ShmTransport;
 //class IntConverter;
 
 class BufferConfiguration;
@@ -90,6 +90,15 @@ IPAACA_HEADER_EXPORT class CallbackIUResendRequest: public rsb::patterns::LocalS
 	public:
 		IPAACA_HEADER_EXPORT boost::shared_ptr<int64_t> call(const std::string& methodName, boost::shared_ptr<protobuf::IUResendRequest> update);
 };//}}}
+/// Applies a list of serialized payload / link updates and commissions (for many IUs), result per item
+IPAACA_HEADER_EXPORT class CallbackIUWriteBatch: public rsb::patterns::LocalServer::Callback<protobuf::IUEventBatch, protobuf::IUWriteBatchResult> {//{{{
+	protected:
+		IPAACA_MEMBER_VAR_EXPORT Buffer* _buffer;
+	public:
+		IPAACA_HEADER_EXPORT CallbackIUWriteBatch(Buffer* buffer);
+	public:
+		IPAACA_HEADER_EXPORT boost::shared_ptr<protobuf::IUWriteBatchResult> call(const std::string& methodName, boost::shared_ptr<protobuf::IUEventBatch> batch);
+};//}}}
 IPAACA_HEADER_EXPORT class CallbackIURetraction: public rsb::patterns::LocalServer::Callback<protobuf::IURetraction, int64_t> {//{{{
 	protected:
 		IPAACA_MEMBER_VAR_EXPORT Buffer* _buffer;
@@ -123,6 +132,212 @@ IPAACA_HEADER_EXPORT class IULinkUpdateConverter: public rsb::converter::Convert
 		IPAACA_HEADER_EXPORT std::string serialize(const rsb::AnnotatedData& data, std::string& wire);
 		IPAACA_HEADER_EXPORT rsb::AnnotatedData deserialize(const std::string& wireSchema, const std::string& wire);
 };//}}}
+/// Interned type of an event received by an InputBuffer (see iu_wire_event_type())
+enum IUWireEventType {
+	IU_WIRE_EVENT_UNKNOWN,
+	IU_WIRE_EVENT_BATCH,
+	IU_WIRE_EVENT_REMOTE_PUSH_IU,
+	IU_WIRE_EVENT_REMOTE_MESSAGE,
+	IU_WIRE_EVENT_PAYLOAD_UPDATE,
+	IU_WIRE_EVENT_LINK_UPDATE,
+	IU_WIRE_EVENT_COMMISSION,
+	IU_WIRE_EVENT_RETRACTION
+};
+/// Look up the tag for a received event type string (one hash lookup instead of a comparison chain)
+IPAACA_HEADER_EXPORT IUWireEventType iu_wire_event_type(const std::string& type);
+/**
+ * \brief Process-wide table of the ipaaca wire converters
+ *
+ * Used wherever ipaaca serializes events by itself instead of leaving
+ * it to RSB (shared-memory transport, batched event frames).
+ */
+IPAACA_HEADER_EXPORT class ConverterRegistry {//{{{
+	protected:
+		IPAACA_MEMBER_VAR_EXPORT Lock _lock;
+		IPAACA_MEMBER_VAR_EXPORT std::map<std::string, rsb::converter::Converter<std::string>::Ptr> _converters_by_type;
+		IPAACA_MEMBER_VAR_EXPORT std::map<std::string, rsb::converter::Converter<std::string>::Ptr> _converters_by_wire_schema;
+	protected:
+		IPAACA_HEADER_EXPORT ConverterRegistry() { }
+	public:
+		IPAACA_HEADER_EXPORT static ConverterRegistry& instance();
+		IPAACA_HEADER_EXPORT void register_converter(rsb::converter::Converter<std::string>::Ptr converter);
+		/// Serialize an event payload; false if there is no converter for the type
+		IPAACA_HEADER_EXPORT bool serialize(const std::string& type, rsb::VoidPtr data, std::string& wire_schema, std::string& wire);
+		/// Deserialize an event payload; false if there is no converter for the wire schema
+		IPAACA_HEADER_EXPORT bool deserialize(const std::string& wire_schema, const std::string& wire, rsb::AnnotatedData& result);
+};//}}}
+
+/// Event relayed in-process by the LoopbackHub (same type/data pair as in an rsb::Event)
+IPAACA_HEADER_EXPORT class LoopbackEvent {//{{{
+	public:
+		IPAACA_MEMBER_VAR_EXPORT std::string type;
+		IPAACA_MEMBER_VAR_EXPORT boost::shared_ptr<void> data;
+		IPAACA_HEADER_EXPORT inline LoopbackEvent(const std::string& type_, boost::shared_ptr<void> data_): type(type_), data(data_) { }
+};//}}}
+
+/// Receive queue and dispatch thread of one InputBuffer for in-process events
+IPAACA_HEADER_EXPORT class LoopbackReceiver: public boost::enable_shared_from_this<LoopbackReceiver> {//{{{
+	protected:
+		IPAACA_MEMBER_VAR_EXPORT InputBuffer* _buffer;
+		IPAACA_MEMBER_VAR_EXPORT boost::lockfree::queue<LoopbackEvent*> _queue;
+		IPAACA_MEMBER_VAR_EXPORT boost::mutex _wakeup_mutex;
+		IPAACA_MEMBER_VAR_EXPORT boost::condition_variable _wakeup;
+		IPAACA_MEMBER_VAR_EXPORT bool _running;
+		IPAACA_MEMBER_VAR_EXPORT boost::thread _thread;
+	protected:
+		IPAACA_HEADER_EXPORT void _run();
+	public:
+		IPAACA_HEADER_EXPORT LoopbackReceiver(InputBuffer* buffer);
+		IPAACA_HEADER_EXPORT ~LoopbackReceiver();
+		IPAACA_HEADER_EXPORT void start();
+		/// Stop dispatching; joins the thread (or detaches it when called from a handler)
+		IPAACA_HEADER_EXPORT void stop();
+		IPAACA_HEADER_EXPORT void enqueue(const std::string& type, boost::shared_ptr<void> data);
+	typedef boost::shared_ptr<LoopbackReceiver> ptr;
+};//}}}
+
+/** \brief Process-wide registry for in-process delivery between buffers
+ *
+ * Active if __ipaaca_static_option_loopback is "on" or "exclusive".
+ * OutputBuffers hand their events to deliver(), which enqueues them
+ * directly for all local InputBuffers listening on the same channel
+ * and category (no serialization). Received IUs are per-buffer
+ * snapshots sharing the (copy-on-write) payload entries of the original.
+ * Remote writes to IUs owned by a local OutputBuffer are executed by
+ * a direct call of the server callbacks.
+ */
+IPAACA_HEADER_EXPORT class LoopbackHub {//{{{
+	protected:
+		/// A local OutputBuffer as a target of server calls
+		struct LocalServer {
+			OutputBuffer* buffer;
+			bool registered; ///< false once the buffer is being destroyed
+			Lock call_lock; ///< held during calls, serializes them like the RSB server of the buffer
+		};
+		IPAACA_MEMBER_VAR_EXPORT Lock _lock;
+		/// separate lock for the server registry (calls may publish, i.e. take _lock, from under the IU revision lock)
+		IPAACA_MEMBER_VAR_EXPORT Lock _server_lock;
+		IPAACA_MEMBER_VAR_EXPORT std::map<std::string, std::set<InputBuffer*> > _subscribers;
+		IPAACA_MEMBER_VAR_EXPORT std::map<std::string, boost::shared_ptr<LocalServer> > _output_buffers;
+		IPAACA_MEMBER_VAR_EXPORT std::set<rsc::misc::UUID> _local_informers;
+	protected:
+		IPAACA_HEADER_EXPORT inline LoopbackHub() { }
+		IPAACA_HEADER_EXPORT static boost::shared_ptr<void> _snapshot_iu(boost::shared_ptr<IU> iu, std::string& type);
+	public:
+		IPAACA_HEADER_EXPORT static LoopbackHub& instance();
+		IPAACA_HEADER_EXPORT static bool enabled();
+		/// Whether events are delivered in-process only (not published via RSB)
+		IPAACA_HEADER_EXPORT static bool exclusive();
+		IPAACA_HEADER_EXPORT void subscribe(const std::string& channel, const std::string& category, InputBuffer* buffer);
+		IPAACA_HEADER_EXPORT void unsubscribe_all(InputBuffer* buffer);
+		IPAACA_HEADER_EXPORT void register_output_buffer(OutputBuffer* buffer);
+		IPAACA_HEADER_EXPORT void unregister_output_buffer(OutputBuffer* buffer);
+		IPAACA_HEADER_EXPORT void register_local_informer(const rsc::misc::UUID& id);
+		IPAACA_HEADER_EXPORT void unregister_local_informer(const rsc::misc::UUID& id);
+		IPAACA_HEADER_EXPORT bool is_local_informer(const rsc::misc::UUID& id);
+		/// Relay an event (as published by OutputBuffer) to the local InputBuffers
+		IPAACA_HEADER_EXPORT void deliver(const std::string& channel, const std::string& category, const std::string& type, boost::shared_ptr<void> data);
+		/// Run a remote write request directly on a local OutputBuffer. Returns false if the owner is not in this process.
+		template<class CallbackT, class UpdateT, class ResultT> bool call_local_server(const std::string& owner_name, const std::string& method_name, boost::shared_ptr<UpdateT> update, ResultT& result)
+		{
+			if (!enabled()) return false;
+			boost::shared_ptr<LocalServer> server;
+			{
+				Locker locker(_server_lock);
+				auto it = _output_buffers.find(owner_name);
+				if (it == _output_buffers.end()) return false;
+				server = it->second;
+			}
+			// calls to different buffers do not block each other
+			Locker locker(server->call_lock);
+			if (!server->registered) return false;
+			CallbackT callback(server->buffer);
+			result = *(callback.call(method_name, update));
+			return true;
+		}
+};//}}}
+
+/// Layout of the start of a shared-memory ring segment (defined in ipaaca-shm.cc)
+struct ShmRingHeader;
+
+/** \brief Ring buffer of serialized events in a POSIX shared-memory segment
+ *
+ * One segment exists per channel/category and is shared by all writers
+ * and readers on the host. Records are appended under a process-shared
+ * mutex; each reader keeps its own position and is notified by a
+ * process-shared condition variable. Readers that fall behind by more
+ * than the capacity lose the overwritten records (a warning is logged).
+ */
+IPAACA_HEADER_EXPORT class ShmRing {//{{{
+	protected:
+		IPAACA_MEMBER_VAR_EXPORT std::string _name;
+		IPAACA_MEMBER_VAR_EXPORT ShmRingHeader* _header;
+		IPAACA_MEMBER_VAR_EXPORT char* _data;
+		IPAACA_MEMBER_VAR_EXPORT size_t _mapped_size;
+	public:
+		/// Map the segment name, creating it unless it exists (or throwing ShmTransportError if create is false)
+		IPAACA_HEADER_EXPORT ShmRing(const std::string& name, uint64_t capacity, bool create=true);
+		IPAACA_HEADER_EXPORT ~ShmRing();
+		/// Append one record and wake up all readers
+		IPAACA_HEADER_EXPORT void write(const std::string& record);
+		/// Position after the newest record (start position for new readers)
+		IPAACA_HEADER_EXPORT uint64_t head();
+		/// Fetch the record at read_pos and advance read_pos; false if none arrived within timeout_ms
+		IPAACA_HEADER_EXPORT bool read(uint64_t& read_pos, std::string& record, long timeout_ms);
+	typedef boost::shared_ptr<ShmRing> ptr;
+};//}}}
+
+/// Reader thread feeding the events of one ShmRing into an InputBuffer
+IPAACA_HEADER_EXPORT class ShmReader: public boost::enable_shared_from_this<ShmReader> {//{{{
+	protected:
+		IPAACA_MEMBER_VAR_EXPORT InputBuffer* _buffer;
+		IPAACA_MEMBER_VAR_EXPORT ShmRing::ptr _ring;
+		IPAACA_MEMBER_VAR_EXPORT uint64_t _read_pos;
+		IPAACA_MEMBER_VAR_EXPORT std::atomic<bool> _running;
+		IPAACA_MEMBER_VAR_EXPORT boost::thread _thread;
+	protected:
+		IPAACA_HEADER_EXPORT void _run();
+	public:
+		IPAACA_HEADER_EXPORT ShmReader(InputBuffer* buffer, ShmRing::ptr ring);
+		IPAACA_HEADER_EXPORT void start();
+		/// Stop reading; joins the thread (or detaches it when called from a handler)
+		IPAACA_HEADER_EXPORT void stop();
+	typedef boost::shared_ptr<ShmReader> ptr;
+};//}}}
+
+/** \brief Shared-memory transport for IU events between processes on one host
+ *
+ * Active if __ipaaca_static_option_rsb_transport is "shm". IU events are
+ * serialized with the regular ipaaca converters and exchanged through
+ * one ShmRing per channel/category, bypassing RSB; RPC (remote writes,
+ * resend requests) still uses RSB (socket transport).
+ *
+ * Rings of categories are kept on the host for other processes. The
+ * private ring of an InputBuffer (for resent IUs) is only created on its
+ * first resend request, and removed by the InputBuffer destructor.
+ */
+IPAACA_HEADER_EXPORT class ShmTransport {//{{{
+	protected:
+		IPAACA_MEMBER_VAR_EXPORT Lock _lock;
+		IPAACA_MEMBER_VAR_EXPORT std::map<std::string, ShmRing::ptr> _rings;
+		/// Identifies records written by this process (to skip them if delivered by loopback)
+		IPAACA_MEMBER_VAR_EXPORT std::string _process_token;
+	protected:
+		IPAACA_HEADER_EXPORT ShmTransport();
+		IPAACA_HEADER_EXPORT static std::string _segment_name(const std::string& scope);
+	public:
+		IPAACA_HEADER_EXPORT static ShmTransport& instance();
+		IPAACA_HEADER_EXPORT static bool enabled();
+		/// Obtain the (process-wide shared) mapping of the ring for a channel/category
+		IPAACA_HEADER_EXPORT ShmRing::ptr ring(const std::string& channel, const std::string& category);
+		/// Remove the segment of a ring from the host (for private rings, by their reader)
+		IPAACA_HEADER_EXPORT void unlink_ring(const std::string& channel, const std::string& category);
+		/// Append an event to a ring. Private rings (of one InputBuffer) are never created by writers.
+		IPAACA_HEADER_EXPORT void publish(const std::string& channel, const std::string& category, const std::string& type, rsb::VoidPtr data, bool private_scope=false);
+		/// Reconstruct an event from a record; null if the record is to be skipped
+		IPAACA_HEADER_EXPORT rsb::EventPtr decode(const std::string& record);
+};//}}}
+
 /*
 IPAACA_HEADER_EXPORT class IntConverter: public rsb::converter::Converter<std::string> {//{{{
 	public:
@@ -61,6 +61,7 @@
 class IUInterface {//{{{
 	friend class IUConverter;
 	friend class MessageConverter;
+	friend class LoopbackHub;
 	friend std::ostream& operator<<(std::ostream& os, const IUInterface& obj);
 	protected:
 		IPAACA_HEADER_EXPORT IUInterface();
@@ -68,10 +69,12 @@ class IUInterface {//{{{
 		IPAACA_HEADER_EXPORT inline virtual ~IUInterface() { }
 	protected:
 		IPAACA_MEMBER_VAR_EXPORT std::string _uid;
+		IPAACA_MEMBER_VAR_EXPORT IUId _binary_uid; // compact form of _uid, used as store key
 		IPAACA_MEMBER_VAR_EXPORT revision_t _revision;
-		IPAACA_MEMBER_VAR_EXPORT std::string _category;
-		IPAACA_MEMBER_VAR_EXPORT std::string _payload_type; // default is taken from __ipaaca_static_option_default_payload_type
-		IPAACA_MEMBER_VAR_EXPORT std::string _owner_name;
+		IPAACA_MEMBER_VAR_EXPORT InternedString _category;
+		IPAACA_MEMBER_VAR_EXPORT InternedString _payload_type; // default is taken from __ipaaca_static_option_default_payload_type
+		IPAACA_MEMBER_VAR_EXPORT PayloadType _payload_type_tag; // interned _payload_type, see _set_payload_type()
+		IPAACA_MEMBER_VAR_EXPORT InternedString _owner_name;
 		IPAACA_MEMBER_VAR_EXPORT bool _committed;
 		IPAACA_MEMBER_VAR_EXPORT bool _retracted;
 		IPAACA_MEMBER_VAR_EXPORT IUAccessMode _access_mode;
@@ -83,6 +86,7 @@ class IUInterface {//{{{
 		friend class Payload;
 		// Internal functions that perform the update logic,
 		//  e.g. sending a notification across the network
+		//  (both also apply the change to the local links / payload)
 		IPAACA_HEADER_EXPORT _IPAACA_ABSTRACT_ virtual void _modify_links(bool is_delta, const LinkMap& new_links, const LinkMap& links_to_remove, const std::string& writer_name) = 0;
 		IPAACA_HEADER_EXPORT _IPAACA_ABSTRACT_ virtual void _modify_payload(bool is_delta, const std::map<std::string, PayloadDocumentEntry::ptr>& new_items, const std::vector<std::string>& keys_to_remove, const std::string& writer_name) = 0;
 		//void _set_buffer(boost::shared_ptr<Buffer> buffer);
@@ -90,10 +94,12 @@ class IUInterface {//{{{
 		IPAACA_HEADER_EXPORT void _set_buffer(Buffer* buffer);
 		IPAACA_HEADER_EXPORT void _set_uid(const std::string& uid);
 		IPAACA_HEADER_EXPORT void _set_owner_name(const std::string& owner_name);
+		IPAACA_HEADER_EXPORT inline void _set_payload_type(const std::string& payload_type) { _payload_type = payload_type; _payload_type_tag = payload_type_from_string(payload_type); }
 	protected:
 		// internal functions that do not emit update events
-		IPAACA_HEADER_EXPORT void _add_and_remove_links(const LinkMap& add, const LinkMap& remove) { _links._add_and_remove_links(add, remove); }
-		IPAACA_HEADER_EXPORT void _replace_links(const LinkMap& links) { _links._replace_links(links); }
+		IPAACA_HEADER_EXPORT void _add_and_remove_links(const LinkMap& add, const LinkMap& remove) { _links._add_and_remove_links(add, remove); if (_buffer) _buffer->_iu_links_changed(this); }
+		IPAACA_HEADER_EXPORT void _replace_links(const LinkMap& links) { _links._replace_links(links); if (_buffer) _buffer->_iu_links_changed(this); }
+		IPAACA_HEADER_EXPORT inline void _apply_links(bool is_delta, const LinkMap& new_links, const LinkMap& links_to_remove) { if (is_delta) _add_and_remove_links(new_links, links_to_remove); else _replace_links(new_links); }
 	public:
 		/// Return whether IU has been retracted
 		IPAACA_HEADER_EXPORT inline bool retracted() const { return _retracted; }
@@ -101,16 +107,20 @@ class IUInterface {//{{{
 		IPAACA_HEADER_EXPORT inline bool is_published() { return (_buffer != 0); }
 		/// Return auto-generated UID string (set during IU construction)
 		IPAACA_HEADER_EXPORT inline const std::string& uid() const { return _uid; }
+		/// Return the compact 128-bit form of the UID (cheap to compare and hash)
+		IPAACA_HEADER_EXPORT inline const IUId& binary_uid() const { return _binary_uid; }
 		/// Return current IU revision number (incremented for each update)
 		IPAACA_HEADER_EXPORT inline revision_t revision() const { return _revision; }
 		/// Return the IU category string (set during IU construction)
-		IPAACA_HEADER_EXPORT inline const std::string& category() const { return _category; }
+		IPAACA_HEADER_EXPORT inline const std::string& category() const { return _category.str(); }
+		/// Return the interned category (cheap to compare and to use as a key)
+		IPAACA_HEADER_EXPORT inline const InternedString& interned_category() const { return _category; }
 		/// Return the channel name the IU is resident on (set on publication)
 		IPAACA_HEADER_EXPORT const std::string& channel();
 		/// Return the payload type (default "JSON")
-		IPAACA_HEADER_EXPORT inline const std::string& payload_type() const { return _payload_type; }
+		IPAACA_HEADER_EXPORT inline const std::string& payload_type() const { return _payload_type.str(); }
 		/// Return the owner name (unique fully-qualified buffer name, set on publication)
-		IPAACA_HEADER_EXPORT inline const std::string& owner_name() const { return _owner_name; }
+		IPAACA_HEADER_EXPORT inline const std::string& owner_name() const { return _owner_name.str(); }
 		/// Return whether IU has been committed to (i.e. is complete, confirmed, and henceforth constant)
 		IPAACA_HEADER_EXPORT inline bool committed() const { return _committed; }
 		/// Return the access mode (not relevant for the time being)
@@ -151,6 +161,23 @@ class IUInterface {//{{{
 	typedef boost::shared_ptr<IUInterface> ptr;
 };//}}}
 
+/** \brief Serialized wire form of an IU at one revision. <b>Internal type</b>.
+ *
+ * Filled by IUConverter and reused for repeated publishes and resends
+ * of the same revision. Shared between an IU and its snapshots.
+ */
+class IUWireCache {//{{{
+	public:
+		IPAACA_MEMBER_VAR_EXPORT Lock lock;
+		IPAACA_MEMBER_VAR_EXPORT bool valid;
+		IPAACA_MEMBER_VAR_EXPORT revision_t revision;
+		IPAACA_MEMBER_VAR_EXPORT bool binary_payload;
+		IPAACA_MEMBER_VAR_EXPORT bool entry_ids;
+		IPAACA_MEMBER_VAR_EXPORT std::string wire_schema;
+		IPAACA_MEMBER_VAR_EXPORT std::string wire;
+		IPAACA_HEADER_EXPORT inline IUWireCache(): valid(false), revision(0), binary_payload(false), entry_ids(false) { }
+};//}}}
+
 /** \brief Class of locally-owned IU objects.
  *
  * Use IU::create() (static) to create references to new IUs.
@@ -167,13 +194,20 @@ class IU: public IUInterface {//{{{
 	friend class CallbackIULinkUpdate;
 	friend class CallbackIUCommission;
 	friend class CallbackIUResendRequest;
+	friend class IUConverter;
 	public:
 		IPAACA_MEMBER_VAR_EXPORT Payload _payload;
 	protected:
-	   IPAACA_MEMBER_VAR_EXPORT  Lock _revision_lock;
+	   /// held while the revision is increased and the change is applied (also by readers that need both)
+	   IPAACA_MEMBER_VAR_EXPORT mutable Lock _revision_lock;
+		/// Wire form of the last serialized revision (see IUConverter)
+		IPAACA_MEMBER_VAR_EXPORT boost::shared_ptr<IUWireCache> _wire_cache;
 	protected:
 		IPAACA_HEADER_EXPORT inline void _increase_revision_number() { _revision++; }
 		IPAACA_HEADER_EXPORT IU(const std::string& category, IUAccessMode access_mode=IU_ACCESS_PUSH, bool read_only=false, const std::string& payload_type="" ); // __ipaaca_static_option_default_payload_type
+		/// Detached copy of the current state (same uid, shared payload entries), used for deferred sending
+		IPAACA_HEADER_EXPORT IU(const IU& original);
+		IPAACA_HEADER_EXPORT boost::shared_ptr<IU> _create_snapshot();
 	public:
 		IPAACA_HEADER_EXPORT inline ~IU() {
 		}
@@ -228,32 +262,93 @@ class Message: public IU {//{{{
 	typedef boost::shared_ptr<Message> ptr;
 };//}}}
 
-/// Copy of a remote IU, received in an InputBuffer. Setter functions call RPC over the backend (RSB). \b Note: Typically handled only as reference in a handler in user space.
+/** \brief Copy of a remote IU, received in an InputBuffer. Setter functions call RPC over the backend (RSB).
+ *
+ * \b Note: Typically handled only as reference in a handler in user space.
+ *
+ * By default, every write blocks until the owner has replied. After set_async_writes(true),
+ * payload and link changes return right away and several writes can be in flight;
+ * last_write() / commit_async() provide futures for the resulting revisions, and
+ * wait_for_writes() waits for all outstanding ones. The local copy is changed
+ * optimistically, failed writes are only reported through the futures.
+ * Every write increases the owner's revision by one, so a write sent while others
+ * are in flight expects the revision those will have led to; a concurrent change
+ * on the owner side makes it (and the writes after it) fail.
+ */
 class RemotePushIU: public IUInterface {//{{{
 	friend class Buffer;
 	friend class InputBuffer;
 	friend class OutputBuffer;
 	friend class IUConverter;
 	friend class MessageConverter;
+	friend class LoopbackHub;
 	public:
 		IPAACA_MEMBER_VAR_EXPORT Payload _payload;
 	protected:
 		IPAACA_HEADER_EXPORT RemotePushIU();
 		IPAACA_HEADER_EXPORT static boost::shared_ptr<RemotePushIU> create();
+		/// owner announced that it decodes binary payload items
+		IPAACA_MEMBER_VAR_EXPORT bool _owner_accepts_binary_payload;
+		/// owner announced that it applies payload patches
+		IPAACA_MEMBER_VAR_EXPORT bool _owner_accepts_payload_patches;
+		/// a payload patch did not match the local state; waiting for the full IU from the owner
+		IPAACA_MEMBER_VAR_EXPORT bool _resync_pending;
+		IPAACA_MEMBER_VAR_EXPORT bool _async_writes;
+		/// write sent to the owner whose reply has not been collected yet
+		struct PendingWrite {
+			RevisionFuture result;
+			/// true once the reply is there, i.e. result.get() does not block
+			std::function<bool()> answered;
+			/// collected by a remote write batch, only answered on flush_remote_write_batch()
+			bool batched;
+			/// revision the write was sent with (the owner's revision is one higher afterwards)
+			revision_t revision;
+			PendingWrite(): batched(false), revision(0) { }
+		};
+		IPAACA_MEMBER_VAR_EXPORT Lock _revision_lock;
+		IPAACA_MEMBER_VAR_EXPORT Lock _pending_writes_lock;
+		IPAACA_MEMBER_VAR_EXPORT std::deque<PendingWrite> _pending_writes;
+		IPAACA_MEMBER_VAR_EXPORT RevisionFuture _last_write;
+		/// an answered write failed after being dropped from _pending_writes; reported by wait_for_writes()
+		IPAACA_MEMBER_VAR_EXPORT bool _collected_write_failed;
+		/// revision to send with the next write: the known one, or the one after the last write in flight
+		IPAACA_HEADER_EXPORT revision_t _next_write_revision();
+		IPAACA_HEADER_EXPORT void _track_pending_write(const PendingWrite& write);
+		/// collect all answered writes (needs _pending_writes_lock)
+		IPAACA_HEADER_EXPORT void _collect_answered_writes();
+		IPAACA_HEADER_EXPORT void _collect_write(const PendingWrite& write);
+		IPAACA_HEADER_EXPORT void _note_write_result(revision_t revision);
+		IPAACA_HEADER_EXPORT void _set_revision(revision_t revision);
+		/// send an update to the owner of the IU, without waiting for the reply
+		template<class CallbackT, class UpdateT> PendingWrite _call_owner(const std::string& method_name, boost::shared_ptr<UpdateT> update);
+		/// send the commission (see commit_async()); invalid result if already committed
+		IPAACA_HEADER_EXPORT PendingWrite _send_commission();
 	public:
 		IPAACA_HEADER_EXPORT inline ~RemotePushIU() {
 		}
 		IPAACA_HEADER_EXPORT inline Payload& payload() _IPAACA_OVERRIDE_ { return _payload; }
 		IPAACA_HEADER_EXPORT inline const Payload& const_payload() const _IPAACA_OVERRIDE_ { return _payload; }
 		IPAACA_HEADER_EXPORT void commit() _IPAACA_OVERRIDE_;
+		/// Commit without waiting for the owner's reply
+		IPAACA_HEADER_EXPORT RevisionFuture commit_async();
+		/// Enable / disable pipelined (non-blocking) payload and link writes
+		IPAACA_HEADER_EXPORT void set_async_writes(bool async_writes);
+		IPAACA_HEADER_EXPORT inline bool async_writes() const { return _async_writes; }
+		/// Future for the most recent asynchronous write (invalid if there was none)
+		IPAACA_HEADER_EXPORT RevisionFuture last_write();
+		/// Block until all outstanding asynchronous writes have completed, rethrowing the first failure (flush a remote write batch first)
+		IPAACA_HEADER_EXPORT void wait_for_writes();
 	protected:
 		IPAACA_HEADER_EXPORT void _modify_links(bool is_delta, const LinkMap& new_links, const LinkMap& links_to_remove, const std::string& writer_name = "") _IPAACA_OVERRIDE_;
 		IPAACA_HEADER_EXPORT void _modify_payload(bool is_delta, const std::map<std::string, PayloadDocumentEntry::ptr>& new_items, const std::vector<std::string>& keys_to_remove, const std::string& writer_name = "") _IPAACA_OVERRIDE_;
 	protected:
+		/// apply an update; payload patches that do not match the local state are left out and set _resync_pending
 		IPAACA_HEADER_EXPORT void _apply_update(IUPayloadUpdate::ptr update);
 		IPAACA_HEADER_EXPORT void _apply_link_update(IULinkUpdate::ptr update);
 		IPAACA_HEADER_EXPORT void _apply_commission();
 		IPAACA_HEADER_EXPORT void _apply_retraction();
+		/// take over the state of a freshly received copy (resent by the owner), ending a pending resync
+		IPAACA_HEADER_EXPORT void _apply_resync(boost::shared_ptr<RemotePushIU> fresh);
 	typedef boost::shared_ptr<RemotePushIU> ptr;
 };//}}}
 /// Copy of a remote Message, received in an InputBuffer. Setter functions all fail.\b Note: Typically handled only as reference in a handler in user space.
@@ -263,6 +358,7 @@ class RemoteMessage: public IUInterface {//{{{
 	friend class OutputBuffer;
 	friend class IUConverter;
 	friend class MessageConverter;
+	friend class LoopbackHub;
 	public:
 		IPAACA_MEMBER_VAR_EXPORT Payload _payload;
 	protected:
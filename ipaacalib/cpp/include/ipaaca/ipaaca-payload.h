@@ -112,27 +112,201 @@ template<typename T> void pack_into_json_value(rapidjson::Value& valueobject, ra
 	}
 }
 
-/// Single payload entry wrapping a rapidjson::Document with some conversion glue. Also handles copy-on-write Document cloning. <b>Internal type</b> - users generally do not see this.
+/** \brief Path-level changes turning one payload entry into its successor. <b>Internal type</b>.
+ *
+ * The operations are a JSON array in the style of RFC 6902 (JSON Patch), with
+ * RFC 6901 paths relative to the entry document:
+ * {"op":"replace","path":"/a/0","value":...} and {"op":"add","path":"/list/-","value":...}.
+ * Recorded by nested PayloadEntryProxy writes and appends when payload patches are
+ * enabled (--ipaaca-payload-patches on), and sent instead of the whole entry.
+ */
+class PayloadEntryPatch//{{{
+{
+	public:
+		/// entry_id of the entry the operations apply to
+		IPAACA_MEMBER_VAR_EXPORT uint64_t base_entry_id;
+		IPAACA_MEMBER_VAR_EXPORT rapidjson::Document operations;
+		IPAACA_HEADER_EXPORT inline PayloadEntryPatch(uint64_t base): base_entry_id(base) { operations.SetArray(); }
+		IPAACA_HEADER_EXPORT inline ~PayloadEntryPatch() { }
+		IPAACA_HEADER_EXPORT void write_operations(std::string& out) const;
+		/// Apply all operations to document (throws PayloadPatchError)
+		IPAACA_HEADER_EXPORT void apply_to(rapidjson::Document& document) const;
+	typedef std::shared_ptr<PayloadEntryPatch> ptr;
+};
+//}}}
+
+/** \brief Single payload entry wrapping a rapidjson::Document with some conversion glue. Also handles copy-on-write Document cloning. <b>Internal type</b> - users generally do not see this.
+ *
+ * Entries received from the wire keep their serialized form and are only
+ * parsed on first access (ensure_parsed(), called by Payload::get_entry()
+ * and the other readers). Until then, the serialized form is passed on
+ * as-is when the entry is sent again in the same encoding.
+ */
 class PayloadDocumentEntry//{{{
 {
 	friend std::ostream& operator<<(std::ostream& os, std::shared_ptr<PayloadDocumentEntry> entry);
+	public:
+		/// Encoding of a not yet parsed entry
+		enum UnparsedEncoding { UNPARSED_NONE, UNPARSED_JSON, UNPARSED_BINARY };
+	protected:
+		IPAACA_MEMBER_VAR_EXPORT std::atomic<bool> _parsed;
+		IPAACA_MEMBER_VAR_EXPORT UnparsedEncoding _unparsed_encoding;
+		IPAACA_MEMBER_VAR_EXPORT std::string _unparsed;
+		IPAACA_MEMBER_VAR_EXPORT ipaaca::Lock _parse_lock;
+		IPAACA_MEMBER_VAR_EXPORT bool _unresolved_patch;
+		IPAACA_HEADER_EXPORT void _parse();
+		IPAACA_HEADER_EXPORT static uint64_t _next_entry_id();
+		IPAACA_HEADER_EXPORT static void _append_json_pointer(std::string& path, PayloadEntryProxy* pep);
 	public:
 		IPAACA_MEMBER_VAR_EXPORT ipaaca::Lock lock;
 		IPAACA_MEMBER_VAR_EXPORT bool modified;
+		/// Created by a proxy write in the current batch update and not yet visible to anyone else: further writes may modify it in place
+		IPAACA_MEMBER_VAR_EXPORT bool batch_owned;
+		/// The json value. \b Note: call ensure_parsed() before accessing it on entries that may come from the wire
 		IPAACA_MEMBER_VAR_EXPORT rapidjson::Document document;
-		IPAACA_HEADER_EXPORT inline PayloadDocumentEntry(): modified(false) { }
+		/// Process-unique identity of this entry state (0: unknown, e.g. received from a sender not tracking it)
+		IPAACA_MEMBER_VAR_EXPORT uint64_t entry_id;
+		/// Changes against the entry this one was derived from, if recorded (see PayloadEntryPatch)
+		IPAACA_MEMBER_VAR_EXPORT PayloadEntryPatch::ptr patch;
+		IPAACA_HEADER_EXPORT inline PayloadDocumentEntry(): _parsed(true), _unparsed_encoding(UNPARSED_NONE), _unresolved_patch(false), modified(false), batch_owned(false), entry_id(_next_entry_id()) { }
 		IPAACA_HEADER_EXPORT inline ~PayloadDocumentEntry() { }
+		/// Parse the retained wire representation, if not done yet (throws JsonParsingError / BinaryPayloadError)
+		IPAACA_HEADER_EXPORT inline void ensure_parsed() { if (! _parsed.load(std::memory_order_acquire)) _parse(); }
+		IPAACA_HEADER_EXPORT inline bool is_parsed() const { return _parsed.load(std::memory_order_acquire); }
+		/// Entry that keeps JSON text from the wire, to be parsed on first access
+		IPAACA_HEADER_EXPORT static std::shared_ptr<PayloadDocumentEntry> from_unparsed_json(const std::string& input);
+		/// Entry that keeps a binary representation from the wire, to be decoded on first access
+		IPAACA_HEADER_EXPORT static std::shared_ptr<PayloadDocumentEntry> from_unparsed_binary(const std::string& input);
 		IPAACA_HEADER_EXPORT std::string to_json_string_representation();
+		/// Like to_json_string_representation(), but writing into (and reusing the capacity of) out
+		IPAACA_HEADER_EXPORT void write_json_string_representation(std::string& out);
 		IPAACA_HEADER_EXPORT static std::shared_ptr<PayloadDocumentEntry> from_json_string_representation(const std::string& input);
+		/// Compact binary encoding of the document (wire item type "BIN"), avoids number formatting and parsing
+		IPAACA_HEADER_EXPORT std::string to_binary_representation();
+		/// Like to_binary_representation(), but writing into (and reusing the capacity of) out
+		IPAACA_HEADER_EXPORT void write_binary_representation(std::string& out);
+		IPAACA_HEADER_EXPORT static std::shared_ptr<PayloadDocumentEntry> from_binary_representation(const std::string& input);
 		IPAACA_HEADER_EXPORT static std::shared_ptr<PayloadDocumentEntry> from_unquoted_string_value(const std::string& input);
 		IPAACA_HEADER_EXPORT static std::shared_ptr<PayloadDocumentEntry> create_null();
 		IPAACA_HEADER_EXPORT std::shared_ptr<PayloadDocumentEntry> clone();
+		/// Approximate memory use in bytes (retained wire representation or document memory pool)
+		IPAACA_HEADER_EXPORT size_t estimated_size();
 		IPAACA_HEADER_EXPORT rapidjson::Value& get_or_create_nested_value_from_proxy_path(PayloadEntryProxy* pep);
+		/// Record the write of value at the proxy path (or its append to the list there) into patch, if payload patches are enabled
+		IPAACA_HEADER_EXPORT void record_patch_operation(PayloadEntryProxy* pep, const rapidjson::Value& value, bool append);
+		/// Record the write of value at a JSON pointer path ("add" if append) into patch, this entry being derived from source (or modified in place)
+		IPAACA_HEADER_EXPORT void record_patch_operation(const PayloadDocumentEntry* source, const std::string& path, const rapidjson::Value& value, bool append);
+		/// Entry received as a patch; has no document until resolved against its base entry
+		IPAACA_HEADER_EXPORT static std::shared_ptr<PayloadDocumentEntry> from_unresolved_patch(const std::string& operations_json, uint64_t base_entry_id, uint64_t entry_id);
+		IPAACA_HEADER_EXPORT inline bool is_unresolved_patch() const { return _unresolved_patch; }
+		/// Apply this (unresolved) patch to a clone of base, keeping entry_id and patch (throws PayloadPatchError)
+		IPAACA_HEADER_EXPORT std::shared_ptr<PayloadDocumentEntry> resolve_patch(std::shared_ptr<PayloadDocumentEntry> base);
 	typedef std::shared_ptr<PayloadDocumentEntry> ptr;
 };
 //}}}
 
-typedef std::map<std::string, PayloadDocumentEntry::ptr> PayloadDocumentStore;
+/** \brief Key -> entry store of a Payload. <b>Internal type</b>.
+ *
+ * Payloads mostly have few keys, so the entries are kept in one vector sorted
+ * by key: lookups are a binary search over contiguous memory instead of a walk
+ * over tree nodes. Provides the part of the std::map interface used by ipaaca.
+ * Payload never modifies a published store, see Payload::_snapshot().
+ */
+class PayloadDocumentStore//{{{
+{
+	public:
+		typedef std::pair<std::string, PayloadDocumentEntry::ptr> value_type;
+		typedef std::vector<value_type>::iterator iterator;
+		typedef std::vector<value_type>::const_iterator const_iterator;
+	protected:
+		IPAACA_MEMBER_VAR_EXPORT std::vector<value_type> _items;
+		IPAACA_HEADER_EXPORT inline static bool _key_less(const value_type& item, const std::string& key) { return item.first < key; }
+		IPAACA_HEADER_EXPORT inline iterator _lower_bound(const std::string& key) { return std::lower_bound(_items.begin(), _items.end(), key, _key_less); }
+		IPAACA_HEADER_EXPORT inline const_iterator _lower_bound(const std::string& key) const { return std::lower_bound(_items.begin(), _items.end(), key, _key_less); }
+	public:
+		IPAACA_HEADER_EXPORT inline PayloadDocumentStore() { }
+		IPAACA_HEADER_EXPORT inline PayloadDocumentStore(const std::map<std::string, PayloadDocumentEntry::ptr>& contents) { *this = contents; }
+		IPAACA_HEADER_EXPORT inline PayloadDocumentStore& operator=(const std::map<std::string, PayloadDocumentEntry::ptr>& contents) {
+			// already in key order
+			_items.assign(contents.begin(), contents.end());
+			return *this;
+		}
+		IPAACA_HEADER_EXPORT inline iterator begin() { return _items.begin(); }
+		IPAACA_HEADER_EXPORT inline iterator end() { return _items.end(); }
+		IPAACA_HEADER_EXPORT inline const_iterator begin() const { return _items.begin(); }
+		IPAACA_HEADER_EXPORT inline const_iterator end() const { return _items.end(); }
+		IPAACA_HEADER_EXPORT inline size_t size() const { return _items.size(); }
+		IPAACA_HEADER_EXPORT inline bool empty() const { return _items.empty(); }
+		IPAACA_HEADER_EXPORT inline void clear() { _items.clear(); }
+		IPAACA_HEADER_EXPORT inline iterator find(const std::string& key) {
+			iterator it = _lower_bound(key);
+			return ((it != _items.end()) && (it->first == key)) ? it : _items.end();
+		}
+		IPAACA_HEADER_EXPORT inline const_iterator find(const std::string& key) const {
+			const_iterator it = _lower_bound(key);
+			return ((it != _items.end()) && (it->first == key)) ? it : _items.end();
+		}
+		IPAACA_HEADER_EXPORT inline size_t count(const std::string& key) const { return (find(key) != end()) ? 1 : 0; }
+		IPAACA_HEADER_EXPORT inline PayloadDocumentEntry::ptr& operator[](const std::string& key) {
+			iterator it = _lower_bound(key);
+			if ((it == _items.end()) || (it->first != key)) {
+				it = _items.insert(it, value_type(key, PayloadDocumentEntry::ptr()));
+			}
+			return it->second;
+		}
+		IPAACA_HEADER_EXPORT inline size_t erase(const std::string& key) {
+			iterator it = find(key);
+			if (it == _items.end()) return 0;
+			_items.erase(it);
+			return 1;
+		}
+	typedef std::shared_ptr<const PayloadDocumentStore> const_ptr;
+};
+//}}}
+
+/** \brief Precompiled path to a value inside the payload, for repeated access without proxy chains.
+ *
+ * Written as a JSON pointer (RFC 6901) whose first token is the payload key,
+ * e.g. "/a/b/3" addresses payload()["a"]["b"][3]. The path is parsed once;
+ * Payload::get() and Payload::set() then walk the document directly.
+ * Numeric tokens address list items or map keys, depending on the value found.
+ * A final "-" token appends to a list on writes.
+ *
+ * \code
+ * static const ipaaca::PayloadPath last_word("/words/0/text");
+ * std::string text = iu->payload().get<std::string>(last_word);
+ * iu->payload().set(ipaaca::PayloadPath("/words/-"), "next");
+ * \endcode
+ */
+class PayloadPath//{{{
+{
+	protected:
+		struct Step {
+			std::string name; ///< unescaped token
+			long index; ///< token as list index, -1 if not numeric
+			bool append; ///< token "-"
+		};
+		IPAACA_MEMBER_VAR_EXPORT std::string _key;
+		IPAACA_MEMBER_VAR_EXPORT std::vector<Step> _steps;
+		IPAACA_MEMBER_VAR_EXPORT std::string _entry_pointer;
+		IPAACA_HEADER_EXPORT static rapidjson::Value* _step(rapidjson::Value& value, const Step& step);
+	public:
+		/// Parse a JSON pointer (throws PayloadAddressingError if it does not start with '/')
+		IPAACA_HEADER_EXPORT explicit PayloadPath(const std::string& pointer);
+		/// Payload key (first token)
+		IPAACA_HEADER_EXPORT inline const std::string& key() const { return _key; }
+		/// Number of steps below the payload key
+		IPAACA_HEADER_EXPORT inline size_t depth() const { return _steps.size(); }
+		/// The path below the payload key, as a JSON pointer into the entry document
+		IPAACA_HEADER_EXPORT inline const std::string& entry_pointer() const { return _entry_pointer; }
+		/// Value addressed in an entry document, or nullptr
+		IPAACA_HEADER_EXPORT const rapidjson::Value* find(const rapidjson::Value& root) const;
+		/// Move value to the addressed position of document and return it there (throws PayloadAddressingError)
+		IPAACA_HEADER_EXPORT rapidjson::Value& place(rapidjson::Document& document, rapidjson::Value& value) const;
+		/// Whether the path ends in "-" (list append)
+		IPAACA_HEADER_EXPORT inline bool appends() const { return (!_steps.empty()) && _steps.back().append; }
+};
+//}}}
 
 
 /** \brief Central class containing the user-set payload of any IUInterface class (IU, Message, RemotePushIU or RemoteMessage)
@@ -150,12 +324,16 @@ class Payload: public Lock //{{{
 	friend class IUConverter;
 	friend class MessageConverter;
 	friend class CallbackIUPayloadUpdate;
+	friend class LoopbackHub;
 	friend class PayloadEntryProxy;
 	friend class PayloadIterator;
 	friend class FakeIU;
 	protected:
-		IPAACA_MEMBER_VAR_EXPORT std::string _owner_name;
-		IPAACA_MEMBER_VAR_EXPORT PayloadDocumentStore _document_store;
+		IPAACA_MEMBER_VAR_EXPORT InternedString _owner_name;
+		/// Current store version. Published versions are immutable: writers copy, modify and
+		/// publish a new version (serialized by _store_write_lock), readers take a snapshot.
+		IPAACA_MEMBER_VAR_EXPORT PayloadDocumentStore::const_ptr _document_store;
+		IPAACA_MEMBER_VAR_EXPORT Lock _store_write_lock;
 		IPAACA_MEMBER_VAR_EXPORT boost::weak_ptr<IUInterface> _iu;
 		IPAACA_MEMBER_VAR_EXPORT Lock _payload_operation_mode_lock; //< enforcing atomicity wrt the bool flag below
 		IPAACA_MEMBER_VAR_EXPORT bool _update_on_every_change; //< true: batch update not active; false: collecting updates (payload locked)
@@ -172,17 +350,46 @@ class Payload: public Lock //{{{
 	protected:
 		IPAACA_HEADER_EXPORT void initialize(boost::shared_ptr<IUInterface> iu);
 		IPAACA_HEADER_EXPORT inline void _set_owner_name(const std::string& name) { _owner_name = name; }
+		/// Consistent, immutable view of the current entries; no lock taken, stays valid while held
+		IPAACA_HEADER_EXPORT inline PayloadDocumentStore::const_ptr _snapshot() const { return std::atomic_load(&_document_store); }
+		/// Apply modifier to a copy of the current entries and publish the result
+		template<typename F> void _update_store(F modifier)
+		{
+			Locker locker(_store_write_lock);
+			std::shared_ptr<PayloadDocumentStore> next = std::make_shared<PayloadDocumentStore>(*_snapshot());
+			modifier(*next);
+			std::atomic_store(&_document_store, PayloadDocumentStore::const_ptr(next));
+			mark_revision_change();
+		}
+		/// Publish a complete new set of entries (e.g. received, or shared with another payload)
+		IPAACA_HEADER_EXPORT void _replace_store(PayloadDocumentStore::const_ptr store);
 		IPAACA_HEADER_EXPORT void _remotely_enforced_wipe();
 		IPAACA_HEADER_EXPORT void _remotely_enforced_delitem(const std::string& k);
 		IPAACA_HEADER_EXPORT void _remotely_enforced_setitem(const std::string& k, PayloadDocumentEntry::ptr entry);
+		/// Apply an update as a whole (one copy of the entries, published once).
+		/// Local changes are applied by IUInterface::_modify_payload, under the IU's revision lock.
+		IPAACA_HEADER_EXPORT void _apply_update(bool is_delta, const std::map<std::string, PayloadDocumentEntry::ptr>& new_items, const std::vector<std::string>& keys_to_remove);
+		/// apply a received update
+		IPAACA_HEADER_EXPORT inline void _remotely_enforced_update(bool is_delta, const std::map<std::string, PayloadDocumentEntry::ptr>& new_items, const std::vector<std::string>& keys_to_remove) { _apply_update(is_delta, new_items, keys_to_remove); }
 		IPAACA_HEADER_EXPORT void _internal_replace_all(const std::map<std::string, PayloadDocumentEntry::ptr>& new_contents, const std::string& writer_name="");
 		IPAACA_HEADER_EXPORT void _internal_merge(const std::map<std::string, PayloadDocumentEntry::ptr>& contents_to_merge, const std::string& writer_name="");
 		IPAACA_HEADER_EXPORT void _internal_set(const std::string& k, PayloadDocumentEntry::ptr v, const std::string& writer_name="");
 		IPAACA_HEADER_EXPORT void _internal_remove(const std::string& k, const std::string& writer_name="");
 		IPAACA_HEADER_EXPORT void _internal_merge_and_remove(const std::map<std::string, PayloadDocumentEntry::ptr>& contents_to_merge, const std::vector<std::string>& keys_to_remove, const std::string& writer_name="");
+		/**
+		 * Entry to apply a proxy write of key k to: the current entry itself if it is batch_owned
+		 * and not referenced beyond the writer's own writer_refs references (plus the batch), a copy otherwise
+		 */
+		IPAACA_HEADER_EXPORT PayloadDocumentEntry::ptr _writable_entry(const std::string& k, const PayloadDocumentEntry::ptr& current, long writer_refs=1);
+		/// set an entry obtained from _writable_entry() (in a batch update, later writes may modify it in place)
+		IPAACA_HEADER_EXPORT void _set_written_entry(const std::string& k, PayloadDocumentEntry::ptr entry);
+		/// queue an entry in batch mode, folding its patch into the one of an already queued predecessor
+		IPAACA_HEADER_EXPORT void _collect_modification(const std::string& k, PayloadDocumentEntry::ptr v);
+		/// Resolve received patch entries against the current entries; false if any did not match (those are left out of resolved)
+		IPAACA_HEADER_EXPORT bool _resolve_patches(const std::map<std::string, PayloadDocumentEntry::ptr>& items, std::map<std::string, PayloadDocumentEntry::ptr>& resolved);
 	public:
-		IPAACA_HEADER_EXPORT inline Payload(): _batch_update_writer_name(""), _update_on_every_change(true) { }
-		IPAACA_HEADER_EXPORT inline const std::string& owner_name() { return _owner_name; }
+		IPAACA_HEADER_EXPORT inline Payload(): _document_store(std::make_shared<PayloadDocumentStore>()), _update_on_every_change(true), _batch_update_writer_name(""), internal_revision(0) { }
+		IPAACA_HEADER_EXPORT inline const std::string& owner_name() { return _owner_name.str(); }
 		// access
 		/// Obtain a payload item by name as a PayloadEntryProxy (returning null-type proxy if undefined)
 		IPAACA_HEADER_EXPORT PayloadEntryProxy operator[](const std::string& key);
@@ -192,6 +399,8 @@ class Payload: public Lock //{{{
 		IPAACA_HEADER_EXPORT inline void remove(const std::string& k) { _internal_remove(k); }
 		/// Legacy / convenience function: set the whole payload map from a map string->string (all JSON types are also set as string, no interpretation)
 		IPAACA_HEADER_EXPORT void set(const std::map<std::string, std::string>& all_elems);
+		/// Approximate memory use of all entries in bytes
+		IPAACA_HEADER_EXPORT size_t estimated_size() const;
 	protected:
 		/// set or overwrite a single payload entry with a PayloadDocumentEntry object (used by PayloadEntryProxy::operator=()).
 		IPAACA_HEADER_EXPORT inline void set(const std::string& k, PayloadDocumentEntry::ptr entry) { _internal_set(k, entry); }
@@ -200,8 +409,27 @@ class Payload: public Lock //{{{
 		[[deprecated("Use operator[] and operator std::string() instead")]]
 		/// Read a single entry as string [DEPRECATED] (use string conversion in PayloadEntryProxy instead)
 		IPAACA_HEADER_EXPORT std::string get(const std::string& k);
+		/// Read the value at a precompiled path (with the same conversions as PayloadEntryProxy; default value if absent)
+		template<typename T> T get(const PayloadPath& path)
+		{
+			PayloadDocumentEntry::ptr entry = get_entry(path.key());
+			return json_value_cast<T>(path.find(entry->document));
+		}
+		/// Whether a (non-null) value exists at a precompiled path
+		IPAACA_HEADER_EXPORT bool has(const PayloadPath& path);
+		/// Write a value at a precompiled path, like the equivalent PayloadEntryProxy assignment (or push_back for a final "-")
+		template<typename T> void set(const PayloadPath& path, T t)
+		{
+			PayloadDocumentEntry::ptr current = get_entry(path.key());
+			PayloadDocumentEntry::ptr new_entry = _writable_entry(path.key(), current);
+			rapidjson::Value newval;
+			pack_into_json_value(newval, new_entry->document.GetAllocator(), t);
+			rapidjson::Value& placed = path.place(new_entry->document, newval);
+			if (path.depth() > 0) new_entry->record_patch_operation(current.get(), path.entry_pointer(), placed, path.appends());
+			_set_written_entry(path.key(), new_entry);
+		}
 	protected:
-		IPAACA_MEMBER_VAR_EXPORT unsigned long internal_revision;
+		IPAACA_MEMBER_VAR_EXPORT std::atomic<unsigned long> internal_revision;
 		IPAACA_MEMBER_VAR_EXPORT inline void mark_revision_change() { internal_revision++; }
 		IPAACA_HEADER_EXPORT inline bool revision_changed(unsigned long reference_revision) { return internal_revision != reference_revision; }
 	public:
@@ -209,6 +437,8 @@ class Payload: public Lock //{{{
 		IPAACA_HEADER_EXPORT PayloadIterator begin();
 		/// obtain a standard iterator past the last entry in the payload
 		IPAACA_HEADER_EXPORT PayloadIterator end();
+		/// obtain a read-only snapshot of the entries for allocation-free iteration (pending batch writes are not included)
+		IPAACA_HEADER_EXPORT PayloadView view();
 	typedef boost::shared_ptr<Payload> ptr;
 };//}}}
 
@@ -229,10 +459,13 @@ class PayloadIterator//{{{
 	friend std::ostream& operator<<(std::ostream& os, const PayloadIterator& iter);
 	protected:
 		IPAACA_MEMBER_VAR_EXPORT Payload* _payload;
-		IPAACA_MEMBER_VAR_EXPORT unsigned long reference_payload_revision;
-		IPAACA_MEMBER_VAR_EXPORT PayloadDocumentStore::iterator raw_iterator;
+		/// the store version being iterated (not affected by concurrent payload changes)
+		IPAACA_MEMBER_VAR_EXPORT PayloadDocumentStore::const_ptr _store;
+		IPAACA_MEMBER_VAR_EXPORT PayloadDocumentStore::const_iterator raw_iterator;
+		IPAACA_HEADER_EXPORT inline bool _at_end() const { return (!_store) || (raw_iterator == _store->end()); }
 	protected:
-		IPAACA_HEADER_EXPORT PayloadIterator(Payload* payload, PayloadDocumentStore::iterator&& pl_iter ); //, bool is_end);
+		/// iterator at the beginning of the current entries, or the end marker
+		IPAACA_HEADER_EXPORT PayloadIterator(Payload* payload, bool is_end);
 	public:
 		IPAACA_HEADER_EXPORT PayloadIterator(const PayloadIterator& iter);
 		IPAACA_HEADER_EXPORT PayloadIterator& operator++();
@@ -299,6 +532,119 @@ class PayloadEntryProxyListDecorator//{{{
 };
 //}}}
 
+/// Forward iterator for the payload view types (dereferencing wraps the raw element, without allocation)
+template<typename Raw, typename View> class PayloadViewIterator//{{{
+{
+	protected:
+		IPAACA_MEMBER_VAR_EXPORT Raw _raw;
+	public:
+		IPAACA_HEADER_EXPORT inline explicit PayloadViewIterator(Raw raw): _raw(raw) { }
+		IPAACA_HEADER_EXPORT inline PayloadViewIterator& operator++() { ++_raw; return *this; }
+		IPAACA_HEADER_EXPORT inline View operator*() const { return View(&*_raw); }
+		IPAACA_HEADER_EXPORT inline bool operator==(const PayloadViewIterator& other) const { return _raw == other._raw; }
+		IPAACA_HEADER_EXPORT inline bool operator!=(const PayloadViewIterator& other) const { return _raw != other._raw; }
+};
+//}}}
+/// Pair of view iterators, for range-based for loops
+template<typename Iterator> class PayloadViewRange//{{{
+{
+	protected:
+		IPAACA_MEMBER_VAR_EXPORT Iterator _begin;
+		IPAACA_MEMBER_VAR_EXPORT Iterator _end;
+	public:
+		IPAACA_HEADER_EXPORT inline PayloadViewRange(Iterator begin, Iterator end): _begin(begin), _end(end) { }
+		IPAACA_HEADER_EXPORT inline Iterator begin() const { return _begin; }
+		IPAACA_HEADER_EXPORT inline Iterator end() const { return _end; }
+};
+//}}}
+/** \brief Read-only view of a json value in a payload entry
+ *
+ * Views are plain pointers into a json document: navigation, conversion and iteration
+ * neither copy values nor look up payload keys again. A view is only valid as long as
+ * the PayloadView (or PayloadEntryProxy) it was obtained from.
+ *
+ * <code>for (auto item: iu->payload().view()) { for (auto v: item.value().elements()) { double d = v.as<double>(); ... } }</code>
+ */
+class PayloadValueView//{{{
+{
+	public:
+		typedef PayloadViewIterator<rapidjson::Value::ConstValueIterator, PayloadValueView> element_iterator;
+		typedef PayloadViewIterator<rapidjson::Value::ConstMemberIterator, PayloadMemberView> member_iterator;
+	protected:
+		IPAACA_MEMBER_VAR_EXPORT const rapidjson::Value* _value;
+	public:
+		IPAACA_HEADER_EXPORT inline explicit PayloadValueView(const rapidjson::Value* value=nullptr): _value(value) { }
+		/// The viewed json value (nullptr if nonexistent)
+		IPAACA_HEADER_EXPORT inline const rapidjson::Value* json_value() const { return _value; }
+		IPAACA_HEADER_EXPORT inline bool is_null() const { return (!_value) || _value->IsNull(); }
+		IPAACA_HEADER_EXPORT inline bool is_string() const { return _value && _value->IsString(); }
+		IPAACA_HEADER_EXPORT inline bool is_number() const { return _value && _value->IsNumber(); }
+		IPAACA_HEADER_EXPORT inline bool is_list() const { return _value && _value->IsArray(); }
+		IPAACA_HEADER_EXPORT inline bool is_map() const { return _value && _value->IsObject(); }
+		/// Convert like PayloadEntryProxy does (default value if nonexistent)
+		template<typename T> T as() const { return json_value_cast<T>(_value); }
+		/// Return number of contained items (or 0 for non-container types)
+		IPAACA_HEADER_EXPORT size_t size() const;
+		/// Array-style navigation (null view if out of range)
+		IPAACA_HEADER_EXPORT PayloadValueView operator[](size_t index) const;
+		/// Array-style navigation (to catch [0], cf. PayloadEntryProxy)
+		IPAACA_HEADER_EXPORT inline PayloadValueView operator[](int index) const { return (index < 0) ? PayloadValueView() : (*this)[(size_t) index]; }
+		/// Dict-style navigation (null view if absent)
+		IPAACA_HEADER_EXPORT PayloadValueView operator[](const char* key) const;
+		/// Dict-style navigation (null view if absent)
+		IPAACA_HEADER_EXPORT inline PayloadValueView operator[](const std::string& key) const { return (*this)[key.c_str()]; }
+		/// Items of a list-type value (empty for other types)
+		IPAACA_HEADER_EXPORT PayloadViewRange<element_iterator> elements() const;
+		/// Members of a map-type value (empty for other types)
+		IPAACA_HEADER_EXPORT PayloadViewRange<member_iterator> members() const;
+};
+//}}}
+/// Member of a map-type value during view iteration
+class PayloadMemberView//{{{
+{
+	protected:
+		IPAACA_MEMBER_VAR_EXPORT const rapidjson::Value::Member* _member;
+	public:
+		IPAACA_HEADER_EXPORT inline explicit PayloadMemberView(const rapidjson::Value::Member* member): _member(member) { }
+		/// Member name (pointing into the json document)
+		IPAACA_HEADER_EXPORT inline const char* key() const { return _member->name.GetString(); }
+		IPAACA_HEADER_EXPORT inline size_t key_length() const { return _member->name.GetStringLength(); }
+		IPAACA_HEADER_EXPORT inline PayloadValueView value() const { return PayloadValueView(&(_member->value)); }
+};
+//}}}
+/// Top-level payload entry during view iteration
+class PayloadItemView//{{{
+{
+	protected:
+		IPAACA_MEMBER_VAR_EXPORT const PayloadDocumentStore::value_type* _item;
+	public:
+		IPAACA_HEADER_EXPORT inline explicit PayloadItemView(const PayloadDocumentStore::value_type* item): _item(item) { }
+		IPAACA_HEADER_EXPORT inline const std::string& key() const { return _item->first; }
+		/// Entry value (received entries are parsed on first access)
+		IPAACA_HEADER_EXPORT inline PayloadValueView value() const { _item->second->ensure_parsed(); return PayloadValueView(&(_item->second->document)); }
+};
+//}}}
+/** \brief Consistent read-only snapshot of all entries of a Payload, see Payload::view()
+ *
+ * Iteration yields PayloadItemView objects (key reference and value view) without
+ * allocating and without looking keys up again. Later payload changes are not visible.
+ */
+class PayloadView//{{{
+{
+	public:
+		typedef PayloadViewIterator<PayloadDocumentStore::const_iterator, PayloadItemView> iterator;
+	protected:
+		IPAACA_MEMBER_VAR_EXPORT PayloadDocumentStore::const_ptr _store;
+	public:
+		IPAACA_HEADER_EXPORT inline explicit PayloadView(PayloadDocumentStore::const_ptr store): _store(store) { }
+		IPAACA_HEADER_EXPORT inline iterator begin() const { return iterator(_store->begin()); }
+		IPAACA_HEADER_EXPORT inline iterator end() const { return iterator(_store->end()); }
+		IPAACA_HEADER_EXPORT inline size_t size() const { return _store->size(); }
+		/// View of a single entry (null view if absent)
+		IPAACA_HEADER_EXPORT PayloadValueView operator[](const std::string& key) const;
+};
+//}}}
+
 /** \brief Reference to an existent or nonexistent payload entry (or a value deeper in the json tree)
  *
  * This class is returned by IUInterface::operator[].
@@ -327,6 +673,11 @@ class PayloadEntryProxyListDecorator//{{{
  * <code>iu->payload()["name_list"].push_back("--- adding some numbers below ---");</code>  // append a supported value to an existing list
  *
  * <code>iu->payload()["name_list"].extend(iu->payload()["double_list"]);</code>  // extend list by items; \b Note: all setters also accept proxies as source values, creating copies of values
+ *
+ * In a batch update (Locker on the payload), repeated writes to the same key modify the new entry
+ * in place. While other proxies still refer to that entry (e.g. a child proxy to a list element,
+ * or a copy of the writing proxy), a write copies it instead; those proxies keep showing the
+ * state before the write.
  */
 class PayloadEntryProxy//{{{
 {
@@ -361,6 +712,8 @@ class PayloadEntryProxy//{{{
 		// constructors for navigation through objects
 		IPAACA_HEADER_EXPORT PayloadEntryProxy(PayloadEntryProxy* parent, const std::string& addressed_key);
 		IPAACA_HEADER_EXPORT PayloadEntryProxy(PayloadEntryProxy* parent, size_t addressed_index);
+		/// number of proxies from this one up to the root that refer to document_entry (see Payload::_writable_entry())
+		IPAACA_HEADER_EXPORT long _entry_refs() const;
 	public:
 		/// Return number of contained items (or 0 for non-container types)
 		IPAACA_HEADER_EXPORT size_t size();
@@ -374,6 +727,8 @@ class PayloadEntryProxy//{{{
 		IPAACA_HEADER_EXPORT bool is_list();
 		/// Return whether value is of map type
 		IPAACA_HEADER_EXPORT bool is_map();
+		/// Read-only view of the navigated value (valid while this proxy exists)
+		IPAACA_HEADER_EXPORT inline PayloadValueView view() const { return PayloadValueView(json_value); }
 	public:
 		/// Array-style navigation over json value
 		IPAACA_HEADER_EXPORT PayloadEntryProxy operator[](size_t index); // array-style navigation
@@ -392,10 +747,11 @@ class PayloadEntryProxy//{{{
 		/// Set or overwrite some portion of a payload from the point navigated to
 		template<typename T> PayloadEntryProxy& operator=(T t)
 		{
-			PayloadDocumentEntry::ptr new_entry = document_entry->clone(); // copy-on-write, no lock required
+			PayloadDocumentEntry::ptr new_entry = _payload->_writable_entry(_key, document_entry, _entry_refs());
 			rapidjson::Value& newval = new_entry->get_or_create_nested_value_from_proxy_path(this);
 			pack_into_json_value(newval, new_entry->document.GetAllocator(), t);
-			_payload->set(_key, new_entry);
+			if (parent) new_entry->record_patch_operation(this, newval, false);
+			_payload->_set_written_entry(_key, new_entry);
 			return *this;
 		}
 		/// Value comparison with other proxy contents
@@ -480,18 +836,20 @@ class PayloadEntryProxy//{{{
 		template<typename T> void push_back(T t)
 		{
 			if ((!json_value) || (!json_value->IsArray())) throw PayloadAddressingError();
-			PayloadDocumentEntry::ptr new_entry = document_entry->clone(); // copy-on-write, no lock required
+			PayloadDocumentEntry::ptr new_entry = _payload->_writable_entry(_key, document_entry, _entry_refs());
 			rapidjson::Value& list = new_entry->get_or_create_nested_value_from_proxy_path(this);
 			rapidjson::Value newval;
 			pack_into_json_value(newval, new_entry->document.GetAllocator(), t);
 			list.PushBack(newval, new_entry->document.GetAllocator());
-			_payload->set(_key, new_entry);
+			new_entry->record_patch_operation(this, list[list.Size()-1], true);
+			_payload->_set_written_entry(_key, new_entry);
 		}
 		/// Append the value of another proxy (or a null value) to a list-type value
 		IPAACA_HEADER_EXPORT void push_back(const PayloadEntryProxy& otherproxy)
 		{
 			if ((!json_value) || (!json_value->IsArray())) throw PayloadAddressingError();
-			PayloadDocumentEntry::ptr new_entry = document_entry->clone(); // copy-on-write, no lock required
+			// values read from the entry being modified must not move underneath: always copy then
+			PayloadDocumentEntry::ptr new_entry = (otherproxy.document_entry == document_entry) ? document_entry->clone() : _payload->_writable_entry(_key, document_entry, _entry_refs());
 			rapidjson::Value& list = new_entry->get_or_create_nested_value_from_proxy_path(this);
 			rapidjson::Value newval;
 			auto valueptr = otherproxy.json_value;
@@ -499,48 +857,54 @@ class PayloadEntryProxy//{{{
 				newval.CopyFrom(*valueptr, new_entry->document.GetAllocator());
 			}
 			list.PushBack(newval, new_entry->document.GetAllocator());
-			_payload->set(_key, new_entry);
+			new_entry->record_patch_operation(this, list[list.Size()-1], true);
+			_payload->_set_written_entry(_key, new_entry);
 		}
 		/// Extend a list-type payload value with a vector containing items of a supported type
 		template<typename T> void extend(const std::vector<T>& ts)
 		{
 			if ((!json_value) || (!json_value->IsArray())) throw PayloadAddressingError();
-			PayloadDocumentEntry::ptr new_entry = document_entry->clone(); // copy-on-write, no lock required
+			PayloadDocumentEntry::ptr new_entry = _payload->_writable_entry(_key, document_entry, _entry_refs());
 			rapidjson::Value& list = new_entry->get_or_create_nested_value_from_proxy_path(this);
 			for (auto& t: ts) {
 				rapidjson::Value newval;
 				pack_into_json_value(newval, new_entry->document.GetAllocator(), t);
 				list.PushBack(newval, new_entry->document.GetAllocator());
+				new_entry->record_patch_operation(this, list[list.Size()-1], true);
 			}
-			_payload->set(_key, new_entry);
+			_payload->_set_written_entry(_key, new_entry);
 		}
 		/// Extend a list-type payload value with a list containing items of a supported type
 		template<typename T> void extend(const std::list<T>& ts)
 		{
 			if ((!json_value) || (!json_value->IsArray())) throw PayloadAddressingError();
-			PayloadDocumentEntry::ptr new_entry = document_entry->clone(); // copy-on-write, no lock required
+			PayloadDocumentEntry::ptr new_entry = _payload->_writable_entry(_key, document_entry, _entry_refs());
 			rapidjson::Value& list = new_entry->get_or_create_nested_value_from_proxy_path(this);
 			for (auto& t: ts) {
 				rapidjson::Value newval;
 				pack_into_json_value(newval, new_entry->document.GetAllocator(), t);
 				list.PushBack(newval, new_entry->document.GetAllocator());
+				new_entry->record_patch_operation(this, list[list.Size()-1], true);
 			}
-			_payload->set(_key, new_entry);
+			_payload->_set_written_entry(_key, new_entry);
 		}
 		/// Extend a list-type payload value with items (copies) from another list-type value
 		IPAACA_HEADER_EXPORT void extend(const PayloadEntryProxy& otherproxy)
 		{
 			if ((!json_value) || (!json_value->IsArray())) throw PayloadAddressingError();
 			if ((!otherproxy.json_value) || (!(otherproxy.json_value->IsArray()))) throw PayloadAddressingError();
-			PayloadDocumentEntry::ptr new_entry = document_entry->clone(); // copy-on-write, no lock required
+			// values read from the entry being modified must not move underneath: always copy then
+			PayloadDocumentEntry::ptr new_entry = (otherproxy.document_entry == document_entry) ? document_entry->clone() : _payload->_writable_entry(_key, document_entry, _entry_refs());
 			rapidjson::Value& list = new_entry->get_or_create_nested_value_from_proxy_path(this);
-			for (size_t i=0; i<otherproxy.json_value->Size(); ++i) {
+			size_t n = otherproxy.json_value->Size();
+			for (size_t i=0; i<n; ++i) {
 				rapidjson::Value newval;
 				rapidjson::Value& value = (*(otherproxy.json_value))[i];
 				newval.CopyFrom(value, new_entry->document.GetAllocator());
 				list.PushBack(newval, new_entry->document.GetAllocator());
+				new_entry->record_patch_operation(this, list[list.Size()-1], true);
 			}
-			_payload->set(_key, new_entry);
+			_payload->_set_written_entry(_key, new_entry);
 		}
 };
 
@@ -129,6 +129,7 @@ IU payload contents: Payload, PayloadEntryProxy
 #include <rsb/converter/ProtocolBufferConverter.h>
 #include <rsb/converter/Converter.h>
 #include <rsb/rsbexports.h>
+#include <rsc/misc/UUID.h>
 #endif
 
 // new json-based payload API, used in several classes
@@ -149,6 +150,20 @@ IU payload contents: Payload, PayloadEntryProxy
 // seconds until remote writes time out
 #define IPAACA_REMOTE_SERVER_TIMEOUT 2.0
 
+// max. number of unresolved asynchronous remote writes per RemotePushIU
+#define IPAACA_REMOTE_WRITE_PIPELINE_DEPTH 32
+
+// number of independently locked parts of the IU stores of buffers
+#define IPAACA_IU_STORE_SHARDS 16
+
+// bytes of event data per channel/category ring of the 'shm' transport
+#define IPAACA_SHM_RING_CAPACITY (8*1024*1024)
+
+// access mode of the segments of the 'shm' transport (default: processes of the same user only)
+#ifndef IPAACA_SHM_SEGMENT_MODE
+#define IPAACA_SHM_SEGMENT_MODE 0600
+#endif
+
 
 #include <iostream>
 
@@ -185,10 +200,15 @@ IU payload contents: Payload, PayloadEntryProxy
 #include <boost/function.hpp>
 #include <boost/shared_ptr.hpp>
 #include <boost/weak_ptr.hpp>
+#include <boost/enable_shared_from_this.hpp>
 #include <boost/pointer_cast.hpp>
 #include <boost/lexical_cast.hpp>
 #include <boost/thread/recursive_mutex.hpp>
 #include <boost/thread/thread.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/shared_mutex.hpp>
+#include <boost/lockfree/queue.hpp>
 
 #endif
 
@@ -197,6 +217,12 @@ IU payload contents: Payload, PayloadEntryProxy
 
 #include <set>
 #include <list>
+#include <deque>
+#include <future>
+#include <functional>
+#include <atomic>
+#include <unordered_map>
+#include <unordered_set>
 #include <algorithm>
 #include <utility>
 #include <initializer_list>
@@ -223,10 +249,16 @@ IPAACA_MEMBER_VAR_EXPORT extern unsigned int __ipaaca_static_option_log_level;
 IPAACA_MEMBER_VAR_EXPORT extern std::string __ipaaca_static_option_rsb_host;
 /// RSB port to connect to (defaults to "" = do not set, use global config)
 IPAACA_MEMBER_VAR_EXPORT extern std::string __ipaaca_static_option_rsb_port;
-/// RSB transport to use (defaults to "" = do not set, use global config)
+/// RSB transport to use (defaults to "" = do not set, use global config), one of "spread", "socket", "shm" (IU events via shared memory, RPC via socket)
 IPAACA_MEMBER_VAR_EXPORT extern std::string __ipaaca_static_option_rsb_transport;
 /// Whether to run in server mode on 'socket' transport (defaults to "" = do not set, use global config)
 IPAACA_MEMBER_VAR_EXPORT extern std::string __ipaaca_static_option_rsb_socketserver;
+/// In-process delivery between buffers of the same process (defaults to "off"), one of: "off", "on" (also publish to the wire), "exclusive" (local delivery only)
+IPAACA_MEMBER_VAR_EXPORT extern std::string __ipaaca_static_option_loopback;
+/// Binary encoding of JSON payload entries on the wire (defaults to "off"), one of: "off", "on" (receivers on the channel are known to support it; writes to remote owners only if the owner announced support)
+IPAACA_MEMBER_VAR_EXPORT extern std::string __ipaaca_static_option_binary_payload;
+IPAACA_MEMBER_VAR_EXPORT extern std::string __ipaaca_static_option_uid_mode;
+IPAACA_MEMBER_VAR_EXPORT extern std::string __ipaaca_static_option_payload_patches;
 
 IPAACA_MEMBER_VAR_EXPORT Lock& logger_lock();
 
@@ -112,10 +112,10 @@ IPAACA_EXPORT IUEventHandler::IUEventHandler(IUEventHandlerFunction function, IU
 	if (categories.size()==0) {
 		_for_all_categories = true;
 	} else {
-		_categories = categories;
+		_categories.insert(categories.begin(), categories.end());
 	}
 }
-IPAACA_EXPORT void IUEventHandler::call(Buffer* buffer, boost::shared_ptr<IUInterface> iu, bool local, IUEventType event_type, const std::string& category)
+IPAACA_EXPORT void IUEventHandler::call(Buffer* buffer, boost::shared_ptr<IUInterface> iu, bool local, IUEventType event_type, const InternedString& category)
 {
 	if (_condition_met(event_type, category)) {
 #if VERBOSE_HANDLERS == 1
@@ -129,12 +129,209 @@ IPAACA_EXPORT void IUEventHandler::call(Buffer* buffer, boost::shared_ptr<IUInte
 }
 //}}}
 
+// IUIndex//{{{
+IPAACA_EXPORT IUState IUIndex::_state_of(IUInterface* iu)
+{
+	if (iu->retracted()) return IU_STATE_RETRACTED;
+	return iu->committed() ? IU_STATE_COMMITTED : IU_STATE_OPEN;
+}
+IPAACA_EXPORT LinkSet IUIndex::_link_targets_of(const LinkMap& links)
+{
+	LinkSet targets;
+	for (auto& kv: links) {
+		targets.insert(kv.second.begin(), kv.second.end());
+	}
+	return targets;
+}
+IPAACA_EXPORT bool IUIndex::_has_link(const LinkMap& links, const std::string& type, const std::string& target)
+{
+	auto it = links.find(type);
+	return (it != links.end()) && it->second.count(target);
+}
+IPAACA_EXPORT void IUIndex::_index_links(const IUId& uid, Entry& entry, const LinkMap& links)
+{
+	for (auto& kv: entry.links) {
+		for (auto& target: kv.second) {
+			if (! _has_link(links, kv.first, target)) _remove(_by_typed_link, TypedLink(InternedString(kv.first), target), uid);
+		}
+	}
+	for (auto& kv: links) {
+		for (auto& target: kv.second) {
+			if (! _has_link(entry.links, kv.first, target)) _add(_by_typed_link[TypedLink(InternedString(kv.first), target)], uid, entry.iu);
+		}
+	}
+	// an IU is in the bucket of a target once, however many link types point there
+	LinkSet old_targets = _link_targets_of(entry.links);
+	LinkSet new_targets = _link_targets_of(links);
+	for (auto& target: old_targets) {
+		if (! new_targets.count(target)) _remove(_by_link_target, target, uid);
+	}
+	for (auto& target: new_targets) {
+		if (! old_targets.count(target)) _add(_by_link_target[target], uid, entry.iu);
+	}
+	entry.links = links;
+}
+IPAACA_EXPORT const IUIndex::Bucket* IUIndex::_linking_bucket(const std::string& target_uid, const InternedString& link_type) const
+{
+	if (link_type.empty()) {
+		auto it = _by_link_target.find(target_uid);
+		return (it == _by_link_target.end()) ? NULL : &(it->second);
+	}
+	auto it = _by_typed_link.find(TypedLink(link_type, target_uid));
+	return (it == _by_typed_link.end()) ? NULL : &(it->second);
+}
+static IUQueryResult::container_type::iterator _find_position(IUQueryResult::container_type& ius, const IUId& uid)
+{
+	return std::lower_bound(ius.begin(), ius.end(), uid, [](const boost::shared_ptr<IUInterface>& iu, const IUId& id) {
+		return iu->binary_uid() < id;
+	});
+}
+IPAACA_EXPORT void IUIndex::_make_writable(Bucket& bucket)
+{
+	// results only get new references under _lock, so a count of 1 cannot change meanwhile
+	if (bucket.ius.use_count() > 1) {
+		bucket.ius = std::make_shared<IUQueryResult::container_type>(*bucket.ius);
+	}
+}
+IPAACA_EXPORT void IUIndex::_add(Bucket& bucket, const IUId& uid, const boost::shared_ptr<IUInterface>& iu)
+{
+	_make_writable(bucket);
+	auto pos = _find_position(*bucket.ius, uid);
+	if ((pos != bucket.ius->end()) && ((*pos)->binary_uid() == uid)) {
+		*pos = iu;
+	} else {
+		bucket.ius->insert(pos, iu);
+	}
+}
+IPAACA_EXPORT void IUIndex::_remove(Bucket& bucket, const IUId& uid)
+{
+	auto pos = _find_position(*bucket.ius, uid);
+	if ((pos == bucket.ius->end()) || ((*pos)->binary_uid() != uid)) return;
+	if (bucket.ius.use_count() > 1) {
+		_make_writable(bucket);
+		pos = _find_position(*bucket.ius, uid);
+	}
+	bucket.ius->erase(pos);
+}
+IPAACA_EXPORT IUQueryResult IUIndex::_result(Bucket& bucket)
+{
+	return IUQueryResult(bucket.ius);
+}
+IPAACA_EXPORT IUQueryResult IUIndex::_empty_result()
+{
+	static const std::shared_ptr<const IUQueryResult::container_type> empty = std::make_shared<const IUQueryResult::container_type>();
+	return IUQueryResult(empty);
+}
+IPAACA_EXPORT void IUIndex::insert(boost::shared_ptr<IUInterface> iu)
+{
+	Locker locker(_lock);
+	const IUId& uid = iu->binary_uid();
+	erase(uid);
+	Entry& entry = _entries[uid];
+	entry.iu = iu;
+	entry.category = iu->interned_category();
+	entry.owner_name = InternedString(iu->owner_name());
+	entry.state = _state_of(iu.get());
+	_add(_all, uid, iu);
+	_add(_by_category[entry.category], uid, iu);
+	_add(_by_owner[entry.owner_name], uid, iu);
+	_add(_by_state[entry.state], uid, iu);
+	_index_links(uid, entry, iu->get_all_links());
+}
+IPAACA_EXPORT void IUIndex::erase(const IUId& uid)
+{
+	Locker locker(_lock);
+	auto it = _entries.find(uid);
+	if (it == _entries.end()) return;
+	Entry& entry = it->second;
+	_remove(_all, uid);
+	_remove(_by_category, entry.category, uid);
+	_remove(_by_owner, entry.owner_name, uid);
+	_remove(_by_state[entry.state], uid);
+	_index_links(uid, entry, LinkMap());
+	_entries.erase(it);
+}
+IPAACA_EXPORT void IUIndex::update_state(IUInterface* iu)
+{
+	Locker locker(_lock);
+	auto it = _entries.find(iu->binary_uid());
+	if (it == _entries.end()) return;
+	Entry& entry = it->second;
+	IUState state = _state_of(iu);
+	if (state == entry.state) return;
+	_remove(_by_state[entry.state], it->first);
+	_add(_by_state[state], it->first, entry.iu);
+	entry.state = state;
+}
+IPAACA_EXPORT void IUIndex::update_links(IUInterface* iu)
+{
+	Locker locker(_lock);
+	auto it = _entries.find(iu->binary_uid());
+	if (it == _entries.end()) return;
+	_index_links(it->first, it->second, iu->get_all_links());
+}
+IPAACA_EXPORT IUQueryResult IUIndex::all()
+{
+	Locker locker(_lock);
+	return _result(_all);
+}
+IPAACA_EXPORT IUQueryResult IUIndex::by_category(const InternedString& category)
+{
+	Locker locker(_lock);
+	return _result(_by_category, category);
+}
+IPAACA_EXPORT IUQueryResult IUIndex::by_owner(const InternedString& owner_name)
+{
+	Locker locker(_lock);
+	return _result(_by_owner, owner_name);
+}
+IPAACA_EXPORT IUQueryResult IUIndex::by_state(IUState state)
+{
+	Locker locker(_lock);
+	return _result(_by_state[state]);
+}
+IPAACA_EXPORT IUQueryResult IUIndex::linking_to(const std::string& target_uid)
+{
+	Locker locker(_lock);
+	return _result(_by_link_target, target_uid);
+}
+IPAACA_EXPORT IUQueryResult IUIndex::linking_to(const std::string& target_uid, const InternedString& link_type)
+{
+	Locker locker(_lock);
+	return _result(_by_typed_link, TypedLink(link_type, target_uid));
+}
+IPAACA_EXPORT IUQueryResult IUIndex::linking_to_closure(const std::string& target_uid, const InternedString& link_type, size_t max_depth)
+{
+	Locker locker(_lock);
+	std::shared_ptr<IUQueryResult::container_type> ius = std::make_shared<IUQueryResult::container_type>();
+	std::set<IUId> visited;
+	visited.insert(IUId(target_uid));
+	std::vector<std::string> frontier(1, target_uid);
+	for (size_t depth = 0; (depth < max_depth) && (! frontier.empty()); ++depth) {
+		std::vector<std::string> next;
+		for (auto& uid: frontier) {
+			const Bucket* bucket = _linking_bucket(uid, link_type);
+			if (! bucket) continue;
+			for (auto& iu: *bucket->ius) {
+				if (visited.insert(iu->binary_uid()).second) {
+					ius->push_back(iu);
+					next.push_back(iu->uid());
+				}
+			}
+		}
+		frontier.swap(next);
+	}
+	return IUQueryResult(ius);
+}
+//}}}
+
 // Buffer//{{{
 IPAACA_EXPORT void Buffer::_allocate_unique_name(const std::string& basename, const std::string& function) {
 	std::string uuid = ipaaca::generate_uuid_string();
 	_basename = basename;
 	_uuid = uuid.substr(0,8);
 	_unique_name = "/ipaaca/component/" + _basename + "ID" + _uuid + "/" + function;
+	_interned_unique_name = _unique_name;
 }
 IPAACA_EXPORT void Buffer::register_handler(IUEventHandlerFunction function, IUEventType event_mask, const std::set<std::string>& categories)
 {
@@ -148,7 +345,7 @@ IPAACA_EXPORT void Buffer::register_handler(IUEventHandlerFunction function, IUE
 	IUEventHandler::ptr handler = IUEventHandler::ptr(new IUEventHandler(function, event_mask, category));
 	_event_handlers.push_back(handler);
 }
-IPAACA_EXPORT void Buffer::call_iu_event_handlers(boost::shared_ptr<IUInterface> iu, bool local, IUEventType event_type, const std::string& category)
+IPAACA_EXPORT void Buffer::call_iu_event_handlers(boost::shared_ptr<IUInterface> iu, bool local, IUEventType event_type, const InternedString& category)
 {
 	//IPAACA_DEBUG("handling an event " << ipaaca::iu_event_type_to_str(event_type) << " for IU " << iu->uid())
 	for (std::vector<IUEventHandler::ptr>::iterator it = _event_handlers.begin(); it != _event_handlers.end(); ++it) {
@@ -162,6 +359,7 @@ IPAACA_EXPORT CallbackIUPayloadUpdate::CallbackIUPayloadUpdate(Buffer* buffer):
 IPAACA_EXPORT CallbackIULinkUpdate::CallbackIULinkUpdate(Buffer* buffer): _buffer(buffer) { }
 IPAACA_EXPORT CallbackIUCommission::CallbackIUCommission(Buffer* buffer): _buffer(buffer) { }
 IPAACA_EXPORT CallbackIUResendRequest::CallbackIUResendRequest(Buffer* buffer): _buffer(buffer) { }
+IPAACA_EXPORT CallbackIUWriteBatch::CallbackIUWriteBatch(Buffer* buffer): _buffer(buffer) { }
 
 IPAACA_EXPORT boost::shared_ptr<int64_t> CallbackIUPayloadUpdate::call(const std::string& methodName, boost::shared_ptr<IUPayloadUpdate> update)
 {
@@ -190,18 +388,19 @@ IPAACA_EXPORT boost::shared_ptr<int64_t> CallbackIUPayloadUpdate::call(const std
 		iu->_revision_lock.unlock();
 		return boost::shared_ptr<int64_t>(new int64_t(0));
 	}
+	std::map<std::string, PayloadDocumentEntry::ptr> new_items;
+	if (! iu->_payload._resolve_patches(update->new_items, new_items)) {
+		IPAACA_WARNING("Remote write operation failed because a payload patch did not match the current entry; IU " << update->uid)
+		iu->_revision_lock.unlock();
+		return boost::shared_ptr<int64_t>(new int64_t(0));
+	}
 	if (update->is_delta) {
-		// FIXME TODO this is an unsolved problem atm: deletions in a delta update are
-		// sent individually. We should have something like _internal_merge_and_remove
-		for (std::vector<std::string>::const_iterator it=update->keys_to_remove.begin(); it!=update->keys_to_remove.end(); ++it) {
-			iu->payload()._internal_remove(*it, update->writer_name); //_buffer->unique_name());
-		}
-		// but it is solved for pure merges:
-		iu->payload()._internal_merge(update->new_items, update->writer_name);
+		// removals and merges as one change: every write increases the revision by one (see RemotePushIU::_next_write_revision)
+		iu->payload()._internal_merge_and_remove(new_items, update->keys_to_remove, update->writer_name);
 	} else {
-		iu->payload()._internal_replace_all(update->new_items, update->writer_name); //_buffer->unique_name());
+		iu->payload()._internal_replace_all(new_items, update->writer_name); //_buffer->unique_name());
 	}
-	_buffer->call_iu_event_handlers(iu, true, IU_UPDATED, iu->category());
+	_buffer->call_iu_event_handlers(iu, true, IU_UPDATED, iu->interned_category());
 	revision_t revision = iu->revision();
 	iu->_revision_lock.unlock();
 	return boost::shared_ptr<int64_t>(new int64_t(revision));
@@ -238,7 +437,7 @@ IPAACA_EXPORT boost::shared_ptr<int64_t> CallbackIULinkUpdate::call(const std::s
 	} else {
 		iu->set_links(update->new_links, update->writer_name);
 	}
-	_buffer->call_iu_event_handlers(iu, true, IU_LINKSUPDATED, iu->category());
+	_buffer->call_iu_event_handlers(iu, true, IU_LINKSUPDATED, iu->interned_category());
 	revision_t revision = iu->revision();
 	iu->_revision_lock.unlock();
 	return boost::shared_ptr<int64_t>(new int64_t(revision));
@@ -265,7 +464,7 @@ IPAACA_EXPORT boost::shared_ptr<int64_t> CallbackIUCommission::call(const std::s
 	} else {
 	}
 	iu->_internal_commit(update->writer_name());
-	_buffer->call_iu_event_handlers(iu, true, IU_LINKSUPDATED, iu->category());
+	_buffer->call_iu_event_handlers(iu, true, IU_LINKSUPDATED, iu->interned_category());
 	revision_t revision = iu->revision();
 	iu->_revision_lock.unlock();
 	return boost::shared_ptr<int64_t>(new int64_t(revision));
@@ -287,16 +486,86 @@ IPAACA_EXPORT boost::shared_ptr<int64_t> CallbackIUResendRequest::call(const std
 		return boost::shared_ptr<int64_t>(new int64_t(revision));
 	}
 }
+
+IPAACA_EXPORT boost::shared_ptr<protobuf::IUWriteBatchResult> CallbackIUWriteBatch::call(const std::string& methodName, boost::shared_ptr<protobuf::IUEventBatch> batch)
+{
+	boost::shared_ptr<protobuf::IUWriteBatchResult> result(new protobuf::IUWriteBatchResult());
+	for (int i = 0; i < batch->events_size(); ++i) {
+		const protobuf::IUEventBatchItem& item = batch->events(i);
+		int64_t revision = 0;
+		AnnotatedData annotated;
+		try {
+			if (!ConverterRegistry::instance().deserialize(item.wire_schema(), item.data(), annotated)) {
+				IPAACA_WARNING("No converter for wire schema " << item.wire_schema() << " in remote write batch")
+			} else {
+				switch (iu_wire_event_type(annotated.first)) {
+					case IU_WIRE_EVENT_PAYLOAD_UPDATE:
+					{
+						CallbackIUPayloadUpdate callback(_buffer);
+						revision = *(callback.call("updatePayload", boost::static_pointer_cast<IUPayloadUpdate>(annotated.second)));
+						break;
+					}
+					case IU_WIRE_EVENT_LINK_UPDATE:
+					{
+						CallbackIULinkUpdate callback(_buffer);
+						revision = *(callback.call("updateLinks", boost::static_pointer_cast<IULinkUpdate>(annotated.second)));
+						break;
+					}
+					case IU_WIRE_EVENT_COMMISSION:
+					{
+						CallbackIUCommission callback(_buffer);
+						revision = *(callback.call("commit", boost::static_pointer_cast<protobuf::IUCommission>(annotated.second)));
+						break;
+					}
+					default:
+						IPAACA_WARNING("Unexpected item type " << annotated.first << " in remote write batch")
+				}
+			}
+		} catch (std::exception& ex) {
+			IPAACA_ERROR("Item of remote write batch failed: " << ex.what())
+			revision = 0;
+		}
+		result->add_revisions(revision);
+	}
+	return result;
+}
 //}}}
 
 // OutputBuffer//{{{
 
 IPAACA_EXPORT OutputBuffer::OutputBuffer(const std::string& basename, const std::string& channel)
-:Buffer(basename, "OB")
+:Buffer(basename, "OB"), _async_publish(false), _publish_queue_capacity(0), _publish_in_flight(0), _publish_thread_running(false), _batch_window_ms(0), _batch_max_events(0), _batch_max_bytes(0), _batch_thread_running(false), _retire_after_commit_ms(0), _retire_after_inactivity_ms(0), _retire_thread_running(false)
 {
 	_id_prefix = _basename + "-" + _uuid + "-IU-";
 	_channel = (channel=="") ? __ipaaca_static_option_default_channel: channel;
 	_initialize_server();
+	if (LoopbackHub::enabled()) {
+		LoopbackHub::instance().register_output_buffer(this);
+	}
+}
+IPAACA_EXPORT OutputBuffer::OutputBuffer(const BufferConfiguration& bufferconfiguration)
+:Buffer(bufferconfiguration.get_basename(), "OB"), _async_publish(bufferconfiguration.get_async_publish()), _publish_queue_capacity(bufferconfiguration.get_publish_queue_capacity()), _publish_in_flight(0), _publish_thread_running(false), _batch_window_ms(bufferconfiguration.get_batch_window_ms()), _batch_max_events(bufferconfiguration.get_batch_max_events()), _batch_max_bytes(bufferconfiguration.get_batch_max_bytes()), _batch_thread_running(false), _retire_after_commit_ms(bufferconfiguration.get_retire_after_commit_ms()), _retire_after_inactivity_ms(bufferconfiguration.get_retire_after_inactivity_ms()), _retire_thread_running(false)
+{
+	_id_prefix = _basename + "-" + _uuid + "-IU-";
+	_channel = bufferconfiguration.get_channel();
+	if (_publish_queue_capacity == 0) _publish_queue_capacity = 1;
+	if (_batch_max_events == 0) _batch_max_events = 1;
+	_initialize_server();
+	if (LoopbackHub::enabled()) {
+		LoopbackHub::instance().register_output_buffer(this);
+	}
+	if (_async_publish) {
+		_publish_thread_running = true;
+		_publish_thread = boost::thread(boost::bind(&OutputBuffer::_publish_worker, this));
+	}
+	if (_batch_window_ms > 0) {
+		_batch_thread_running = true;
+		_batch_thread = boost::thread(boost::bind(&OutputBuffer::_batch_worker, this));
+	}
+	if (_auto_retire()) {
+		_retire_thread_running = true;
+		_retire_thread = boost::thread(boost::bind(&OutputBuffer::_retire_worker, this));
+	}
 }
 IPAACA_EXPORT void OutputBuffer::_initialize_server()
 {
@@ -305,22 +574,26 @@ IPAACA_EXPORT void OutputBuffer::_initialize_server()
 	_server->registerMethod("updateLinks", LocalServer::CallbackPtr(new CallbackIULinkUpdate(this)));
 	_server->registerMethod("commit", LocalServer::CallbackPtr(new CallbackIUCommission(this)));
 	_server->registerMethod("resendRequest", LocalServer::CallbackPtr(new CallbackIUResendRequest(this)));
+	_server->registerMethod("updateBatch", LocalServer::CallbackPtr(new CallbackIUWriteBatch(this)));
 }
 IPAACA_EXPORT OutputBuffer::ptr OutputBuffer::create(const std::string& basename)
 {
 	Initializer::initialize_backend();
 	return OutputBuffer::ptr(new OutputBuffer(basename));
 }
+IPAACA_EXPORT OutputBuffer::ptr OutputBuffer::create(const BufferConfiguration& bufferconfiguration)
+{
+	Initializer::initialize_backend();
+	return OutputBuffer::ptr(new OutputBuffer(bufferconfiguration));
+}
 IPAACA_EXPORT IUInterface::ptr OutputBuffer::get(const std::string& iu_uid)
 {
-	IUStore::iterator it = _iu_store.find(iu_uid);
-	if (it==_iu_store.end()) return IUInterface::ptr();
-	return it->second;
+	return _iu_store.find(IUId(iu_uid));
 }
 IPAACA_EXPORT std::set<IUInterface::ptr> OutputBuffer::get_ius()
 {
 	std::set<IUInterface::ptr> set;
-	for (IUStore::iterator it=_iu_store.begin(); it!=_iu_store.end(); ++it) set.insert(it->second);
+	_iu_store.for_each([&set](const IU::ptr& iu) { set.insert(iu); });
 	return set;
 }
 
@@ -334,10 +607,10 @@ IPAACA_EXPORT void OutputBuffer::_send_iu_link_update(IUInterface* iu, bool is_d
 	lup->is_delta = true;
 	lup->new_links = new_links;
 	if (is_delta) lup->links_to_remove = links_to_remove;
-	if (writer_name=="") lup->writer_name = _unique_name;
+	if (writer_name=="") lup->writer_name = _interned_unique_name;
 	else lup->writer_name = writer_name;
-	Informer<AnyType>::Ptr informer = _get_informer(iu->category());
-	informer->publish(ldata);
+	_publish_event(iu->category(), rsc::runtime::typeName<ipaaca::IULinkUpdate>(), ldata);
+	_note_iu_activity(iu, false);
 }
 
 IPAACA_EXPORT void OutputBuffer::_send_iu_payload_update(IUInterface* iu, bool is_delta, revision_t revision, const std::map<std::string, PayloadDocumentEntry::ptr>& new_items, const std::vector<std::string>& keys_to_remove, const std::string& writer_name)
@@ -345,15 +618,18 @@ IPAACA_EXPORT void OutputBuffer::_send_iu_payload_update(IUInterface* iu, bool i
 	IUPayloadUpdate* pup = new ipaaca::IUPayloadUpdate();
 	Informer<ipaaca::IUPayloadUpdate>::DataPtr pdata(pup);
 	pup->payload_type = iu->payload_type();
+	pup->payload_type_tag = payload_type_from_string(pup->payload_type);
 	pup->uid = iu->uid();
 	pup->is_delta = is_delta;
 	pup->revision = revision;
 	pup->new_items = new_items;
+	pup->binary_encoding = (__ipaaca_static_option_binary_payload == "on");
+	pup->patch_encoding = (__ipaaca_static_option_payload_patches == "on");
 	if (is_delta) pup->keys_to_remove = keys_to_remove;
-	if (writer_name=="") pup->writer_name = _unique_name;
+	if (writer_name=="") pup->writer_name = _interned_unique_name;
 	else pup->writer_name = writer_name;
-	Informer<AnyType>::Ptr informer = _get_informer(iu->category());
-	informer->publish(pdata);
+	_publish_event(iu->category(), rsc::runtime::typeName<ipaaca::IUPayloadUpdate>(), pdata);
+	_note_iu_activity(iu, false);
 }
 
 IPAACA_EXPORT void OutputBuffer::_send_iu_commission(IUInterface* iu, revision_t revision, const std::string& writer_name)
@@ -364,13 +640,14 @@ IPAACA_EXPORT void OutputBuffer::_send_iu_commission(IUInterface* iu, revision_t
 	if (writer_name=="") data->set_writer_name(_unique_name);
 	else data->set_writer_name(writer_name);
 
-	Informer<AnyType>::Ptr informer = _get_informer(iu->category());
-	informer->publish(data);
+	_iu_index.update_state(iu);
+	_publish_event(iu->category(), rsc::runtime::typeName<protobuf::IUCommission>(), data);
+	_note_iu_activity(iu, true);
 }
 
 IPAACA_EXPORT void OutputBuffer::add(IU::ptr iu)
 {
-	if (_iu_store.count(iu->uid()) > 0) {
+	if (_iu_store.contains(iu->binary_uid())) {
 		throw IUPublishedError();
 	}
 	if (iu->is_published()) {
@@ -380,24 +657,215 @@ IPAACA_EXPORT void OutputBuffer::add(IU::ptr iu)
 	}
 	if (iu->access_mode() != IU_ACCESS_MESSAGE) {
 		// (for Message-type IUs: do not actually store them)
-		_iu_store[iu->uid()] = iu;
+		if (!_iu_store.insert(iu->binary_uid(), iu)) {
+			throw IUPublishedError(); // added concurrently
+		}
 	}
 	iu->_associate_with_buffer(this);
+	if (iu->access_mode() != IU_ACCESS_MESSAGE) {
+		_iu_index.insert(iu); // (owner name is set now)
+	}
 	_publish_iu(iu);
+	if (iu->access_mode() != IU_ACCESS_MESSAGE) {
+		_note_iu_activity(iu.get(), iu->committed());
+	}
 }
 
 IPAACA_EXPORT void OutputBuffer::_publish_iu(IU::ptr iu)
 {
-	Informer<AnyType>::Ptr informer = _get_informer(iu->_category);
-	Informer<ipaaca::IU>::DataPtr iu_data(iu);
-	informer->publish(iu_data);
+	// deferred sending must not see later modifications
+	Informer<ipaaca::IU>::DataPtr iu_data(_async_publish ? iu->_create_snapshot() : iu);
+	_publish_event(iu->_category, rsc::runtime::typeName<ipaaca::IU>(), iu_data);
 }
 
 IPAACA_EXPORT void OutputBuffer::_publish_iu_resend(IU::ptr iu, const std::string& hidden_scope_name)
 {
-	Informer<AnyType>::Ptr informer = _get_informer(hidden_scope_name);
-	Informer<ipaaca::IU>::DataPtr iu_data(iu);
-	informer->publish(iu_data);
+	Informer<ipaaca::IU>::DataPtr iu_data(_async_publish ? iu->_create_snapshot() : iu);
+	_publish_event(hidden_scope_name, rsc::runtime::typeName<ipaaca::IU>(), iu_data, true);
+}
+
+IPAACA_EXPORT void OutputBuffer::_publish_event(const std::string& category, const std::string& type, VoidPtr data, bool private_scope)
+{
+	if (!_async_publish) {
+		_send_event(category, type, data, private_scope);
+		return;
+	}
+	boost::unique_lock<boost::mutex> lock(_publish_queue_mutex);
+	while (_publish_thread_running && (_publish_queue.size() >= _publish_queue_capacity)) {
+		_publish_queue_cond.wait(lock);
+	}
+	if (!_publish_thread_running) {
+		lock.unlock();
+		_send_event(category, type, data, private_scope);
+		return;
+	}
+	PendingPublication pending;
+	pending.category = category;
+	pending.type = type;
+	pending.data = data;
+	pending.private_scope = private_scope;
+	_publish_queue.push_back(pending);
+	_publish_queue_cond.notify_all();
+}
+
+IPAACA_EXPORT void OutputBuffer::_publish_worker()
+{
+	boost::unique_lock<boost::mutex> lock(_publish_queue_mutex);
+	while (true) {
+		while (_publish_thread_running && _publish_queue.empty()) {
+			_publish_queue_cond.wait(lock);
+		}
+		if (_publish_queue.empty()) return; // stopped and drained
+		PendingPublication pending = _publish_queue.front();
+		_publish_queue.pop_front();
+		_publish_in_flight++;
+		_publish_queue_cond.notify_all(); // space for blocked publishers
+		lock.unlock();
+		try {
+			_send_event(pending.category, pending.type, pending.data, pending.private_scope);
+		} catch (std::exception& ex) {
+			IPAACA_ERROR("Asynchronous publishing of " << pending.type << " failed: " << ex.what())
+		}
+		lock.lock();
+		_publish_in_flight--;
+		_publish_queue_cond.notify_all(); // for flush()
+	}
+}
+
+IPAACA_EXPORT void OutputBuffer::flush()
+{
+	if (_async_publish) {
+		boost::unique_lock<boost::mutex> lock(_publish_queue_mutex);
+		while ((!_publish_queue.empty()) || (_publish_in_flight > 0)) {
+			_publish_queue_cond.wait(lock);
+		}
+	}
+	if (_batch_window_ms > 0) {
+		boost::lock_guard<boost::mutex> lock(_batch_mutex);
+		_flush_batches_locked(false);
+	}
+}
+
+IPAACA_EXPORT void OutputBuffer::_stop_publish_thread()
+{
+	{
+		boost::lock_guard<boost::mutex> lock(_publish_queue_mutex);
+		if (!_publish_thread_running) return;
+		_publish_thread_running = false;
+	}
+	_publish_queue_cond.notify_all();
+	// the worker drains the queue before exiting
+	_publish_thread.join();
+}
+
+IPAACA_EXPORT void OutputBuffer::_send_event(const std::string& category, const std::string& type, VoidPtr data, bool private_scope)
+{
+	if (LoopbackHub::enabled()) {
+		LoopbackHub::instance().deliver(_channel, category, type, data);
+		if (LoopbackHub::exclusive()) return;
+	}
+	if ((_batch_window_ms > 0) && !private_scope) {
+		_batch_event(category, type, data);
+	} else {
+		_transmit_event(category, type, data, private_scope);
+	}
+}
+
+IPAACA_EXPORT void OutputBuffer::_batch_event(const std::string& category, const std::string& type, VoidPtr data)
+{
+	// serialize right away: the frame must capture the state at call time
+	std::string wire_schema, wire;
+	if (!ConverterRegistry::instance().serialize(type, data, wire_schema, wire)) {
+		IPAACA_ERROR("No converter for event type " << type << " - cannot batch, sending directly")
+		_transmit_event(category, type, data);
+		return;
+	}
+	boost::lock_guard<boost::mutex> lock(_batch_mutex);
+	PendingEventBatch& batch = _pending_batches[category];
+	if (!batch.frame) {
+		batch.frame = boost::shared_ptr<protobuf::IUEventBatch>(new protobuf::IUEventBatch());
+		batch.bytes = 0;
+	}
+	if (batch.frame->events_size() == 0) {
+		batch.deadline = boost::get_system_time() + boost::posix_time::milliseconds(_batch_window_ms);
+		_batch_cond.notify_all();
+	}
+	protobuf::IUEventBatchItem* item = batch.frame->add_events();
+	item->set_wire_schema(wire_schema);
+	batch.bytes += wire.size();
+	item->mutable_data()->swap(wire);
+	if ((batch.frame->events_size() >= (int) _batch_max_events) || (batch.bytes >= _batch_max_bytes)) {
+		_flush_batch_locked(category, batch);
+	}
+}
+
+IPAACA_EXPORT void OutputBuffer::_flush_batch_locked(const std::string& category, PendingEventBatch& batch)
+{
+	if ((!batch.frame) || (batch.frame->events_size() == 0)) return;
+	boost::shared_ptr<protobuf::IUEventBatch> frame = batch.frame;
+	batch.frame = boost::shared_ptr<protobuf::IUEventBatch>(new protobuf::IUEventBatch());
+	batch.bytes = 0;
+	// sent while holding _batch_mutex, so frames of a category cannot overtake each other
+	_transmit_event(category, rsc::runtime::typeName<protobuf::IUEventBatch>(), frame);
+}
+
+IPAACA_EXPORT void OutputBuffer::_flush_batches_locked(bool only_expired)
+{
+	boost::system_time now = boost::get_system_time();
+	for (std::map<std::string, PendingEventBatch>::iterator it = _pending_batches.begin(); it != _pending_batches.end(); ++it) {
+		if (only_expired && (it->second.deadline > now)) continue;
+		try {
+			_flush_batch_locked(it->first, it->second);
+		} catch (std::exception& ex) {
+			IPAACA_ERROR("Sending batch frame for category " << it->first << " failed: " << ex.what())
+		}
+	}
+}
+
+IPAACA_EXPORT void OutputBuffer::_batch_worker()
+{
+	boost::unique_lock<boost::mutex> lock(_batch_mutex);
+	while (_batch_thread_running) {
+		// sleep until the earliest deadline of a non-empty frame
+		bool have_pending = false;
+		boost::system_time next_deadline;
+		for (std::map<std::string, PendingEventBatch>::iterator it = _pending_batches.begin(); it != _pending_batches.end(); ++it) {
+			if ((!it->second.frame) || (it->second.frame->events_size() == 0)) continue;
+			if ((!have_pending) || (it->second.deadline < next_deadline)) {
+				next_deadline = it->second.deadline;
+				have_pending = true;
+			}
+		}
+		if (have_pending) {
+			_batch_cond.timed_wait(lock, next_deadline);
+		} else {
+			_batch_cond.wait(lock);
+		}
+		_flush_batches_locked(true);
+	}
+	_flush_batches_locked(false);
+}
+
+IPAACA_EXPORT void OutputBuffer::_stop_batch_thread()
+{
+	{
+		boost::lock_guard<boost::mutex> lock(_batch_mutex);
+		if (!_batch_thread_running) return;
+		_batch_thread_running = false;
+	}
+	_batch_cond.notify_all();
+	// the worker sends all pending frames before exiting
+	_batch_thread.join();
+}
+
+IPAACA_EXPORT void OutputBuffer::_transmit_event(const std::string& category, const std::string& type, VoidPtr data, bool private_scope)
+{
+	if (ShmTransport::enabled()) {
+		ShmTransport::instance().publish(_channel, category, type, data, private_scope);
+		return;
+	}
+	Informer<AnyType>::Ptr informer = _get_informer(category);
+	informer->publish(data, type);
 }
 
 IPAACA_EXPORT Informer<AnyType>::Ptr OutputBuffer::_get_informer(const std::string& category)
@@ -410,20 +878,24 @@ IPAACA_EXPORT Informer<AnyType>::Ptr OutputBuffer::_get_informer(const std::stri
 		IPAACA_INFO("Creating new informer for " << scope_string)
 
 		Informer<AnyType>::Ptr informer = getFactory().createInformer<AnyType> ( Scope(scope_string));
+		if (LoopbackHub::enabled()) {
+			// local InputBuffers got our events in-process already
+			LoopbackHub::instance().register_local_informer(informer->getId());
+		}
 		_informer_store[category] = informer;
 		return informer;
 	}
 }
 IPAACA_EXPORT boost::shared_ptr<IU> OutputBuffer::remove(const std::string& iu_uid)
 {
-	IUStore::iterator it = _iu_store.find(iu_uid);
-	if (it == _iu_store.end()) {
+	IU::ptr iu = _iu_store.erase(IUId(iu_uid));
+	if (!iu) {
 		IPAACA_WARNING("Removal of IU " << iu_uid << " requested, but not present in our OutputBuffer")
 		//throw IUNotFoundError();
+		return iu; // (also retired automatically)
 	}
-	IU::ptr iu = it->second;
+	_iu_index.erase(iu->binary_uid());
 	_retract_iu(iu);
-	_iu_store.erase(iu_uid);
 	return iu;
 }
 IPAACA_EXPORT boost::shared_ptr<IU> OutputBuffer::remove(IU::ptr iu)
@@ -433,34 +905,150 @@ IPAACA_EXPORT boost::shared_ptr<IU> OutputBuffer::remove(IU::ptr iu)
 
 IPAACA_EXPORT void OutputBuffer::_retract_iu(IU::ptr iu)
 {
+	Locker locker(iu->_revision_lock);
 	if (iu->_retracted) return; // ignore subsequent retractions
 	iu->_retracted = true;
 	Informer<protobuf::IURetraction>::DataPtr data(new protobuf::IURetraction());
 	data->set_uid(iu->uid());
 	data->set_revision(iu->revision());
-	Informer<AnyType>::Ptr informer = _get_informer(iu->category());
-	informer->publish(data);
+	_publish_event(iu->category(), rsc::runtime::typeName<protobuf::IURetraction>(), data);
+}
+
+IPAACA_EXPORT void OutputBuffer::_retract_ius(const std::vector<IU::ptr>& ius)
+{
+	// one by one: batch frames (made by _publish_event in batching mode only)
+	// are not understood by other ipaaca implementations
+	for (auto& iu: ius) {
+		_retract_iu(iu);
+	}
 }
 
 IPAACA_EXPORT void OutputBuffer::_retract_all_internal()
 {
-	for (IUStore::iterator it=_iu_store.begin(); it!=_iu_store.end(); ++it) {
-		if (!(it->second->_retracted)) {
-			_retract_iu(it->second);
+	std::vector<IU::ptr> live_ius;
+	_iu_store.for_each([&live_ius](const IU::ptr& iu) {
+		if (!(iu->_retracted)) live_ius.push_back(iu);
+	});
+	_retract_ius(live_ius);
+}
+
+IPAACA_EXPORT void OutputBuffer::_note_iu_activity(IUInterface* iu, bool committed)
+{
+	if (!_auto_retire()) return;
+	boost::system_time now = boost::get_system_time();
+	boost::lock_guard<boost::mutex> lock(_retire_mutex);
+	boost::system_time waiting_for = _next_retire_deadline_locked();
+	boost::system_time deadline(boost::posix_time::pos_infin);
+	if (_retire_after_inactivity_ms) {
+		auto it = _last_activity.find(iu->binary_uid());
+		if (it != _last_activity.end()) {
+			it->second = now; // (its pending deadline is re-armed when it expires)
+		} else {
+			_last_activity[iu->binary_uid()] = now;
+			deadline = now + boost::posix_time::milliseconds(_retire_after_inactivity_ms);
+			_retire_after_inactivity_queue.insert(std::make_pair(deadline, iu->binary_uid()));
+		}
+	}
+	if (committed && _retire_after_commit_ms) {
+		boost::system_time commit_deadline = now + boost::posix_time::milliseconds(_retire_after_commit_ms);
+		_retire_after_commit_queue.push_back(std::make_pair(commit_deadline, iu->binary_uid()));
+		deadline = std::min(deadline, commit_deadline);
+	}
+	// otherwise the worker wakes up early enough anyway
+	if (deadline < waiting_for) _retire_cond.notify_all();
+}
+
+IPAACA_EXPORT boost::system_time OutputBuffer::_next_retire_deadline_locked() const
+{
+	boost::system_time next_deadline(boost::posix_time::pos_infin);
+	if (!_retire_after_commit_queue.empty()) next_deadline = _retire_after_commit_queue.front().first;
+	if (!_retire_after_inactivity_queue.empty()) next_deadline = std::min(next_deadline, _retire_after_inactivity_queue.begin()->first);
+	return next_deadline;
+}
+
+IPAACA_EXPORT void OutputBuffer::_collect_due_ius_locked(std::vector<IUId>& due)
+{
+	boost::system_time now = boost::get_system_time();
+	// the grace period after commission is fixed, so those deadlines are in order
+	while ((!_retire_after_commit_queue.empty()) && (_retire_after_commit_queue.front().first <= now)) {
+		due.push_back(_retire_after_commit_queue.front().second);
+		_last_activity.erase(_retire_after_commit_queue.front().second);
+		_retire_after_commit_queue.pop_front();
+	}
+	while ((!_retire_after_inactivity_queue.empty()) && (_retire_after_inactivity_queue.begin()->first <= now)) {
+		IUId uid = _retire_after_inactivity_queue.begin()->second;
+		_retire_after_inactivity_queue.erase(_retire_after_inactivity_queue.begin());
+		auto it = _last_activity.find(uid);
+		if (it == _last_activity.end()) continue; // (retired after commission meanwhile)
+		boost::system_time deadline = it->second + boost::posix_time::milliseconds(_retire_after_inactivity_ms);
+		if (deadline <= now) {
+			due.push_back(uid);
+			_last_activity.erase(it);
+		} else {
+			// active since the deadline was set
+			_retire_after_inactivity_queue.insert(std::make_pair(deadline, uid));
 		}
 	}
 }
 
+IPAACA_EXPORT void OutputBuffer::_retire_worker()
+{
+	boost::unique_lock<boost::mutex> lock(_retire_mutex);
+	while (_retire_thread_running) {
+		if (_retire_after_commit_queue.empty() && _retire_after_inactivity_queue.empty()) {
+			_retire_cond.wait(lock);
+		} else {
+			_retire_cond.timed_wait(lock, _next_retire_deadline_locked());
+		}
+		if (!_retire_thread_running) break;
+		std::vector<IUId> due;
+		_collect_due_ius_locked(due);
+		if (due.empty()) continue;
+		lock.unlock();
+		std::vector<IU::ptr> retired;
+		for (auto& uid: due) {
+			IU::ptr iu = _iu_store.erase(uid);
+			if (iu) retired.push_back(iu); // (unless removed meanwhile)
+			_iu_index.erase(uid);
+		}
+		IPAACA_DEBUG("Retiring " << retired.size() << " IUs of OutputBuffer " << _unique_name)
+		try {
+			_retract_ius(retired);
+		} catch (std::exception& ex) {
+			IPAACA_ERROR("Sending retractions of retired IUs failed: " << ex.what())
+		}
+		lock.lock();
+	}
+}
+
+IPAACA_EXPORT void OutputBuffer::_stop_retire_thread()
+{
+	{
+		boost::lock_guard<boost::mutex> lock(_retire_mutex);
+		if (!_retire_thread_running) return;
+		_retire_thread_running = false;
+	}
+	_retire_cond.notify_all();
+	_retire_thread.join();
+}
+
 IPAACA_EXPORT OutputBuffer::~OutputBuffer()
 {
+	_stop_retire_thread();
 	_retract_all_internal();
+	_stop_publish_thread();
+	_stop_batch_thread();
+	LoopbackHub::instance().unregister_output_buffer(this);
+	for (auto& kv: _informer_store) {
+		LoopbackHub::instance().unregister_local_informer(kv.second->getId());
+	}
 }
 
 //}}}
 
 // InputBuffer//{{{
 IPAACA_EXPORT InputBuffer::InputBuffer(const BufferConfiguration& bufferconfiguration)
-:Buffer(bufferconfiguration.get_basename(), "IB")
+:Buffer(bufferconfiguration.get_basename(), "IB"), _remote_write_batching(false), _shm_readers_stopped(false)
 {
 	_channel = bufferconfiguration.get_channel();
 	for (std::vector<std::string>::const_iterator it=bufferconfiguration.get_category_interests().begin(); it!=bufferconfiguration.get_category_interests().end(); ++it) {
@@ -468,9 +1056,10 @@ IPAACA_EXPORT InputBuffer::InputBuffer(const BufferConfiguration& bufferconfigur
 	}
 	_create_category_listener_if_needed(_uuid);
 	triggerResend = false;
+	_init_retention(bufferconfiguration);
 }
 IPAACA_EXPORT InputBuffer::InputBuffer(const std::string& basename, const std::set<std::string>& category_interests)
-:Buffer(basename, "IB")
+:Buffer(basename, "IB"), _remote_write_batching(false), _shm_readers_stopped(false)
 {
 	_channel = __ipaaca_static_option_default_channel;
 	for (std::set<std::string>::const_iterator it=category_interests.begin(); it!=category_interests.end(); ++it) {
@@ -478,9 +1067,10 @@ IPAACA_EXPORT InputBuffer::InputBuffer(const std::string& basename, const std::s
 	}
 	_create_category_listener_if_needed(_uuid);
 	triggerResend = false;
+	_init_retention(BufferConfiguration(basename));
 }
 IPAACA_EXPORT InputBuffer::InputBuffer(const std::string& basename, const std::vector<std::string>& category_interests)
-:Buffer(basename, "IB")
+:Buffer(basename, "IB"), _remote_write_batching(false), _shm_readers_stopped(false)
 {
 	_channel = __ipaaca_static_option_default_channel;
 	for (std::vector<std::string>::const_iterator it=category_interests.begin(); it!=category_interests.end(); ++it) {
@@ -488,26 +1078,29 @@ IPAACA_EXPORT InputBuffer::InputBuffer(const std::string& basename, const std::v
 	}
 	_create_category_listener_if_needed(_uuid);
 	triggerResend = false;
+	_init_retention(BufferConfiguration(basename));
 }
 IPAACA_EXPORT InputBuffer::InputBuffer(const std::string& basename, const std::string& category_interest1)
-:Buffer(basename, "IB")
+:Buffer(basename, "IB"), _remote_write_batching(false), _shm_readers_stopped(false)
 {
 	_channel = __ipaaca_static_option_default_channel;
 	_create_category_listener_if_needed(category_interest1);
 	_create_category_listener_if_needed(_uuid);
 	triggerResend = false;
+	_init_retention(BufferConfiguration(basename));
 }
 IPAACA_EXPORT InputBuffer::InputBuffer(const std::string& basename, const std::string& category_interest1, const std::string& category_interest2)
-:Buffer(basename, "IB")
+:Buffer(basename, "IB"), _remote_write_batching(false), _shm_readers_stopped(false)
 {
 	_channel = __ipaaca_static_option_default_channel;
 	_create_category_listener_if_needed(category_interest1);
 	_create_category_listener_if_needed(category_interest2);
 	_create_category_listener_if_needed(_uuid);
 	triggerResend = false;
+	_init_retention(BufferConfiguration(basename));
 }
 IPAACA_EXPORT InputBuffer::InputBuffer(const std::string& basename, const std::string& category_interest1, const std::string& category_interest2, const std::string& category_interest3)
-:Buffer(basename, "IB")
+:Buffer(basename, "IB"), _remote_write_batching(false), _shm_readers_stopped(false)
 {
 	_channel = __ipaaca_static_option_default_channel;
 	_create_category_listener_if_needed(category_interest1);
@@ -515,9 +1108,10 @@ IPAACA_EXPORT InputBuffer::InputBuffer(const std::string& basename, const std::s
 	_create_category_listener_if_needed(category_interest3);
 	_create_category_listener_if_needed(_uuid);
 	triggerResend = false;
+	_init_retention(BufferConfiguration(basename));
 }
 IPAACA_EXPORT InputBuffer::InputBuffer(const std::string& basename, const std::string& category_interest1, const std::string& category_interest2, const std::string& category_interest3, const std::string& category_interest4)
-:Buffer(basename, "IB")
+:Buffer(basename, "IB"), _remote_write_batching(false), _shm_readers_stopped(false)
 {
 	_channel = __ipaaca_static_option_default_channel;
 	_create_category_listener_if_needed(category_interest1);
@@ -526,6 +1120,7 @@ IPAACA_EXPORT InputBuffer::InputBuffer(const std::string& basename, const std::s
 	_create_category_listener_if_needed(category_interest4);
 	_create_category_listener_if_needed(_uuid);
 	triggerResend = false;
+	_init_retention(BufferConfiguration(basename));
 }
 
 IPAACA_EXPORT InputBuffer::ptr InputBuffer::create(const BufferConfiguration& bufferconfiguration)
@@ -564,6 +1159,27 @@ IPAACA_EXPORT InputBuffer::ptr InputBuffer::create(const std::string& basename,
 	return InputBuffer::ptr(new InputBuffer(basename, category_interest1, category_interest2, category_interest3, category_interest4));
 }
 
+IPAACA_EXPORT InputBuffer::~InputBuffer()
+{
+	std::map<std::string, ShmReader::ptr> shm_readers;
+	{
+		Locker locker(_shm_reader_lock);
+		_shm_readers_stopped = true;
+		shm_readers.swap(_shm_reader_store);
+	}
+	// (without the lock: a reader may be waiting for it in a resend request)
+	for (auto& kv: shm_readers) {
+		kv.second->stop();
+	}
+	if (shm_readers.count(_uuid)) {
+		ShmTransport::instance().unlink_ring(_channel, _uuid);
+	}
+	if (_loopback_receiver) {
+		LoopbackHub::instance().unsubscribe_all(this);
+		_loopback_receiver->stop();
+	}
+}
+
 IPAACA_EXPORT void InputBuffer::set_resend(bool resendActive)
 {
 	triggerResend = resendActive;
@@ -576,17 +1192,193 @@ IPAACA_EXPORT bool InputBuffer::get_resend()
 
 IPAACA_EXPORT IUInterface::ptr InputBuffer::get(const std::string& iu_uid)
 {
-	RemotePushIUStore::iterator it = _iu_store.find(iu_uid);
-	if (it==_iu_store.end()) return IUInterface::ptr();
-	return it->second;
+	IUId uid(iu_uid);
+	RemotePushIU::ptr iu = _iu_store.find(uid);
+	if (iu) _retention_touch(uid);
+	return iu;
 }
 IPAACA_EXPORT std::set<IUInterface::ptr> InputBuffer::get_ius()
 {
 	std::set<IUInterface::ptr> set;
-	for (RemotePushIUStore::iterator it=_iu_store.begin(); it!=_iu_store.end(); ++it) set.insert(it->second);
+	_iu_store.for_each([&set](const RemotePushIU::ptr& iu) { set.insert(iu); });
 	return set;
 }
+IPAACA_EXPORT size_t InputBuffer::retained_iu_count()
+{
+	return _iu_store.size();
+}
 
+IPAACA_EXPORT void InputBuffer::_init_retention(const BufferConfiguration& bufferconfiguration)
+{
+	_retention_max_ius = bufferconfiguration.get_retention_max_ius();
+	_retention_max_bytes = bufferconfiguration.get_retention_max_bytes();
+	_retention_ttl_after_commit_ms = bufferconfiguration.get_retention_ttl_after_commit_ms();
+	_retention_ttl_after_retract_ms = bufferconfiguration.get_retention_ttl_after_retract_ms();
+	_retention_lru = bufferconfiguration.get_retention_lru();
+	_retention_tombstones = bufferconfiguration.get_retention_tombstones();
+	_retained_bytes = 0;
+}
+/// approximate memory use of a received IU
+static size_t _estimated_iu_size(boost::shared_ptr<RemotePushIU> iu)
+{
+	size_t bytes = sizeof(RemotePushIU) + iu->uid().size() + iu->category().size() + iu->owner_name().size();
+	bytes += iu->const_payload().estimated_size();
+	for (auto& kv: iu->get_all_links()) {
+		bytes += kv.first.size();
+		for (auto& target: kv.second) bytes += target.size();
+	}
+	return bytes;
+}
+IPAACA_EXPORT void InputBuffer::_store_iu(RemotePushIU::ptr iu)
+{
+	_iu_store.set(iu->binary_uid(), iu);
+	_iu_index.insert(iu);
+	if (! _retention_active()) return;
+	Locker locker(_retention_lock);
+	RetainedIUInfo& info = _retained[iu->binary_uid()];
+	info.order_position = _retention_order.insert(_retention_order.end(), iu->binary_uid());
+	info.bytes = _retention_max_bytes ? _estimated_iu_size(iu) : 0;
+	_retained_bytes += info.bytes;
+}
+IPAACA_EXPORT void InputBuffer::_retention_note_change(RemotePushIU::ptr iu, IUEventType event_type)
+{
+	if (! _retention_active()) return;
+	Locker locker(_retention_lock);
+	auto it = _retained.find(iu->binary_uid());
+	if (it == _retained.end()) return;
+	if (_retention_max_bytes) {
+		size_t bytes = _estimated_iu_size(iu);
+		_retained_bytes = _retained_bytes - it->second.bytes + bytes;
+		it->second.bytes = bytes;
+	}
+	if ((event_type == IU_COMMITTED) && _retention_ttl_after_commit_ms) {
+		_commit_expiries.push_back(std::make_pair(boost::get_system_time() + boost::posix_time::milliseconds(_retention_ttl_after_commit_ms), iu->binary_uid()));
+	} else if ((event_type == IU_RETRACTED) && _retention_ttl_after_retract_ms) {
+		_retract_expiries.push_back(std::make_pair(boost::get_system_time() + boost::posix_time::milliseconds(_retention_ttl_after_retract_ms), iu->binary_uid()));
+	}
+	_retention_touch(iu->binary_uid());
+}
+IPAACA_EXPORT void InputBuffer::_retention_touch(const IUId& uid)
+{
+	if (! _retention_lru) return;
+	Locker locker(_retention_lock);
+	auto it = _retained.find(uid);
+	if (it == _retained.end()) return;
+	_retention_order.splice(_retention_order.end(), _retention_order, it->second.order_position);
+}
+IPAACA_EXPORT void InputBuffer::_enforce_retention()
+{
+	if (! _retention_active()) return;
+	Locker locker(_retention_lock);
+	if (_retention_ttl_after_commit_ms || _retention_ttl_after_retract_ms) {
+		boost::system_time now = boost::get_system_time();
+		// the same TTL for all entries: expiry times are in order
+		for (auto expiries: {&_commit_expiries, &_retract_expiries}) {
+			while ((! expiries->empty()) && (expiries->front().first <= now)) {
+				_evict(expiries->front().second);
+				expiries->pop_front();
+			}
+		}
+	}
+	// the most recent IU is always kept
+	while ((_retention_order.size() > 1) && ((_retention_max_ius && (_retained.size() > _retention_max_ius)) || (_retention_max_bytes && (_retained_bytes > _retention_max_bytes)))) {
+		_evict(_retention_order.front());
+	}
+}
+IPAACA_EXPORT void InputBuffer::_evict(const IUId& uid)
+{
+	auto it = _retained.find(uid);
+	if (it == _retained.end()) return; // evicted before
+	IPAACA_DEBUG("Evicting IU " << uid.to_string() << " from InputBuffer " << _unique_name)
+	_retention_order.erase(it->second.order_position);
+	_retained_bytes -= it->second.bytes;
+	_retained.erase(it);
+	_iu_store.erase(uid);
+	_iu_index.erase(uid);
+	if (_retention_tombstones) {
+		_tombstones.insert(uid);
+		_tombstone_order.push_back(uid);
+		while (_tombstone_order.size() > _retention_tombstones) {
+			_tombstones.erase(_tombstone_order.front());
+			_tombstone_order.pop_front();
+		}
+	}
+}
+IPAACA_EXPORT bool InputBuffer::_was_evicted(const IUId& uid)
+{
+	if (! _retention_active()) return false;
+	Locker locker(_retention_lock);
+	return _tombstones.count(uid) > 0;
+}
+
+IPAACA_EXPORT void InputBuffer::begin_remote_write_batch()
+{
+	Locker locker(_remote_write_batch_lock);
+	_remote_write_batching = true;
+}
+IPAACA_EXPORT bool InputBuffer::_enqueue_remote_write(const std::string& owner_name, const std::string& type, boost::shared_ptr<void> data, boost::weak_ptr<IUInterface> iu, RevisionFuture& result)
+{
+	Locker locker(_remote_write_batch_lock);
+	if (!_remote_write_batching) return false;
+	PendingRemoteWrite write;
+	write.type = type;
+	write.data = data;
+	write.result = boost::shared_ptr<std::promise<revision_t> >(new std::promise<revision_t>());
+	write.iu = iu;
+	result = write.result->get_future().share();
+	_remote_write_batch[owner_name].push_back(write);
+	return true;
+}
+IPAACA_EXPORT size_t InputBuffer::flush_remote_write_batch()
+{
+	std::map<std::string, std::vector<PendingRemoteWrite> > batch;
+	{
+		Locker locker(_remote_write_batch_lock);
+		batch.swap(_remote_write_batch);
+		_remote_write_batching = false;
+	}
+	size_t failed = 0;
+	for (std::map<std::string, std::vector<PendingRemoteWrite> >::iterator it = batch.begin(); it != batch.end(); ++it) {
+		const std::string& owner_name = it->first;
+		std::vector<PendingRemoteWrite>& writes = it->second;
+		boost::shared_ptr<protobuf::IUWriteBatchResult> result;
+		try {
+			boost::shared_ptr<protobuf::IUEventBatch> request(new protobuf::IUEventBatch());
+			for (std::vector<PendingRemoteWrite>::iterator wit = writes.begin(); wit != writes.end(); ++wit) {
+				std::string wire_schema, wire;
+				if (!ConverterRegistry::instance().serialize(wit->type, wit->data, wire_schema, wire)) {
+					throw Exception("No converter for remote write of type " + wit->type);
+				}
+				protobuf::IUEventBatchItem* item = request->add_events();
+				item->set_wire_schema(wire_schema);
+				item->mutable_data()->swap(wire);
+			}
+			protobuf::IUWriteBatchResult local_result;
+			if (LoopbackHub::instance().call_local_server<CallbackIUWriteBatch>(owner_name, "updateBatch", request, local_result)) {
+				result = boost::shared_ptr<protobuf::IUWriteBatchResult>(new protobuf::IUWriteBatchResult(local_result));
+			} else {
+				RemoteServerPtr server = _get_remote_server(owner_name);
+				result = server->call<protobuf::IUWriteBatchResult>("updateBatch", request, IPAACA_REMOTE_SERVER_TIMEOUT);
+			}
+		} catch (std::exception& ex) {
+			IPAACA_ERROR("Remote write batch to " << owner_name << " failed: " << ex.what())
+		}
+		for (size_t i = 0; i < writes.size(); ++i) {
+			revision_t revision = (result && ((int) i < result->revisions_size())) ? result->revisions(i) : 0;
+			if (revision == 0) {
+				failed++;
+				writes[i].result->set_exception(std::make_exception_ptr(IUUpdateFailedError()));
+			} else {
+				IUInterface::ptr iu = writes[i].iu.lock();
+				if (iu) {
+					boost::static_pointer_cast<RemotePushIU>(iu)->_note_write_result(revision);
+				}
+				writes[i].result->set_value(revision);
+			}
+		}
+	}
+	return failed;
+}
 IPAACA_EXPORT RemoteServerPtr InputBuffer::_get_remote_server(const std::string& unique_server_name)
 {
 	std::map<std::string, RemoteServerPtr>::iterator it = _remote_server_store.find(unique_server_name);
@@ -602,19 +1394,45 @@ IPAACA_EXPORT ListenerPtr InputBuffer::_create_category_listener_if_needed(const
 	if (it!=_listener_store.end()) {
 		return it->second;
 	}
+	if (LoopbackHub::enabled()) {
+		if (!_loopback_receiver) {
+			_loopback_receiver = LoopbackReceiver::ptr(new LoopbackReceiver(this));
+			_loopback_receiver->start();
+		}
+		LoopbackHub::instance().subscribe(_channel, category, this);
+		if (LoopbackHub::exclusive()) {
+			// no RSB listener - remember the category anyway
+			_listener_store[category] = ListenerPtr();
+			return ListenerPtr();
+		}
+	}
+	if (ShmTransport::enabled()) {
+		// (the private ring for resent IUs is only set up by the first resend request)
+		if (category != _uuid) _start_shm_reader(category);
+		_listener_store[category] = ListenerPtr();
+		return ListenerPtr();
+	}
 	std::string scope_string = "/ipaaca/channel/" + _channel + "/category/" + category;
 	IPAACA_INFO("Creating new listener for " << scope_string)
 
 	ListenerPtr listener = getFactory().createListener( Scope(scope_string) );
 	HandlerPtr event_handler = HandlerPtr(
 			new EventFunctionHandler(
-				boost::bind(&InputBuffer::_handle_iu_events, this, _1)
+				boost::bind(&InputBuffer::_handle_wire_iu_events, this, _1)
 			)
 		);
 	listener->addHandler(event_handler);
 	_listener_store[category] = listener;
 	return listener;
 }
+IPAACA_EXPORT void InputBuffer::_start_shm_reader(const std::string& category)
+{
+	Locker locker(_shm_reader_lock);
+	if (_shm_readers_stopped || _shm_reader_store.count(category)) return;
+	ShmReader::ptr reader = ShmReader::ptr(new ShmReader(this, ShmTransport::instance().ring(_channel, category)));
+	reader->start();
+	_shm_reader_store[category] = reader;
+}
 IPAACA_EXPORT void InputBuffer::_trigger_resend_request(EventPtr event) {
 	if (!triggerResend) return;
 	std::string type = event->getType();
@@ -638,95 +1456,187 @@ IPAACA_EXPORT void InputBuffer::_trigger_resend_request(EventPtr event) {
 	}
 
 	if (!writerName.empty()) {
-		RemoteServerPtr server = _get_remote_server(writerName);
 		if (!uid.empty()) {
-			boost::shared_ptr<protobuf::IUResendRequest> update = boost::shared_ptr<protobuf::IUResendRequest>(new protobuf::IUResendRequest());
-			update->set_uid(uid);
-			update->set_hidden_scope_name(_uuid);
-			boost::shared_ptr<int> result = server->call<int>("resendRequest", update, IPAACA_REMOTE_SERVER_TIMEOUT);
-			if (*result == 0) {
-				throw IUResendRequestFailedError();
-			}
+			_send_resend_request(uid, writerName);
 		}
 	}
 }
+IPAACA_EXPORT void InputBuffer::_send_resend_request(const std::string& uid, const std::string& server_name)
+{
+	boost::shared_ptr<protobuf::IUResendRequest> update = boost::shared_ptr<protobuf::IUResendRequest>(new protobuf::IUResendRequest());
+	update->set_uid(uid);
+	update->set_hidden_scope_name(_uuid);
+	if (ShmTransport::enabled() && !LoopbackHub::exclusive()) {
+		// readers only receive what is written after they started
+		_start_shm_reader(_uuid);
+	}
+	int64_t local_result;
+	if (LoopbackHub::instance().call_local_server<CallbackIUResendRequest>(server_name, "resendRequest", update, local_result)) {
+		if (local_result == 0) {
+			throw IUResendRequestFailedError();
+		}
+		return;
+	}
+	RemoteServerPtr server = _get_remote_server(server_name);
+	boost::shared_ptr<int> result = server->call<int>("resendRequest", update, IPAACA_REMOTE_SERVER_TIMEOUT);
+	if (*result == 0) {
+		throw IUResendRequestFailedError();
+	}
+}
+IPAACA_EXPORT void InputBuffer::_request_resync(RemotePushIU::ptr iu)
+{
+	try {
+		_send_resend_request(iu->uid(), iu->owner_name());
+	} catch (std::exception& ex) {
+		// the next non-matching patch asks again
+		IPAACA_WARNING("Could not request resend of IU " << iu->uid() << ": " << ex.what())
+		iu->_resync_pending = false;
+	}
+}
+IPAACA_EXPORT void InputBuffer::_handle_wire_iu_events(EventPtr event)
+{
+	if (LoopbackHub::enabled() && LoopbackHub::instance().is_local_informer(event->getMetaData().getSenderId())) {
+		return;
+	}
+	_handle_iu_events(event);
+}
 IPAACA_EXPORT void InputBuffer::_handle_iu_events(EventPtr event)
 {
-	std::string type = event->getType();
-	if (type == "ipaaca::RemotePushIU") {
-		boost::shared_ptr<RemotePushIU> iu = boost::static_pointer_cast<RemotePushIU>(event->getData());
-		if (_iu_store.count(iu->category()) > 0) {
-			// already got the IU... ignore
-		} else {
-			_iu_store[iu->uid()] = iu;
-			iu->_set_buffer(this);
-			call_iu_event_handlers(iu, false, IU_ADDED, iu->category() );
+	const std::string& type = event->getType();
+	RemotePushIU::ptr stored;
+	switch (iu_wire_event_type(type)) {
+		case IU_WIRE_EVENT_BATCH:
+		{
+			// unpack frame of an OutputBuffer in batching mode, in original order
+			boost::shared_ptr<protobuf::IUEventBatch> batch = boost::static_pointer_cast<protobuf::IUEventBatch>(event->getData());
+			for (int i = 0; i < batch->events_size(); ++i) {
+				const protobuf::IUEventBatchItem& item = batch->events(i);
+				AnnotatedData annotated;
+				if (!ConverterRegistry::instance().deserialize(item.wire_schema(), item.data(), annotated)) {
+					IPAACA_WARNING("No converter for wire schema " << item.wire_schema() << " in batch frame - event ignored")
+					continue;
+				}
+				EventPtr unpacked(new Event());
+				unpacked->setType(annotated.first);
+				unpacked->setData(annotated.second);
+				_handle_iu_events(unpacked);
+			}
+			break;
 		}
-	} else if (type == "ipaaca::RemoteMessage") {
-		boost::shared_ptr<RemoteMessage> iu = boost::static_pointer_cast<RemoteMessage>(event->getData());
-		call_iu_event_handlers(iu, false, IU_MESSAGE, iu->category() );
-	} else {
-		RemotePushIUStore::iterator it;
-		if (type == "ipaaca::IUPayloadUpdate") {
+		case IU_WIRE_EVENT_REMOTE_PUSH_IU:
+		{
+			boost::shared_ptr<RemotePushIU> iu = boost::static_pointer_cast<RemotePushIU>(event->getData());
+			stored = _iu_store.find(iu->binary_uid());
+			if (stored) {
+				// already got the IU... ignore, unless waiting for it after a non-matching payload patch
+				if (stored->_resync_pending) {
+					stored->_apply_resync(iu);
+					_iu_index.update_state(stored.get());
+					_retention_note_change(stored, IU_UPDATED);
+					call_iu_event_handlers(stored, false, IU_UPDATED, stored->interned_category() );
+				}
+			} else if (_was_evicted(iu->binary_uid())) {
+				IPAACA_DEBUG("Ignoring late resend of evicted IU " << iu->uid())
+				return;
+			} else {
+				iu->_set_buffer(this);
+				_store_iu(iu);
+				call_iu_event_handlers(iu, false, IU_ADDED, iu->interned_category() );
+			}
+			break;
+		}
+		case IU_WIRE_EVENT_REMOTE_MESSAGE:
+		{
+			boost::shared_ptr<RemoteMessage> iu = boost::static_pointer_cast<RemoteMessage>(event->getData());
+			call_iu_event_handlers(iu, false, IU_MESSAGE, iu->interned_category() );
+			break;
+		}
+		case IU_WIRE_EVENT_PAYLOAD_UPDATE:
+		{
 			boost::shared_ptr<IUPayloadUpdate> update = boost::static_pointer_cast<IUPayloadUpdate>(event->getData());
-			if (update->writer_name == _unique_name) {
+			if (update->writer_name == _interned_unique_name) {
 				return;
 			}
-			it = _iu_store.find(update->uid);
-			if (it == _iu_store.end()) {
+			stored = _iu_store.find(IUId(update->uid));
+			if (!stored) {
+				if (_was_evicted(IUId(update->uid))) return;
 				_trigger_resend_request(event);
 				IPAACA_INFO("UPDATED message for an IU that we did not fully receive before")
 				return;
 			}
-			it->second->_apply_update(update);
-			call_iu_event_handlers(it->second, false, IU_UPDATED, it->second->category() );
-		} else if (type == "ipaaca::IULinkUpdate") {
+			bool resync_was_pending = stored->_resync_pending;
+			stored->_apply_update(update);
+			if (stored->_resync_pending && !resync_was_pending) {
+				_request_resync(stored);
+			}
+			_retention_note_change(stored, IU_UPDATED);
+			call_iu_event_handlers(stored, false, IU_UPDATED, stored->interned_category() );
+			break;
+		}
+		case IU_WIRE_EVENT_LINK_UPDATE:
+		{
 			boost::shared_ptr<IULinkUpdate> update = boost::static_pointer_cast<IULinkUpdate>(event->getData());
-			if (update->writer_name == _unique_name) {
+			if (update->writer_name == _interned_unique_name) {
 				return;
 			}
-			it = _iu_store.find(update->uid);
-			if (it == _iu_store.end()) {
+			stored = _iu_store.find(IUId(update->uid));
+			if (!stored) {
+				if (_was_evicted(IUId(update->uid))) return;
 				_trigger_resend_request(event);
 				IPAACA_INFO("LINKSUPDATED message for an IU that we did not fully receive before")
 				return;
 			}
-			it->second->_apply_link_update(update);
-			call_iu_event_handlers(it->second, false, IU_LINKSUPDATED, it->second->category() );
-		} else if (type == "ipaaca::protobuf::IUCommission") {
+			stored->_apply_link_update(update);
+			_retention_note_change(stored, IU_LINKSUPDATED);
+			call_iu_event_handlers(stored, false, IU_LINKSUPDATED, stored->interned_category() );
+			break;
+		}
+		case IU_WIRE_EVENT_COMMISSION:
+		{
 			boost::shared_ptr<protobuf::IUCommission> update = boost::static_pointer_cast<protobuf::IUCommission>(event->getData());
 			if (update->writer_name() == _unique_name) {
 				return;
 			}
-			it = _iu_store.find(update->uid());
-			if (it == _iu_store.end()) {
+			stored = _iu_store.find(IUId(update->uid()));
+			if (!stored) {
+				if (_was_evicted(IUId(update->uid()))) return;
 				_trigger_resend_request(event);
 				IPAACA_INFO("COMMITTED message for an IU that we did not fully receive before")
 				return;
 			}
-			it->second->_apply_commission();
-			it->second->_revision = update->revision();
-			call_iu_event_handlers(it->second, false, IU_COMMITTED, it->second->category() );
-		} else if (type == "ipaaca::protobuf::IURetraction") {
+			stored->_apply_commission();
+			stored->_set_revision(update->revision());
+			_iu_index.update_state(stored.get());
+			_retention_note_change(stored, IU_COMMITTED);
+			call_iu_event_handlers(stored, false, IU_COMMITTED, stored->interned_category() );
+			break;
+		}
+		case IU_WIRE_EVENT_RETRACTION:
+		{
 			boost::shared_ptr<protobuf::IURetraction> update = boost::static_pointer_cast<protobuf::IURetraction>(event->getData());
-			it = _iu_store.find(update->uid());
-			if (it == _iu_store.end()) {
+			stored = _iu_store.find(IUId(update->uid()));
+			if (!stored) {
 				IPAACA_INFO("Ignoring RETRACTED message for an IU that we did not fully receive before")
 				return;
 			}
-			it->second->_revision = update->revision();
-			it->second->_apply_retraction();
-			auto final_iu_ref = it->second;
+			stored->_set_revision(update->revision());
+			stored->_apply_retraction();
+			_iu_index.update_state(stored.get());
+			auto final_iu_ref = stored;
 			////// remove from InputBuffer?  FIXME: unclear issue - resolve in ipaaca3
-			////_iu_store.erase(it->first);
+			////_iu_store.erase(stored->binary_uid());
+			// (kept unless a retention TTL after retraction is configured)
+			_retention_note_change(final_iu_ref, IU_RETRACTED);
 			// and call the handler. IU reference is still valid for this call, even if removed from buffer.
-			call_iu_event_handlers(final_iu_ref, false, IU_RETRACTED, it->second->category() );
+			call_iu_event_handlers(final_iu_ref, false, IU_RETRACTED, final_iu_ref->interned_category() );
 			//
-		} else {
+			break;
+		}
+		default:
 			IPAACA_WARNING("(Unhandled Event type " << type << " !)");
 			return;
-		}
 	}
+	_enforce_retention();
 }
 //}}}
 
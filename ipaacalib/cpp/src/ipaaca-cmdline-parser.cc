@@ -91,6 +91,10 @@ void CommandLineParser::initialize_parser_defaults()
 		add_option("ipaaca-payload-type", 0, true, "JSON");
 		add_option("ipaaca-default-channel", 0, true, "default");
 		add_option("ipaaca-enable-logging", 0, true, "WARNING");
+		add_option("ipaaca-loopback", 0, true, "off");
+		add_option("ipaaca-binary-payload", 0, true, "off");
+		add_option("ipaaca-uid-mode", 0, true, "uuid");
+		add_option("ipaaca-payload-patches", 0, true, "off");
 		add_option("rsb-enable-logging", 0, true, "ERROR");
 		add_option("rsb-host", 0, true, ""); // empty = don't set
 		add_option("rsb-port", 0, true, ""); // empty = don't set
@@ -114,6 +118,38 @@ bool CommandLineParser::consume_library_option(const std::string& name, bool exp
 		std::string newch = optarg;
 		IPAACA_DEBUG("Setting default channel " << newch)
 		__ipaaca_static_option_default_channel = newch;
+	} else if (name=="ipaaca-loopback") {
+		std::string newmode = optarg;
+		if ((newmode=="off") || (newmode=="on") || (newmode=="exclusive")) {
+			IPAACA_DEBUG("Setting in-process loopback mode " << newmode)
+			__ipaaca_static_option_loopback = newmode;
+		} else {
+			IPAACA_WARNING("Ignoring unknown loopback mode " << newmode << " - should be one of off, on, exclusive")
+		}
+	} else if (name=="ipaaca-binary-payload") {
+		std::string newmode = optarg;
+		if ((newmode=="off") || (newmode=="on")) {
+			IPAACA_DEBUG("Setting binary payload encoding " << newmode)
+			__ipaaca_static_option_binary_payload = newmode;
+		} else {
+			IPAACA_WARNING("Ignoring unknown binary payload mode " << newmode << " - should be one of off, on")
+		}
+	} else if (name=="ipaaca-uid-mode") {
+		std::string newmode = optarg;
+		if ((newmode=="uuid") || (newmode=="counter")) {
+			IPAACA_DEBUG("Setting UID mode " << newmode)
+			__ipaaca_static_option_uid_mode = newmode;
+		} else {
+			IPAACA_WARNING("Ignoring unknown UID mode " << newmode << " - should be one of uuid, counter")
+		}
+	} else if (name=="ipaaca-payload-patches") {
+		std::string newmode = optarg;
+		if ((newmode=="off") || (newmode=="on")) {
+			IPAACA_DEBUG("Setting payload patch mode " << newmode)
+			__ipaaca_static_option_payload_patches = newmode;
+		} else {
+			IPAACA_WARNING("Ignoring unknown payload patch mode " << newmode << " - should be one of off, on")
+		}
 	} else if (name=="rsb-host") {
 		std::string newhost = optarg;
 		IPAACA_DEBUG("Setting RSB host " << newhost)
@@ -54,8 +54,8 @@ IPAACA_EXPORT inline FakeIU::~FakeIU() { }
 IPAACA_EXPORT inline Payload& FakeIU::payload() { return _payload; }
 IPAACA_EXPORT inline const Payload& FakeIU::const_payload() const { return _payload; }
 IPAACA_EXPORT inline void FakeIU::commit() { }
-IPAACA_EXPORT inline void FakeIU::_modify_links(bool is_delta, const LinkMap& new_links, const LinkMap& links_to_remove, const std::string& writer_name) { }
-IPAACA_EXPORT inline void FakeIU::_modify_payload(bool is_delta, const std::map<std::string, PayloadDocumentEntry::ptr>& new_items, const std::vector<std::string>& keys_to_remove, const std::string& writer_name) { }
+IPAACA_EXPORT inline void FakeIU::_modify_links(bool is_delta, const LinkMap& new_links, const LinkMap& links_to_remove, const std::string& writer_name) { _apply_links(is_delta, new_links, links_to_remove); }
+IPAACA_EXPORT inline void FakeIU::_modify_payload(bool is_delta, const std::map<std::string, PayloadDocumentEntry::ptr>& new_items, const std::vector<std::string>& keys_to_remove, const std::string& writer_name) { _payload._apply_update(is_delta, new_items, keys_to_remove); }
 IPAACA_EXPORT inline void FakeIU::_apply_update(IUPayloadUpdate::ptr update) { }
 IPAACA_EXPORT inline void FakeIU::_apply_link_update(IULinkUpdate::ptr update) { }
 IPAACA_EXPORT inline void FakeIU::_apply_commission() { }
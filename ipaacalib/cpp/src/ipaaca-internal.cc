@@ -56,18 +56,23 @@ IPAACA_EXPORT void Initializer::initialize_backend()//{{{
 	IPAACA_DEBUG("Creating and registering Converters")
 	boost::shared_ptr<IUConverter> iu_converter(new IUConverter());
 	converterRepository<std::string>()->registerConverter(iu_converter);
+	ConverterRegistry::instance().register_converter(iu_converter);
 
 	boost::shared_ptr<MessageConverter> message_converter(new MessageConverter());
 	converterRepository<std::string>()->registerConverter(message_converter);
+	ConverterRegistry::instance().register_converter(message_converter);
 
 	boost::shared_ptr<IUPayloadUpdateConverter> payload_update_converter(new IUPayloadUpdateConverter());
 	converterRepository<std::string>()->registerConverter(payload_update_converter);
+	ConverterRegistry::instance().register_converter(payload_update_converter);
 
 	boost::shared_ptr<IULinkUpdateConverter> link_update_converter(new IULinkUpdateConverter());
 	converterRepository<std::string>()->registerConverter(link_update_converter);
+	ConverterRegistry::instance().register_converter(link_update_converter);
 
 	boost::shared_ptr<ProtocolBufferConverter<protobuf::IUCommission> > iu_commission_converter(new ProtocolBufferConverter<protobuf::IUCommission> ());
 	converterRepository<std::string>()->registerConverter(iu_commission_converter);
+	ConverterRegistry::instance().register_converter(iu_commission_converter);
 
 	// dlw
 	boost::shared_ptr<ProtocolBufferConverter<protobuf::IUResendRequest> > iu_resendrequest_converter(new ProtocolBufferConverter<protobuf::IUResendRequest> ());
@@ -75,6 +80,14 @@ IPAACA_EXPORT void Initializer::initialize_backend()//{{{
 
 	boost::shared_ptr<ProtocolBufferConverter<protobuf::IURetraction> > iu_retraction_converter(new ProtocolBufferConverter<protobuf::IURetraction> ());
 	converterRepository<std::string>()->registerConverter(iu_retraction_converter);
+	ConverterRegistry::instance().register_converter(iu_retraction_converter);
+
+	boost::shared_ptr<ProtocolBufferConverter<protobuf::IUEventBatch> > iu_event_batch_converter(new ProtocolBufferConverter<protobuf::IUEventBatch> ());
+	converterRepository<std::string>()->registerConverter(iu_event_batch_converter);
+	ConverterRegistry::instance().register_converter(iu_event_batch_converter);
+
+	boost::shared_ptr<ProtocolBufferConverter<protobuf::IUWriteBatchResult> > iu_write_batch_result_converter(new ProtocolBufferConverter<protobuf::IUWriteBatchResult> ());
+	converterRepository<std::string>()->registerConverter(iu_write_batch_result_converter);
 
 //	boost::shared_ptr<IntConverter> int_converter(new IntConverter());
 //	converterRepository<std::string>()->registerConverter(int_converter);
@@ -113,8 +126,13 @@ IPAACA_EXPORT void Initializer::auto_configure_rsb()//{{{
 			IPAACA_INFO("Overriding RSB transport mode - using 'spread' ")
 			IPAACA_SETENV("RSB_TRANSPORT_SPREAD_ENABLED", "1");
 			IPAACA_SETENV("RSB_TRANSPORT_SOCKET_ENABLED", "0");
-		} else if (__ipaaca_static_option_rsb_transport == "socket") {
-			IPAACA_INFO("Overriding RSB transport mode - using 'socket' ")
+		} else if ((__ipaaca_static_option_rsb_transport == "socket") || (__ipaaca_static_option_rsb_transport == "shm")) {
+			if (__ipaaca_static_option_rsb_transport == "shm") {
+				// IU events go through ShmTransport, RSB is only used for RPC
+				IPAACA_INFO("Overriding RSB transport mode - using 'shm' (shared memory for IU events, 'socket' for RPC) ")
+			} else {
+				IPAACA_INFO("Overriding RSB transport mode - using 'socket' ")
+			}
 			IPAACA_SETENV("RSB_TRANSPORT_SPREAD_ENABLED", "0");
 			IPAACA_SETENV("RSB_TRANSPORT_SOCKET_ENABLED", "1");
 			if (__ipaaca_static_option_rsb_socketserver!="") {
@@ -176,6 +194,83 @@ IPAACA_EXPORT void Initializer::auto_configure_rsb()//{{{
 }//}}}
 
 // RSB backend Converters
+// payload item helpers shared by the converters//{{{
+
+static inline bool _binary_payload_enabled()
+{
+	return __ipaaca_static_option_binary_payload == "on";
+}
+static inline bool _payload_patches_enabled()
+{
+	return __ipaaca_static_option_payload_patches == "on";
+}
+/// per-thread protobuf envelope, cleared for reuse: Clear() keeps the
+/// allocated strings and repeated items, so steady-state (de)serialization
+/// of similar events does not touch the heap for the envelope
+template<class ProtobufT>
+static inline ProtobufT& _scratch_message()
+{
+	static thread_local ProtobufT message;
+	message.Clear();
+	return message;
+}
+/// fill a wire payload item; binary encoding only for JSON payloads. Returns false for unknown payload types.
+/// entry_ids: include the entry identity (required for later patches against it);
+/// patches: send the recorded path-level changes instead of the whole entry, if there are any
+static bool _pack_payload_item(protobuf::PayloadItem* item, const std::string& key, PayloadDocumentEntry::ptr entry, PayloadType payload_type, bool binary, bool entry_ids=false, bool patches=false)
+{
+	item->set_key(key);
+	switch (payload_type) {
+		case PAYLOAD_TYPE_JSON:
+			if (entry_ids && entry->entry_id) {
+				item->set_entry_id(entry->entry_id);
+			}
+			if (patches && entry->entry_id && entry->patch) {
+				entry->patch->write_operations(*(item->mutable_value()));
+				item->set_base_entry_id(entry->patch->base_entry_id);
+				item->set_type("JSONPATCH");
+			} else if (binary) {
+				item->set_value("");
+				entry->write_binary_representation(*(item->mutable_binary_value()));
+				item->set_type("BIN");
+			} else {
+				entry->write_json_string_representation(*(item->mutable_value()));
+				item->set_type("JSON");
+			}
+			return true;
+		case PAYLOAD_TYPE_MAP:
+		case PAYLOAD_TYPE_STR:
+			// legacy mode
+			entry->ensure_parsed();
+			item->set_value( json_value_cast<std::string>(entry->document));
+			item->set_type("STR");
+			return true;
+		default:
+			return false;
+	}
+}
+static PayloadDocumentEntry::ptr _unpack_payload_item(const protobuf::PayloadItem& it)
+{
+	if (it.type() == "JSON") {
+		// keep json text, parsed on first access
+		PayloadDocumentEntry::ptr entry = PayloadDocumentEntry::from_unparsed_json( it.value() );
+		entry->entry_id = it.entry_id(); // 0 (unknown) if the sender did not track it
+		return entry;
+	} else if (it.type() == "BIN") {
+		PayloadDocumentEntry::ptr entry = PayloadDocumentEntry::from_unparsed_binary( it.binary_value() );
+		entry->entry_id = it.entry_id();
+		return entry;
+	} else if (it.type() == "JSONPATCH") {
+		// resolved against the receiver's current entry (Payload::_resolve_patches)
+		return PayloadDocumentEntry::from_unresolved_patch( it.value(), it.base_entry_id(), it.entry_id() );
+	} else {
+		// assuming legacy "str" -> just copy value to raw string in document
+		PayloadDocumentEntry::ptr entry = std::make_shared<PayloadDocumentEntry>();
+		entry->document.SetString(it.value(), entry->document.GetAllocator());
+		return entry;
+	}
+}
+//}}}
 // IUConverter//{{{
 
 IPAACA_EXPORT IUConverter::IUConverter()
@@ -187,63 +282,86 @@ IPAACA_EXPORT std::string IUConverter::serialize(const AnnotatedData& data, std:
 {
 	assert(data.first == getDataType()); // "ipaaca::IU"
 	boost::shared_ptr<const IU> obj = boost::static_pointer_cast<const IU> (data.second);
-	boost::shared_ptr<protobuf::IU> pbo(new protobuf::IU());
-	// transfer obj data to pbo
-	pbo->set_uid(obj->uid());
-	pbo->set_revision(obj->revision());
-	pbo->set_category(obj->category());
-	pbo->set_payload_type(obj->payload_type());
-	pbo->set_owner_name(obj->owner_name());
-	pbo->set_committed(obj->committed());
-	ipaaca::protobuf::IU_AccessMode a_m;
-	switch(obj->access_mode()) {
-		case IU_ACCESS_PUSH:
-			a_m = ipaaca::protobuf::IU_AccessMode_PUSH;
-			break;
-		case IU_ACCESS_REMOTE:
-			a_m = ipaaca::protobuf::IU_AccessMode_REMOTE;
-			break;
-		case IU_ACCESS_MESSAGE:
-			a_m = ipaaca::protobuf::IU_AccessMode_MESSAGE;
-			break;
-	}
-	pbo->set_access_mode(a_m);
-	pbo->set_read_only(obj->read_only());
-	for (auto& kv: obj->_payload._document_store) {
-		protobuf::PayloadItem* item = pbo->add_payload();
-		item->set_key(kv.first);
-		IPAACA_DEBUG("Payload type: " << obj->_payload_type)
-		if (obj->_payload_type=="JSON") {
-			item->set_value( kv.second->to_json_string_representation() );
-			item->set_type("JSON");
-		} else if ((obj->_payload_type=="MAP") || (obj->_payload_type=="STR")) {
-			// legacy mode
-			item->set_value( json_value_cast<std::string>(kv.second->document));
-			item->set_type("STR");
+	bool binary = _binary_payload_enabled();
+	bool entry_ids = _payload_patches_enabled();
+	boost::shared_ptr<IUWireCache> cache = obj->_wire_cache;
+	protobuf::IU* pbo = &_scratch_message<protobuf::IU>();
+	revision_t revision;
+	{
+		// revision, payload, links and commission are changed together under the revision lock
+		Locker revision_locker(obj->_revision_lock);
+		revision = obj->_revision;
+		if (cache) {
+			// resends and repeated publishes of an unchanged IU reuse the wire form
+			Locker locker(cache->lock);
+			if (cache->valid && (cache->revision == revision) && (cache->binary_payload == binary) && (cache->entry_ids == entry_ids)) {
+				wire = cache->wire;
+				return cache->wire_schema;
+			}
 		}
-	}
-	for (LinkMap::const_iterator it=obj->_links._links.begin(); it!=obj->_links._links.end(); ++it) {
-		protobuf::LinkSet* links = pbo->add_links();
-		links->set_type(it->first);
-		for (std::set<std::string>::const_iterator it2=it->second.begin(); it2!=it->second.end(); ++it2) {
-			links->add_targets(*it2);
+		// transfer obj data to pbo
+		pbo->set_uid(obj->uid());
+		pbo->set_revision(revision);
+		pbo->set_category(obj->category());
+		pbo->set_payload_type(obj->payload_type());
+		pbo->set_owner_name(obj->owner_name());
+		pbo->set_committed(obj->committed());
+		ipaaca::protobuf::IU_AccessMode a_m;
+		switch(obj->access_mode()) {
+			case IU_ACCESS_PUSH:
+				a_m = ipaaca::protobuf::IU_AccessMode_PUSH;
+				break;
+			case IU_ACCESS_REMOTE:
+				a_m = ipaaca::protobuf::IU_AccessMode_REMOTE;
+				break;
+			case IU_ACCESS_MESSAGE:
+				a_m = ipaaca::protobuf::IU_AccessMode_MESSAGE;
+				break;
+		}
+		pbo->set_access_mode(a_m);
+		pbo->set_read_only(obj->read_only());
+		for (auto& kv: *obj->_payload._snapshot()) {
+			_pack_payload_item(pbo->add_payload(), kv.first, kv.second, obj->_payload_type_tag, binary, entry_ids);
+		}
+		pbo->set_binary_payload_accepted(true);
+		pbo->set_payload_patch_accepted(true);
+		for (LinkMap::const_iterator it=obj->_links._links.begin(); it!=obj->_links._links.end(); ++it) {
+			protobuf::LinkSet* links = pbo->add_links();
+			links->set_type(it->first);
+			for (std::set<std::string>::const_iterator it2=it->second.begin(); it2!=it->second.end(); ++it2) {
+				links->add_targets(*it2);
+			}
 		}
 	}
 	pbo->SerializeToString(&wire);
+	std::string wire_schema;
 	switch(obj->access_mode()) {
 		case IU_ACCESS_PUSH:
-			return "ipaaca-iu";
+			wire_schema = "ipaaca-iu";
+			break;
 		case IU_ACCESS_MESSAGE:
-			return "ipaaca-messageiu";
+			wire_schema = "ipaaca-messageiu";
+			break;
 		default:
-			return getWireSchema();
+			wire_schema = getWireSchema();
 	}
+	// the wire form matches revision; do not replace the form of a newer revision
+	if (cache && (obj->revision() == revision)) {
+		Locker locker(cache->lock);
+		cache->valid = true;
+		cache->revision = revision;
+		cache->binary_payload = binary;
+		cache->entry_ids = entry_ids;
+		cache->wire_schema = wire_schema;
+		cache->wire = wire;
+	}
+	return wire_schema;
 
 }
 
 IPAACA_EXPORT AnnotatedData IUConverter::deserialize(const std::string& wireSchema, const std::string& wire) {
 	assert(wireSchema == getWireSchema()); // "ipaaca-iu"
-	boost::shared_ptr<protobuf::IU> pbo(new protobuf::IU());
+	protobuf::IU* pbo = &_scratch_message<protobuf::IU>();
 	pbo->ParseFromString(wire);
 	IUAccessMode mode = static_cast<IUAccessMode>(pbo->access_mode());
 	switch(mode) {
@@ -252,27 +370,22 @@ IPAACA_EXPORT AnnotatedData IUConverter::deserialize(const std::string& wireSche
 			// Create a "remote push IU"
 			boost::shared_ptr<RemotePushIU> obj = RemotePushIU::create();
 			// transfer pbo data to obj
-			obj->_uid = pbo->uid();
+			obj->_set_uid(pbo->uid());
 			obj->_revision = pbo->revision();
 			obj->_category = pbo->category();
-			obj->_payload_type = pbo->payload_type();
+			obj->_set_payload_type(pbo->payload_type());
 			obj->_owner_name = pbo->owner_name();
 			obj->_committed = pbo->committed();
 			obj->_read_only = pbo->read_only();
 			obj->_access_mode = IU_ACCESS_PUSH;
+			obj->_owner_accepts_binary_payload = pbo->binary_payload_accepted();
+			obj->_owner_accepts_payload_patches = pbo->payload_patch_accepted();
+			auto store = std::make_shared<PayloadDocumentStore>();
 			for (int i=0; i<pbo->payload_size(); i++) {
 				const protobuf::PayloadItem& it = pbo->payload(i);
-				PayloadDocumentEntry::ptr entry;
-				if (it.type() == "JSON") {
-					// fully parse json text
-					entry = PayloadDocumentEntry::from_json_string_representation( it.value() );
-				} else {
-					// assuming legacy "str" -> just copy value to raw string in document
-					entry = std::make_shared<PayloadDocumentEntry>();
-					entry->document.SetString(it.value(), entry->document.GetAllocator());
-				}
-				obj->_payload._document_store[it.key()] = entry;
+				(*store)[it.key()] = _unpack_payload_item(it);
 			}
+			obj->_payload._replace_store(store);
 			for (int i=0; i<pbo->links_size(); i++) {
 				const protobuf::LinkSet& pls = pbo->links(i);
 				LinkSet& ls = obj->_links._links[pls.type()];
@@ -289,27 +402,20 @@ IPAACA_EXPORT AnnotatedData IUConverter::deserialize(const std::string& wireSche
 			boost::shared_ptr<RemoteMessage> obj = RemoteMessage::create();
 			//std::cout << "REFCNT after create: " << obj.use_count() << std::endl;
 			// transfer pbo data to obj
-			obj->_uid = pbo->uid();
+			obj->_set_uid(pbo->uid());
 			obj->_revision = pbo->revision();
 			obj->_category = pbo->category();
-			obj->_payload_type = pbo->payload_type();
+			obj->_set_payload_type(pbo->payload_type());
 			obj->_owner_name = pbo->owner_name();
 			obj->_committed = pbo->committed();
 			obj->_read_only = pbo->read_only();
 			obj->_access_mode = IU_ACCESS_MESSAGE;
+			auto store = std::make_shared<PayloadDocumentStore>();
 			for (int i=0; i<pbo->payload_size(); i++) {
 				const protobuf::PayloadItem& it = pbo->payload(i);
-				PayloadDocumentEntry::ptr entry;
-				if (it.type() == "JSON") {
-					// fully parse json text
-					entry = PayloadDocumentEntry::from_json_string_representation( it.value() );
-				} else {
-					// assuming legacy "str" -> just copy value to raw string in document
-					entry = std::make_shared<PayloadDocumentEntry>();
-					entry->document.SetString(it.value(), entry->document.GetAllocator());
-				}
-				obj->_payload._document_store[it.key()] = entry;
+				(*store)[it.key()] = _unpack_payload_item(it);
 			}
+			obj->_payload._replace_store(store);
 			for (int i=0; i<pbo->links_size(); i++) {
 				const protobuf::LinkSet& pls = pbo->links(i);
 				LinkSet& ls = obj->_links._links[pls.type()];
@@ -338,7 +444,7 @@ IPAACA_EXPORT std::string MessageConverter::serialize(const AnnotatedData& data,
 {
 	assert(data.first == getDataType()); // "ipaaca::Message"
 	boost::shared_ptr<const Message> obj = boost::static_pointer_cast<const Message> (data.second);
-	boost::shared_ptr<protobuf::IU> pbo(new protobuf::IU());
+	protobuf::IU* pbo = &_scratch_message<protobuf::IU>();
 	// transfer obj data to pbo
 	pbo->set_uid(obj->uid());
 	pbo->set_revision(obj->revision());
@@ -360,18 +466,11 @@ IPAACA_EXPORT std::string MessageConverter::serialize(const AnnotatedData& data,
 	}
 	pbo->set_access_mode(a_m);
 	pbo->set_read_only(obj->read_only());
-	for (auto& kv: obj->_payload._document_store) {
-		protobuf::PayloadItem* item = pbo->add_payload();
-		item->set_key(kv.first);
-		if (obj->_payload_type=="JSON") {
-			item->set_value( kv.second->to_json_string_representation() );
-			item->set_type("JSON");
-		} else if ((obj->_payload_type=="MAP") || (obj->_payload_type=="STR")) {
-			// legacy mode
-			item->set_value( json_value_cast<std::string>(kv.second->document));
-			item->set_type("STR");
-		}
+	bool binary = _binary_payload_enabled();
+	for (auto& kv: *obj->_payload._snapshot()) {
+		_pack_payload_item(pbo->add_payload(), kv.first, kv.second, obj->_payload_type_tag, binary);
 	}
+	pbo->set_binary_payload_accepted(true);
 	for (LinkMap::const_iterator it=obj->_links._links.begin(); it!=obj->_links._links.end(); ++it) {
 		protobuf::LinkSet* links = pbo->add_links();
 		links->set_type(it->first);
@@ -393,7 +492,7 @@ IPAACA_EXPORT std::string MessageConverter::serialize(const AnnotatedData& data,
 
 IPAACA_EXPORT AnnotatedData MessageConverter::deserialize(const std::string& wireSchema, const std::string& wire) {
 	assert(wireSchema == getWireSchema()); // "ipaaca-iu"
-	boost::shared_ptr<protobuf::IU> pbo(new protobuf::IU());
+	protobuf::IU* pbo = &_scratch_message<protobuf::IU>();
 	pbo->ParseFromString(wire);
 	IUAccessMode mode = static_cast<IUAccessMode>(pbo->access_mode());
 	switch(mode) {
@@ -402,27 +501,21 @@ IPAACA_EXPORT AnnotatedData MessageConverter::deserialize(const std::string& wir
 			// Create a "remote push IU"
 			boost::shared_ptr<RemotePushIU> obj = RemotePushIU::create();
 			// transfer pbo data to obj
-			obj->_uid = pbo->uid();
+			obj->_set_uid(pbo->uid());
 			obj->_revision = pbo->revision();
 			obj->_category = pbo->category();
-			obj->_payload_type = pbo->payload_type();
+			obj->_set_payload_type(pbo->payload_type());
 			obj->_owner_name = pbo->owner_name();
 			obj->_committed = pbo->committed();
 			obj->_read_only = pbo->read_only();
 			obj->_access_mode = IU_ACCESS_PUSH;
+			obj->_owner_accepts_binary_payload = pbo->binary_payload_accepted();
+			auto store = std::make_shared<PayloadDocumentStore>();
 			for (int i=0; i<pbo->payload_size(); i++) {
 				const protobuf::PayloadItem& it = pbo->payload(i);
-				PayloadDocumentEntry::ptr entry;
-				if (it.type() == "JSON") {
-					// fully parse json text
-					entry = PayloadDocumentEntry::from_json_string_representation( it.value() );
-				} else {
-					// assuming legacy "str" -> just copy value to raw string in document
-					entry = std::make_shared<PayloadDocumentEntry>();
-					entry->document.SetString(it.value(), entry->document.GetAllocator());
-				}
-				obj->_payload._document_store[it.key()] = entry;
+				(*store)[it.key()] = _unpack_payload_item(it);
 			}
+			obj->_payload._replace_store(store);
 			for (int i=0; i<pbo->links_size(); i++) {
 				const protobuf::LinkSet& pls = pbo->links(i);
 				LinkSet& ls = obj->_links._links[pls.type()];
@@ -438,27 +531,20 @@ IPAACA_EXPORT AnnotatedData MessageConverter::deserialize(const std::string& wir
 			// Create a "Message-type IU"
 			boost::shared_ptr<RemoteMessage> obj = RemoteMessage::create();
 			// transfer pbo data to obj
-			obj->_uid = pbo->uid();
+			obj->_set_uid(pbo->uid());
 			obj->_revision = pbo->revision();
 			obj->_category = pbo->category();
-			obj->_payload_type = pbo->payload_type();
+			obj->_set_payload_type(pbo->payload_type());
 			obj->_owner_name = pbo->owner_name();
 			obj->_committed = pbo->committed();
 			obj->_read_only = pbo->read_only();
 			obj->_access_mode = IU_ACCESS_MESSAGE;
+			auto store = std::make_shared<PayloadDocumentStore>();
 			for (int i=0; i<pbo->payload_size(); i++) {
 				const protobuf::PayloadItem& it = pbo->payload(i);
-				PayloadDocumentEntry::ptr entry;
-				if (it.type() == "JSON") {
-					// fully parse json text
-					entry = PayloadDocumentEntry::from_json_string_representation( it.value() );
-				} else {
-					// assuming legacy "str" -> just copy value to raw string in document
-					entry = std::make_shared<PayloadDocumentEntry>();
-					entry->document.SetString(it.value(), entry->document.GetAllocator());
-				}
-				obj->_payload._document_store[it.key()] = entry;
+				(*store)[it.key()] = _unpack_payload_item(it);
 			}
+			obj->_payload._replace_store(store);
 			for (int i=0; i<pbo->links_size(); i++) {
 				const protobuf::LinkSet& pls = pbo->links(i);
 				LinkSet& ls = obj->_links._links[pls.type()];
@@ -487,23 +573,15 @@ IPAACA_EXPORT std::string IUPayloadUpdateConverter::serialize(const AnnotatedDat
 {
 	assert(data.first == getDataType()); // "ipaaca::IUPayloadUpdate"
 	boost::shared_ptr<const IUPayloadUpdate> obj = boost::static_pointer_cast<const IUPayloadUpdate> (data.second);
-	boost::shared_ptr<protobuf::IUPayloadUpdate> pbo(new protobuf::IUPayloadUpdate());
+	protobuf::IUPayloadUpdate* pbo = &_scratch_message<protobuf::IUPayloadUpdate>();
 	// transfer obj data to pbo
 	pbo->set_uid(obj->uid);
 	pbo->set_revision(obj->revision);
-	pbo->set_writer_name(obj->writer_name);
+	pbo->set_writer_name(obj->writer_name.str());
 	pbo->set_is_delta(obj->is_delta);
 	for (auto& kv: obj->new_items) {
 		protobuf::PayloadItem* item = pbo->add_new_items();
-		item->set_key(kv.first);
-		if (obj->payload_type=="JSON") {
-			item->set_value( kv.second->to_json_string_representation() );
-			item->set_type("JSON");
-		} else if ((obj->payload_type=="MAP") || (obj->payload_type=="STR")) {
-			// legacy mode
-			item->set_value( json_value_cast<std::string>(kv.second->document));
-			item->set_type("STR");
-		} else {
+		if (! _pack_payload_item(item, kv.first, kv.second, obj->payload_type_tag, obj->binary_encoding, obj->patch_encoding, obj->patch_encoding)) {
 			IPAACA_ERROR("Uninitialized payload update type!")
 			throw NotImplementedError();
 		}
@@ -520,7 +598,7 @@ IPAACA_EXPORT std::string IUPayloadUpdateConverter::serialize(const AnnotatedDat
 
 AnnotatedData IUPayloadUpdateConverter::deserialize(const std::string& wireSchema, const std::string& wire) {
 	assert(wireSchema == getWireSchema()); // "ipaaca-iu-payload-update"
-	boost::shared_ptr<protobuf::IUPayloadUpdate> pbo(new protobuf::IUPayloadUpdate());
+	protobuf::IUPayloadUpdate* pbo = &_scratch_message<protobuf::IUPayloadUpdate>();
 	pbo->ParseFromString(wire);
 	boost::shared_ptr<IUPayloadUpdate> obj(new IUPayloadUpdate());
 	// transfer pbo data to obj
@@ -530,17 +608,8 @@ AnnotatedData IUPayloadUpdateConverter::deserialize(const std::string& wireSchem
 	obj->is_delta = pbo->is_delta();
 	for (int i=0; i<pbo->new_items_size(); i++) {
 		const protobuf::PayloadItem& it = pbo->new_items(i);
-		PayloadDocumentEntry::ptr entry;
-		if (it.type() == "JSON") {
-			// fully parse json text
-			entry = PayloadDocumentEntry::from_json_string_representation( it.value() );
-			IPAACA_INFO("New/updated payload entry: " << it.key() << " -> " << it.value() )
-		} else {
-			// assuming legacy "str" -> just copy value to raw string in document
-			entry = std::make_shared<PayloadDocumentEntry>();
-			entry->document.SetString(it.value(), entry->document.GetAllocator());
-		}
-		obj->new_items[it.key()] = entry;
+		obj->new_items[it.key()] = _unpack_payload_item(it);
+		IPAACA_INFO("New/updated payload entry: " << it.key() << " (" << it.type() << ")")
 	}
 	for (int i=0; i<pbo->keys_to_remove_size(); i++) {
 		obj->keys_to_remove.push_back(pbo->keys_to_remove(i));
@@ -560,11 +629,11 @@ IPAACA_EXPORT std::string IULinkUpdateConverter::serialize(const AnnotatedData&
 {
 	assert(data.first == getDataType());
 	boost::shared_ptr<const IULinkUpdate> obj = boost::static_pointer_cast<const IULinkUpdate> (data.second);
-	boost::shared_ptr<protobuf::IULinkUpdate> pbo(new protobuf::IULinkUpdate());
+	protobuf::IULinkUpdate* pbo = &_scratch_message<protobuf::IULinkUpdate>();
 	// transfer obj data to pbo
 	pbo->set_uid(obj->uid);
 	pbo->set_revision(obj->revision);
-	pbo->set_writer_name(obj->writer_name);
+	pbo->set_writer_name(obj->writer_name.str());
 	pbo->set_is_delta(obj->is_delta);
 	for (std::map<std::string, std::set<std::string> >::const_iterator it=obj->new_links.begin(); it!=obj->new_links.end(); ++it) {
 		protobuf::LinkSet* links = pbo->add_new_links();
@@ -587,7 +656,7 @@ IPAACA_EXPORT std::string IULinkUpdateConverter::serialize(const AnnotatedData&
 
 AnnotatedData IULinkUpdateConverter::deserialize(const std::string& wireSchema, const std::string& wire) {
 	assert(wireSchema == getWireSchema()); // "ipaaca-iu-link-update"
-	boost::shared_ptr<protobuf::IULinkUpdate> pbo(new protobuf::IULinkUpdate());
+	protobuf::IULinkUpdate* pbo = &_scratch_message<protobuf::IULinkUpdate>();
 	pbo->ParseFromString(wire);
 	boost::shared_ptr<IULinkUpdate> obj(new IULinkUpdate());
 	// transfer pbo data to obj
@@ -612,6 +681,61 @@ AnnotatedData IULinkUpdateConverter::deserialize(const std::string& wireSchema,
 
 //}}}
 
+// IUWireEventType//{{{
+IPAACA_EXPORT IUWireEventType iu_wire_event_type(const std::string& type)
+{
+	static const std::unordered_map<std::string, IUWireEventType> tags = {
+		{"ipaaca::protobuf::IUEventBatch", IU_WIRE_EVENT_BATCH},
+		{"ipaaca::RemotePushIU", IU_WIRE_EVENT_REMOTE_PUSH_IU},
+		{"ipaaca::RemoteMessage", IU_WIRE_EVENT_REMOTE_MESSAGE},
+		{"ipaaca::IUPayloadUpdate", IU_WIRE_EVENT_PAYLOAD_UPDATE},
+		{"ipaaca::IULinkUpdate", IU_WIRE_EVENT_LINK_UPDATE},
+		{"ipaaca::protobuf::IUCommission", IU_WIRE_EVENT_COMMISSION},
+		{"ipaaca::protobuf::IURetraction", IU_WIRE_EVENT_RETRACTION},
+	};
+	auto it = tags.find(type);
+	return (it == tags.end()) ? IU_WIRE_EVENT_UNKNOWN : it->second;
+}
+//}}}
+
+// ConverterRegistry//{{{
+IPAACA_EXPORT ConverterRegistry& ConverterRegistry::instance()
+{
+	static ConverterRegistry registry;
+	return registry;
+}
+IPAACA_EXPORT void ConverterRegistry::register_converter(Converter<std::string>::Ptr converter)
+{
+	Locker locker(_lock);
+	_converters_by_type[converter->getDataType()] = converter;
+	_converters_by_wire_schema[converter->getWireSchema()] = converter;
+}
+IPAACA_EXPORT bool ConverterRegistry::serialize(const std::string& type, VoidPtr data, std::string& wire_schema, std::string& wire)
+{
+	Converter<std::string>::Ptr converter;
+	{
+		Locker locker(_lock);
+		std::map<std::string, Converter<std::string>::Ptr>::iterator it = _converters_by_type.find(type);
+		if (it == _converters_by_type.end()) return false;
+		converter = it->second;
+	}
+	wire_schema = converter->serialize(std::make_pair(type, data), wire);
+	return true;
+}
+IPAACA_EXPORT bool ConverterRegistry::deserialize(const std::string& wire_schema, const std::string& wire, AnnotatedData& result)
+{
+	Converter<std::string>::Ptr converter;
+	{
+		Locker locker(_lock);
+		std::map<std::string, Converter<std::string>::Ptr>::iterator it = _converters_by_wire_schema.find(wire_schema);
+		if (it == _converters_by_wire_schema.end()) return false;
+		converter = it->second;
+	}
+	result = converter->deserialize(wire_schema, wire);
+	return true;
+}
+//}}}
+
 /*
 // IntConverter//{{{
 
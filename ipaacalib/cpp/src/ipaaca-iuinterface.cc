@@ -59,7 +59,7 @@ IPAACA_EXPORT std::ostream& operator<<(std::ostream& os, const IUInterface& obj)
 // IUInterface//{{{
 
 IPAACA_EXPORT IUInterface::IUInterface()
-: _buffer(NULL), _committed(false), _retracted(false)
+: _payload_type_tag(PAYLOAD_TYPE_UNKNOWN), _buffer(NULL), _committed(false), _retracted(false)
 {
 }
 
@@ -68,6 +68,7 @@ IPAACA_EXPORT void IUInterface::_set_uid(const std::string& uid) {
 		throw IUAlreadyHasAnUIDError();
 	}
 	_uid = uid;
+	_binary_uid = IUId(uid);
 }
 
 IPAACA_EXPORT void IUInterface::_set_buffer(Buffer* buffer) {
@@ -79,7 +80,7 @@ IPAACA_EXPORT void IUInterface::_set_buffer(Buffer* buffer) {
 }
 
 IPAACA_EXPORT void IUInterface::_set_owner_name(const std::string& owner_name) {
-	if (_owner_name != "") {
+	if (! _owner_name.empty()) {
 		throw IUAlreadyHasAnOwnerNameError();
 	}
 	_owner_name = owner_name;
@@ -99,7 +100,6 @@ IPAACA_EXPORT void IUInterface::add_link(const std::string& type, const std::str
 	LinkMap add;
 	add[type].insert(target);
 	_modify_links(true, add, none, writer_name);
-	_add_and_remove_links(add, none);
 }
 /// C++-specific convenience function to remove one single link
 IPAACA_EXPORT void IUInterface::remove_link(const std::string& type, const std::string& target, const std::string& writer_name)
@@ -108,7 +108,6 @@ IPAACA_EXPORT void IUInterface::remove_link(const std::string& type, const std::
 	LinkMap remove;
 	remove[type].insert(target);
 	_modify_links(true, none, remove, writer_name);
-	_add_and_remove_links(none, remove);
 }
 
 IPAACA_EXPORT void IUInterface::add_links(const std::string& type, const LinkSet& targets, const std::string& writer_name)
@@ -117,7 +116,6 @@ IPAACA_EXPORT void IUInterface::add_links(const std::string& type, const LinkSet
 	LinkMap add;
 	add[type] = targets;
 	_modify_links(true, add, none, writer_name);
-	_add_and_remove_links(add, none);
 }
 
 IPAACA_EXPORT void IUInterface::remove_links(const std::string& type, const LinkSet& targets, const std::string& writer_name)
@@ -126,20 +124,17 @@ IPAACA_EXPORT void IUInterface::remove_links(const std::string& type, const Link
 	LinkMap remove;
 	remove[type] = targets;
 	_modify_links(true, none, remove, writer_name);
-	_add_and_remove_links(none, remove);
 }
 
 IPAACA_EXPORT void IUInterface::modify_links(const LinkMap& add, const LinkMap& remove, const std::string& writer_name)
 {
 	_modify_links(true, add, remove, writer_name);
-	_add_and_remove_links(add, remove);
 }
 
 IPAACA_EXPORT void IUInterface::set_links(const LinkMap& links, const std::string& writer_name)
 {
 	LinkMap none;
 	_modify_links(false, links, none, writer_name);
-	_replace_links(links);
 }
 
 IPAACA_HEADER_EXPORT const std::string& IUInterface::channel()
@@ -53,11 +53,12 @@ IPAACA_EXPORT IU::ptr IU::create(const std::string& category, const std::string&
 }
 
 IPAACA_EXPORT IU::IU(const std::string& category, IUAccessMode access_mode, bool read_only, const std::string& payload_type)
+: _wire_cache(new IUWireCache())
 {
 	_revision = 1;
-	_uid = ipaaca::generate_uuid_string();
+	_uid = ipaaca::generate_iu_uid(_binary_uid);
 	_category = category;
-	_payload_type = (payload_type=="")?__ipaaca_static_option_default_payload_type:payload_type;
+	_set_payload_type((payload_type=="")?__ipaaca_static_option_default_payload_type:payload_type);
 	// payload initialization deferred to IU::create(), above
 	_read_only = read_only;
 	_access_mode = access_mode;
@@ -65,6 +66,35 @@ IPAACA_EXPORT IU::IU(const std::string& category, IUAccessMode access_mode, bool
 	_retracted = false;
 }
 
+IPAACA_EXPORT IU::IU(const IU& original)
+{
+	_uid = original._uid;
+	_binary_uid = original._binary_uid;
+	_revision = original._revision;
+	_category = original._category;
+	_payload_type = original._payload_type;
+	_payload_type_tag = original._payload_type_tag;
+	_owner_name = original._owner_name;
+	_read_only = original._read_only;
+	_access_mode = original._access_mode;
+	_committed = original._committed;
+	_retracted = original._retracted;
+	_buffer = original._buffer;
+	_links._links = original._links._links;
+	// same revision, same wire form
+	_wire_cache = original._wire_cache;
+	// published payload stores are immutable and can be shared
+	_payload._replace_store(original._payload._snapshot());
+}
+
+IPAACA_EXPORT IU::ptr IU::_create_snapshot()
+{
+	Locker locker(_revision_lock);
+	IU::ptr snapshot = IU::ptr(new IU(*this));
+	snapshot->_payload.initialize(snapshot);
+	return snapshot;
+}
+
 IPAACA_EXPORT void IU::_modify_links(bool is_delta, const LinkMap& new_links, const LinkMap& links_to_remove, const std::string& writer_name)
 {
 	_revision_lock.lock();
@@ -76,6 +106,7 @@ IPAACA_EXPORT void IU::_modify_links(bool is_delta, const LinkMap& new_links, co
 		throw IURetractedError();
 	}
 	_increase_revision_number();
+	_apply_links(is_delta, new_links, links_to_remove);
 	if (is_published()) {
 		_buffer->_send_iu_link_update(this, is_delta, _revision, new_links, links_to_remove, writer_name);
 	}
@@ -94,6 +125,8 @@ IPAACA_EXPORT void IU::_modify_payload(bool is_delta, const std::map<std::string
 		throw IURetractedError();
 	}
 	_increase_revision_number();
+	// published under the revision lock: a snapshot (resend, deferred send) never sees the new revision with the old entries
+	_payload._apply_update(is_delta, new_items, keys_to_remove);
 	if (is_published()) {
 		IPAACA_DEBUG("Sending a payload update, new entries:")
 		for (auto& kv: new_items) {
@@ -151,12 +184,14 @@ Message::Message(const std::string& category, IUAccessMode access_mode, bool rea
 
 void Message::_modify_links(bool is_delta, const LinkMap& new_links, const LinkMap& links_to_remove, const std::string& writer_name)
 {
+	_apply_links(is_delta, new_links, links_to_remove);
 	if (is_published()) {
 		IPAACA_INFO("Info: modifying a Message after sending has no global effects")
 	}
 }
 void Message::_modify_payload(bool is_delta, const std::map<std::string, PayloadDocumentEntry::ptr>& new_items, const std::vector<std::string>& keys_to_remove, const std::string& writer_name)
 {
+	_payload._apply_update(is_delta, new_items, keys_to_remove);
 	if (is_published()) {
 		IPAACA_INFO("Info: modifying a Message after sending has no global effects")
 	}
@@ -180,7 +215,134 @@ IPAACA_EXPORT RemotePushIU::ptr RemotePushIU::create()
 	return iu;
 }
 IPAACA_EXPORT RemotePushIU::RemotePushIU()
+: _owner_accepts_binary_payload(false), _owner_accepts_payload_patches(false), _resync_pending(false), _async_writes(false), _collected_write_failed(false)
+{
+}
+static bool _is_ready(const RevisionFuture& result)
+{
+	return result.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
+template<class CallbackT, class UpdateT> RemotePushIU::PendingWrite RemotePushIU::_call_owner(const std::string& method_name, boost::shared_ptr<UpdateT> update)
+{
+	PendingWrite write;
+	if (boost::static_pointer_cast<InputBuffer>(_buffer)->_enqueue_remote_write(_owner_name, rsc::runtime::typeName<UpdateT>(), update, _payload._iu, write.result)) {
+		RevisionFuture result = write.result;
+		write.answered = [result]() { return _is_ready(result); };
+		write.batched = true;
+		return write;
+	}
+	int64_t local_result;
+	if (LoopbackHub::instance().call_local_server<CallbackT>(_owner_name, method_name, update, local_result)) {
+		std::promise<revision_t> done;
+		if (local_result == 0) {
+			done.set_exception(std::make_exception_ptr(IUUpdateFailedError()));
+		} else {
+			_note_write_result(local_result);
+			done.set_value(local_result);
+		}
+		write.result = done.get_future().share();
+		write.answered = []() { return true; };
+		return write;
+	}
+	RemoteServerPtr server = boost::static_pointer_cast<InputBuffer>(_buffer)->_get_remote_server(_owner_name);
+	RemoteServer::DataFuture<int> reply = server->callAsync<int>(method_name, update);
+	// the request is on its way; the reply is collected by whoever waits for the future
+	boost::weak_ptr<IUInterface> iu_ref = _payload._iu;
+	write.result = std::async(std::launch::deferred, [iu_ref, reply]() mutable -> revision_t {
+		boost::shared_ptr<int> result = reply.get(IPAACA_REMOTE_SERVER_TIMEOUT);
+		if (*result == 0) {
+			throw IUUpdateFailedError();
+		}
+		IUInterface::ptr iu = iu_ref.lock();
+		if (iu) {
+			boost::static_pointer_cast<RemotePushIU>(iu)->_note_write_result(*result);
+		}
+		return *result;
+	}).share();
+	// a deferred future only becomes ready when someone waits for it - ask RSB instead
+	RevisionFuture result = write.result;
+	write.answered = [result, reply]() mutable { return _is_ready(result) || reply.isDone(); };
+	return write;
+}
+IPAACA_EXPORT revision_t RemotePushIU::_next_write_revision()
+{
+	Locker locker(_pending_writes_lock);
+	_collect_answered_writes();
+	if (!_pending_writes.empty()) return _pending_writes.back().revision + 1;
+	Locker revision_locker(_revision_lock);
+	return _revision;
+}
+IPAACA_EXPORT void RemotePushIU::_track_pending_write(const PendingWrite& write)
+{
+	Locker locker(_pending_writes_lock);
+	_last_write = write.result;
+	_pending_writes.push_back(write);
+	_collect_answered_writes();
+	while (_pending_writes.size() > IPAACA_REMOTE_WRITE_PIPELINE_DEPTH) {
+		// batched writes are only answered on flush - must not wait for them here
+		if (_pending_writes.front().batched) break;
+		_collect_write(_pending_writes.front());
+		_pending_writes.pop_front();
+	}
+}
+IPAACA_EXPORT void RemotePushIU::_collect_answered_writes()
+{
+	for (std::deque<PendingWrite>::iterator it = _pending_writes.begin(); it != _pending_writes.end(); ) {
+		if (it->answered()) {
+			_collect_write(*it);
+			it = _pending_writes.erase(it);
+		} else {
+			++it;
+		}
+	}
+}
+IPAACA_EXPORT void RemotePushIU::_collect_write(const PendingWrite& write)
+{
+	// waiting applies the reply (_note_write_result); a failure also stays stored in the future
+	try {
+		write.result.get();
+	} catch (...) {
+		_collected_write_failed = true;
+	}
+}
+IPAACA_EXPORT void RemotePushIU::_note_write_result(revision_t revision)
+{
+	Locker locker(_revision_lock);
+	if (revision > _revision) _revision = revision;
+}
+IPAACA_EXPORT void RemotePushIU::_set_revision(revision_t revision)
 {
+	Locker locker(_revision_lock);
+	_revision = revision;
+}
+IPAACA_EXPORT void RemotePushIU::set_async_writes(bool async_writes)
+{
+	if (!async_writes) wait_for_writes();
+	_async_writes = async_writes;
+}
+IPAACA_EXPORT RevisionFuture RemotePushIU::last_write()
+{
+	Locker locker(_pending_writes_lock);
+	return _last_write;
+}
+IPAACA_EXPORT void RemotePushIU::wait_for_writes()
+{
+	std::deque<PendingWrite> writes;
+	bool failed;
+	{
+		Locker locker(_pending_writes_lock);
+		writes.swap(_pending_writes);
+		failed = _collected_write_failed;
+		_collected_write_failed = false;
+	}
+	for (std::deque<PendingWrite>::iterator it = writes.begin(); it != writes.end(); ++it) {
+		try {
+			it->result.get();
+		} catch (...) {
+			failed = true;
+		}
+	}
+	if (failed) throw IUUpdateFailedError();
 }
 IPAACA_EXPORT void RemotePushIU::_modify_links(bool is_delta, const LinkMap& new_links, const LinkMap& links_to_remove, const std::string& writer_name)
 {
@@ -191,20 +353,21 @@ IPAACA_EXPORT void RemotePushIU::_modify_links(bool is_delta, const LinkMap& new
 	} else if (_read_only) {
 		throw IUReadOnlyError();
 	}
-	RemoteServerPtr server = boost::static_pointer_cast<InputBuffer>(_buffer)->_get_remote_server(_owner_name);
 	IULinkUpdate::ptr update = IULinkUpdate::ptr(new IULinkUpdate());
 	update->uid = _uid;
-	update->revision = _revision;
+	update->revision = _next_write_revision();
 	update->is_delta = is_delta;
 	update->writer_name = _buffer->unique_name();
 	update->new_links = new_links;
 	update->links_to_remove = links_to_remove;
-	boost::shared_ptr<int> result = server->call<int>("updateLinks", update, IPAACA_REMOTE_SERVER_TIMEOUT); // TODO
-	if (*result == 0) {
-		throw IUUpdateFailedError();
+	PendingWrite write = _call_owner<CallbackIULinkUpdate>("updateLinks", update);
+	write.revision = update->revision;
+	if (_async_writes || write.batched) {
+		_track_pending_write(write);
 	} else {
-		_revision = *result;
+		write.result.get();
 	}
+	_apply_links(is_delta, new_links, links_to_remove);
 }
 IPAACA_EXPORT void RemotePushIU::_modify_payload(bool is_delta, const std::map<std::string, PayloadDocumentEntry::ptr>& new_items, const std::vector<std::string>& keys_to_remove, const std::string& writer_name)
 {
@@ -216,24 +379,37 @@ IPAACA_EXPORT void RemotePushIU::_modify_payload(bool is_delta, const std::map<s
 	} else if (_read_only) {
 		throw IUReadOnlyError();
 	}
-	RemoteServerPtr server = boost::static_pointer_cast<InputBuffer>(_buffer)->_get_remote_server(_owner_name);
 	IUPayloadUpdate::ptr update = IUPayloadUpdate::ptr(new IUPayloadUpdate());
 	update->uid = _uid;
-	update->revision = _revision;
+	update->revision = _next_write_revision();
 	update->is_delta = is_delta;
 	update->writer_name = _buffer->unique_name();
 	update->new_items = new_items;
 	update->keys_to_remove = keys_to_remove;
 	update->payload_type = _payload_type;
-	boost::shared_ptr<int> result = server->call<int>("updatePayload", update, IPAACA_REMOTE_SERVER_TIMEOUT); // TODO
-	if (*result == 0) {
-		throw IUUpdateFailedError();
+	update->payload_type_tag = _payload_type_tag;
+	update->binary_encoding = _owner_accepts_binary_payload && (__ipaaca_static_option_binary_payload == "on");
+	update->patch_encoding = _owner_accepts_payload_patches && (__ipaaca_static_option_payload_patches == "on");
+	PendingWrite write = _call_owner<CallbackIUPayloadUpdate>("updatePayload", update);
+	write.revision = update->revision;
+	if (_async_writes || write.batched) {
+		_track_pending_write(write);
 	} else {
-		_revision = *result;
+		write.result.get();
 	}
+	_payload._apply_update(is_delta, new_items, keys_to_remove);
 }
 
 IPAACA_EXPORT void RemotePushIU::commit()
+{
+	PendingWrite write = _send_commission();
+	if (write.result.valid() && !write.batched) write.result.get();
+}
+IPAACA_EXPORT RevisionFuture RemotePushIU::commit_async()
+{
+	return _send_commission().result;
+}
+IPAACA_EXPORT RemotePushIU::PendingWrite RemotePushIU::_send_commission()
 {
 	if (_read_only) {
 		throw IUReadOnlyError();
@@ -242,24 +418,23 @@ IPAACA_EXPORT void RemotePushIU::commit()
 	}
 	if (_committed) {
 		// Following python version: ignoring multiple commit
-		return;
+		return PendingWrite();
 	}
-	RemoteServerPtr server = boost::static_pointer_cast<InputBuffer>(_buffer)->_get_remote_server(_owner_name);
 	boost::shared_ptr<protobuf::IUCommission> update = boost::shared_ptr<protobuf::IUCommission>(new protobuf::IUCommission());
 	update->set_uid(_uid);
-	update->set_revision(_revision);
+	update->set_revision(_next_write_revision());
 	update->set_writer_name(_buffer->unique_name());
-	boost::shared_ptr<int> result = server->call<int>("commit", update, IPAACA_REMOTE_SERVER_TIMEOUT); // TODO
-	if (*result == 0) {
-		throw IUUpdateFailedError();
-	} else {
-		_revision = *result;
+	PendingWrite write = _call_owner<CallbackIUCommission>("commit", update);
+	write.revision = update->revision();
+	if (_async_writes || write.batched) {
+		_track_pending_write(write);
 	}
+	return write;
 }
 
 IPAACA_EXPORT void RemotePushIU::_apply_link_update(IULinkUpdate::ptr update)
 {
-	_revision = update->revision;
+	_set_revision(update->revision);
 	if (update->is_delta) {
 		_add_and_remove_links(update->new_links, update->links_to_remove);
 	} else {
@@ -268,20 +443,24 @@ IPAACA_EXPORT void RemotePushIU::_apply_link_update(IULinkUpdate::ptr update)
 }
 IPAACA_EXPORT void RemotePushIU::_apply_update(IUPayloadUpdate::ptr update)
 {
-	_revision = update->revision;
-	if (update->is_delta) {
-		for (std::vector<std::string>::const_iterator it=update->keys_to_remove.begin(); it!=update->keys_to_remove.end(); ++it) {
-			_payload._remotely_enforced_delitem(*it);
-		}
-		for (std::map<std::string, PayloadDocumentEntry::ptr>::const_iterator it=update->new_items.begin(); it!=update->new_items.end(); ++it) {
-			_payload._remotely_enforced_setitem(it->first, it->second);
-		}
-	} else {
-		_payload._remotely_enforced_wipe();
-		for (std::map<std::string, PayloadDocumentEntry::ptr>::const_iterator it=update->new_items.begin(); it!=update->new_items.end(); ++it) {
-			_payload._remotely_enforced_setitem(it->first, it->second);
-		}
+	_set_revision(update->revision);
+	// patches are resolved against the entries before this update
+	std::map<std::string, PayloadDocumentEntry::ptr> new_items;
+	if (! _payload._resolve_patches(update->new_items, new_items)) {
+		IPAACA_INFO("Payload patch for IU " << _uid << " does not match, requesting the full IU")
+		_resync_pending = true;
 	}
+	_payload._remotely_enforced_update(update->is_delta, new_items, update->keys_to_remove);
+}
+IPAACA_EXPORT void RemotePushIU::_apply_resync(RemotePushIU::ptr fresh)
+{
+	_set_revision(fresh->_revision);
+	_committed = fresh->_committed;
+	_replace_links(fresh->_links.get_all_links());
+	_payload._replace_store(fresh->_payload._snapshot());
+	_owner_accepts_binary_payload = fresh->_owner_accepts_binary_payload;
+	_owner_accepts_payload_patches = fresh->_owner_accepts_payload_patches;
+	_resync_pending = false;
 }
 IPAACA_EXPORT void RemotePushIU::_apply_commission()
 {
@@ -306,10 +485,12 @@ IPAACA_EXPORT RemoteMessage::RemoteMessage()
 }
 IPAACA_EXPORT void RemoteMessage::_modify_links(bool is_delta, const LinkMap& new_links, const LinkMap& links_to_remove, const std::string& writer_name)
 {
+	_apply_links(is_delta, new_links, links_to_remove);
 	IPAACA_INFO("Info: modifying a RemoteMessage only has local effects")
 }
 IPAACA_EXPORT void RemoteMessage::_modify_payload(bool is_delta, const std::map<std::string, PayloadDocumentEntry::ptr>& new_items, const std::vector<std::string>& keys_to_remove, const std::string& writer_name)
 {
+	_payload._apply_update(is_delta, new_items, keys_to_remove);
 	IPAACA_INFO("Info: modifying a RemoteMessage only has local effects")
 }
 IPAACA_EXPORT void RemoteMessage::commit()
@@ -331,19 +512,7 @@ IPAACA_EXPORT void RemoteMessage::_apply_update(IUPayloadUpdate::ptr update)
 {
 	IPAACA_WARNING("Warning: should never be called: RemoteMessage::_apply_update")
 	_revision = update->revision;
-	if (update->is_delta) {
-		for (std::vector<std::string>::const_iterator it=update->keys_to_remove.begin(); it!=update->keys_to_remove.end(); ++it) {
-			_payload._remotely_enforced_delitem(*it);
-		}
-		for (std::map<std::string, PayloadDocumentEntry::ptr>::const_iterator it=update->new_items.begin(); it!=update->new_items.end(); ++it) {
-			_payload._remotely_enforced_setitem(it->first, it->second);
-		}
-	} else {
-		_payload._remotely_enforced_wipe();
-		for (std::map<std::string, PayloadDocumentEntry::ptr>::const_iterator it=update->new_items.begin(); it!=update->new_items.end(); ++it) {
-			_payload._remotely_enforced_setitem(it->first, it->second);
-		}
-	}
+	_payload._remotely_enforced_update(update->is_delta, update->new_items, update->keys_to_remove);
 }
 IPAACA_EXPORT void RemoteMessage::_apply_commission()
 {
@@ -0,0 +1,256 @@
+/*
+ * This file is part of IPAACA, the
+ *  "Incremental Processing Architecture
+ *   for Artificial Conversational Agents".
+ *
+ * Copyright (c) 2009-2015 Social Cognitive Systems Group
+ *                         (formerly the Sociable Agents Group)
+ *                         CITEC, Bielefeld University
+ *
+ * http://opensource.cit-ec.de/projects/ipaaca/
+ * http://purl.org/net/ipaaca
+ *
+ * This file may be licensed under the terms of of the
+ * GNU Lesser General Public License Version 3 (the ``LGPL''),
+ * or (at your option) any later version.
+ *
+ * Software distributed under the License is distributed
+ * on an ``AS IS'' basis, WITHOUT WARRANTY OF ANY KIND, either
+ * express or implied. See the LGPL for the specific language
+ * governing rights and limitations.
+ *
+ * You should have received a copy of the LGPL along with this
+ * program. If not, go to http://www.gnu.org/licenses/lgpl.html
+ * or write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * The development of this software was supported by the
+ * Excellence Cluster EXC 277 Cognitive Interaction Technology.
+ * The Excellence Cluster EXC 277 is a grant of the Deutsche
+ * Forschungsgemeinschaft (DFG) in the context of the German
+ * Excellence Initiative.
+ */
+
+#include <ipaaca/ipaaca.h>
+
+namespace ipaaca {
+
+using namespace rsb;
+
+// LoopbackReceiver//{{{
+IPAACA_EXPORT LoopbackReceiver::LoopbackReceiver(InputBuffer* buffer)
+: _buffer(buffer), _queue(128), _running(false)
+{
+}
+IPAACA_EXPORT LoopbackReceiver::~LoopbackReceiver()
+{
+	LoopbackEvent* evt;
+	while (_queue.pop(evt)) delete evt;
+}
+IPAACA_EXPORT void LoopbackReceiver::start()
+{
+	_running = true;
+	// the thread holds a reference, keeping the receiver alive until it exits
+	_thread = boost::thread(boost::bind(&LoopbackReceiver::_run, shared_from_this()));
+}
+IPAACA_EXPORT void LoopbackReceiver::stop()
+{
+	{
+		boost::lock_guard<boost::mutex> lock(_wakeup_mutex);
+		if (!_running) return;
+		_running = false;
+	}
+	_wakeup.notify_one();
+	if (boost::this_thread::get_id() == _thread.get_id()) {
+		// InputBuffer destroyed from within one of its own handlers
+		_thread.detach();
+	} else {
+		_thread.join();
+	}
+}
+IPAACA_EXPORT void LoopbackReceiver::enqueue(const std::string& type, boost::shared_ptr<void> data)
+{
+	_queue.push(new LoopbackEvent(type, data));
+	{
+		// empty critical section: the receiver is either waiting or will see the new event
+		boost::lock_guard<boost::mutex> lock(_wakeup_mutex);
+	}
+	_wakeup.notify_one();
+}
+IPAACA_EXPORT void LoopbackReceiver::_run()
+{
+	LoopbackEvent* evt;
+	while (true) {
+		while (_queue.pop(evt)) {
+			{
+				boost::lock_guard<boost::mutex> lock(_wakeup_mutex);
+				if (!_running) {
+					delete evt;
+					return;
+				}
+			}
+			EventPtr event(new Event());
+			event->setType(evt->type);
+			event->setData(evt->data);
+			delete evt;
+			try {
+				_buffer->_handle_iu_events(event);
+			} catch (Exception& ex) {
+				IPAACA_ERROR("Exception in handler for in-process event: " << ex.what())
+			}
+		}
+		boost::unique_lock<boost::mutex> lock(_wakeup_mutex);
+		if (!_running) return;
+		if (_queue.empty()) _wakeup.wait(lock);
+	}
+}
+//}}}
+
+// LoopbackHub//{{{
+IPAACA_EXPORT LoopbackHub& LoopbackHub::instance()
+{
+	static LoopbackHub hub;
+	return hub;
+}
+IPAACA_EXPORT bool LoopbackHub::enabled()
+{
+	return (__ipaaca_static_option_loopback == "on") || (__ipaaca_static_option_loopback == "exclusive");
+}
+IPAACA_EXPORT bool LoopbackHub::exclusive()
+{
+	return __ipaaca_static_option_loopback == "exclusive";
+}
+IPAACA_EXPORT void LoopbackHub::subscribe(const std::string& channel, const std::string& category, InputBuffer* buffer)
+{
+	Locker locker(_lock);
+	_subscribers["/ipaaca/channel/" + channel + "/category/" + category].insert(buffer);
+}
+IPAACA_EXPORT void LoopbackHub::unsubscribe_all(InputBuffer* buffer)
+{
+	Locker locker(_lock);
+	for (auto& kv: _subscribers) {
+		kv.second.erase(buffer);
+	}
+}
+IPAACA_EXPORT void LoopbackHub::register_output_buffer(OutputBuffer* buffer)
+{
+	boost::shared_ptr<LocalServer> server(new LocalServer());
+	server->buffer = buffer;
+	server->registered = true;
+	Locker locker(_server_lock);
+	_output_buffers[buffer->unique_name()] = server;
+}
+IPAACA_EXPORT void LoopbackHub::unregister_output_buffer(OutputBuffer* buffer)
+{
+	boost::shared_ptr<LocalServer> server;
+	{
+		Locker locker(_server_lock);
+		auto it = _output_buffers.find(buffer->unique_name());
+		if (it == _output_buffers.end()) return;
+		server = it->second;
+		_output_buffers.erase(it);
+	}
+	// waits for a call in progress
+	Locker locker(server->call_lock);
+	server->registered = false;
+}
+IPAACA_EXPORT void LoopbackHub::register_local_informer(const rsc::misc::UUID& id)
+{
+	Locker locker(_lock);
+	_local_informers.insert(id);
+}
+IPAACA_EXPORT void LoopbackHub::unregister_local_informer(const rsc::misc::UUID& id)
+{
+	Locker locker(_lock);
+	_local_informers.erase(id);
+}
+IPAACA_EXPORT bool LoopbackHub::is_local_informer(const rsc::misc::UUID& id)
+{
+	Locker locker(_lock);
+	return _local_informers.count(id) > 0;
+}
+
+/// Legacy payload types (STR / MAP) are transported as flat strings, emulate that for local receivers
+static PayloadDocumentEntry::ptr _legacy_string_entry(PayloadDocumentEntry::ptr entry)
+{
+	PayloadDocumentEntry::ptr str_entry = std::make_shared<PayloadDocumentEntry>();
+	entry->ensure_parsed();
+	str_entry->document.SetString(json_value_cast<std::string>(entry->document), str_entry->document.GetAllocator());
+	return str_entry;
+}
+
+IPAACA_EXPORT boost::shared_ptr<void> LoopbackHub::_snapshot_iu(IU::ptr iu, std::string& type)
+{
+	IUInterface::ptr obj;
+	Payload* payload;
+	if (iu->access_mode() == IU_ACCESS_MESSAGE) {
+		RemoteMessage::ptr msg = RemoteMessage::create();
+		payload = &(msg->_payload);
+		obj = msg;
+		type = "ipaaca::RemoteMessage";
+	} else {
+		RemotePushIU::ptr push_iu = RemotePushIU::create();
+		payload = &(push_iu->_payload);
+		obj = push_iu;
+		type = "ipaaca::RemotePushIU";
+	}
+	obj->_uid = iu->_uid;
+	obj->_binary_uid = iu->_binary_uid;
+	obj->_revision = iu->_revision;
+	obj->_category = iu->_category;
+	obj->_payload_type = iu->_payload_type;
+	obj->_payload_type_tag = iu->_payload_type_tag;
+	obj->_owner_name = iu->_owner_name;
+	obj->_committed = iu->_committed;
+	obj->_read_only = iu->_read_only;
+	obj->_access_mode = iu->_access_mode;
+	obj->_links._links = iu->_links._links;
+	if (iu->_payload_type_tag == PAYLOAD_TYPE_JSON) {
+		// entries are copy-on-write and published stores immutable, so the receiver can share them
+		payload->_replace_store(iu->_payload._snapshot());
+	} else {
+		auto store = std::make_shared<PayloadDocumentStore>();
+		for (auto& kv: *iu->_payload._snapshot()) {
+			(*store)[kv.first] = _legacy_string_entry(kv.second);
+		}
+		payload->_replace_store(store);
+	}
+	return obj;
+}
+
+IPAACA_EXPORT void LoopbackHub::deliver(const std::string& channel, const std::string& category, const std::string& type, boost::shared_ptr<void> data)
+{
+	static const std::string iu_type = rsc::runtime::typeName<ipaaca::IU>();
+	static const std::string payload_update_type = rsc::runtime::typeName<ipaaca::IUPayloadUpdate>();
+	Locker locker(_lock);
+	std::map<std::string, std::set<InputBuffer*> >::iterator it = _subscribers.find("/ipaaca/channel/" + channel + "/category/" + category);
+	if ((it == _subscribers.end()) || it->second.empty()) return;
+	if (type == iu_type) {
+		// every receiving buffer needs its own remote-side object
+		IU::ptr iu = boost::static_pointer_cast<IU>(data);
+		for (auto buffer: it->second) {
+			std::string snapshot_type;
+			boost::shared_ptr<void> snapshot = _snapshot_iu(iu, snapshot_type);
+			buffer->_loopback_receiver->enqueue(snapshot_type, snapshot);
+		}
+		return;
+	}
+	if (type == payload_update_type) {
+		IUPayloadUpdate::ptr update = boost::static_pointer_cast<IUPayloadUpdate>(data);
+		if (update->payload_type_tag != PAYLOAD_TYPE_JSON) {
+			IUPayloadUpdate::ptr str_update(new IUPayloadUpdate(*update));
+			for (auto& kv: str_update->new_items) {
+				kv.second = _legacy_string_entry(kv.second);
+			}
+			data = str_update;
+		}
+	}
+	// updates, commissions and retractions are only read by the receivers
+	for (auto buffer: it->second) {
+		buffer->_loopback_receiver->enqueue(type, data);
+	}
+}
+//}}}
+
+} // of namespace ipaaca
+
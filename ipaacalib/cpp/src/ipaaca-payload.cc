@@ -70,6 +70,7 @@ IPAACA_EXPORT std::ostream& operator<<(std::ostream& os, const PayloadEntryProxy
 //}}}
 IPAACA_EXPORT std::ostream& operator<<(std::ostream& os, PayloadDocumentEntry::ptr entry)//{{{
 {
+	entry->ensure_parsed();
 	os << json_value_cast<std::string>(entry->document);
 	return os;
 }
@@ -79,7 +80,7 @@ IPAACA_EXPORT std::ostream& operator<<(std::ostream& os, const Payload& obj)//{{
 {
 	os << "{";
 	bool first = true;
-	for (auto& kv: obj._document_store) {
+	for (auto& kv: *obj._snapshot()) {
 		if (first) { first=false; } else { os << ", "; }
 		os << "\"" << kv.first << "\":" << kv.second->to_json_string_representation() << "";
 	}
@@ -197,10 +198,26 @@ IPAACA_EXPORT void pack_into_json_value(rapidjson::Value& valueobject, rapidjson
 // PayloadDocumentEntry//{{{
 IPAACA_EXPORT std::string PayloadDocumentEntry::to_json_string_representation()
 {
-	rapidjson::StringBuffer buffer;
+	std::string out;
+	write_json_string_representation(out);
+	return out;
+}
+IPAACA_EXPORT void PayloadDocumentEntry::write_json_string_representation(std::string& out)
+{
+	if (! is_parsed()) {
+		Locker locker(_parse_lock);
+		if ((! is_parsed()) && (_unparsed_encoding == UNPARSED_JSON)) {
+			out = _unparsed; // pass on as received
+			return;
+		}
+	}
+	ensure_parsed();
+	// per-thread writer buffer, keeps its capacity between calls
+	static thread_local rapidjson::StringBuffer buffer;
+	buffer.Clear();
 	rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
 	document.Accept(writer);
-	return buffer.GetString();
+	out.assign(buffer.GetString(), buffer.GetSize());
 }
 IPAACA_EXPORT PayloadDocumentEntry::ptr PayloadDocumentEntry::from_json_string_representation(const std::string& json_str)
 {
@@ -210,6 +227,22 @@ IPAACA_EXPORT PayloadDocumentEntry::ptr PayloadDocumentEntry::from_json_string_r
 	}
 	return entry;
 }
+IPAACA_EXPORT PayloadDocumentEntry::ptr PayloadDocumentEntry::from_unparsed_json(const std::string& json_str)
+{
+	PayloadDocumentEntry::ptr entry = std::make_shared<ipaaca::PayloadDocumentEntry>();
+	entry->_unparsed = json_str;
+	entry->_unparsed_encoding = UNPARSED_JSON;
+	entry->_parsed.store(false, std::memory_order_release);
+	return entry;
+}
+IPAACA_EXPORT PayloadDocumentEntry::ptr PayloadDocumentEntry::from_unparsed_binary(const std::string& input)
+{
+	PayloadDocumentEntry::ptr entry = std::make_shared<ipaaca::PayloadDocumentEntry>();
+	entry->_unparsed = input;
+	entry->_unparsed_encoding = UNPARSED_BINARY;
+	entry->_parsed.store(false, std::memory_order_release);
+	return entry;
+}
 IPAACA_EXPORT PayloadDocumentEntry::ptr PayloadDocumentEntry::from_unquoted_string_value(const std::string& str)
 {
 	PayloadDocumentEntry::ptr entry = std::make_shared<ipaaca::PayloadDocumentEntry>();
@@ -224,14 +257,364 @@ IPAACA_EXPORT PayloadDocumentEntry::ptr PayloadDocumentEntry::create_null()
 }
 IPAACA_EXPORT PayloadDocumentEntry::ptr PayloadDocumentEntry::clone()
 {
+	ensure_parsed();
 	auto entry = PayloadDocumentEntry::create_null();
 	entry->document.CopyFrom(this->document, entry->document.GetAllocator());
 	IPAACA_DEBUG("PayloadDocumentEntry cloned for copy-on-write, contents: " << entry)
 	return entry;
 }
+IPAACA_EXPORT uint64_t PayloadDocumentEntry::_next_entry_id()
+{
+	// ids are compared across processes writing the same IU: random per-process
+	// seed (from one UUID) through the splitmix64 sequence, which is a
+	// bijection of the counter (no repeats within the process)
+	static const uint64_t seed = IUId(generate_uuid_string()).high;
+	static std::atomic<uint64_t> counter(0);
+	uint64_t z = seed + (++counter) * 0x9e3779b97f4a7c15ULL;
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	z = z ^ (z >> 31);
+	return z ? z : 1; // 0 is reserved for 'unknown'
+}
+IPAACA_EXPORT void PayloadDocumentEntry::_append_json_pointer(std::string& path, PayloadEntryProxy* pep)
+{
+	if (!(pep->parent)) return;
+	_append_json_pointer(path, pep->parent);
+	path += '/';
+	if (pep->addressed_as_array) {
+		path += std::to_string(pep->addressed_index);
+	} else {
+		for (char c: pep->addressed_key) {
+			if (c == '~') path += "~0";
+			else if (c == '/') path += "~1";
+			else path += c;
+		}
+	}
+}
+IPAACA_EXPORT void PayloadDocumentEntry::record_patch_operation(PayloadEntryProxy* pep, const rapidjson::Value& value, bool append)
+{
+	if (__ipaaca_static_option_payload_patches != "on") return;
+	std::string path;
+	_append_json_pointer(path, pep);
+	if (append) path += "/-";
+	record_patch_operation(pep->document_entry.get(), path, value, append);
+}
+IPAACA_EXPORT void PayloadDocumentEntry::record_patch_operation(const PayloadDocumentEntry* source, const std::string& path, const rapidjson::Value& value, bool append)
+{
+	if (__ipaaca_static_option_payload_patches != "on") return;
+	uint64_t base = source->entry_id;
+	if (source == this) {
+		// modified in place (batch update): extend the changes against the original base
+		if (! patch) return;
+		base = patch->base_entry_id;
+	}
+	if (base == 0) return; // receivers could not tell which state the change refers to
+	if (! patch) {
+		patch = std::make_shared<PayloadEntryPatch>(base);
+	} else if (patch->base_entry_id != base) {
+		return;
+	}
+	rapidjson::Document::AllocatorType& allocator = patch->operations.GetAllocator();
+	rapidjson::Value op(rapidjson::kObjectType);
+	rapidjson::Value str;
+	str.SetString(append ? "add" : "replace", allocator);
+	op.AddMember("op", str, allocator);
+	str.SetString(path, allocator);
+	op.AddMember("path", str, allocator);
+	rapidjson::Value val;
+	val.CopyFrom(value, allocator);
+	op.AddMember("value", val, allocator);
+	patch->operations.PushBack(op, allocator);
+}
+IPAACA_EXPORT PayloadDocumentEntry::ptr PayloadDocumentEntry::from_unresolved_patch(const std::string& operations_json, uint64_t base_entry_id, uint64_t entry_id)
+{
+	PayloadDocumentEntry::ptr entry = std::make_shared<ipaaca::PayloadDocumentEntry>();
+	entry->patch = std::make_shared<PayloadEntryPatch>(base_entry_id);
+	if (entry->patch->operations.Parse(operations_json.c_str()).HasParseError() || (! entry->patch->operations.IsArray())) {
+		throw JsonParsingError();
+	}
+	entry->entry_id = entry_id;
+	entry->_unresolved_patch = true;
+	return entry;
+}
+IPAACA_EXPORT PayloadDocumentEntry::ptr PayloadDocumentEntry::resolve_patch(PayloadDocumentEntry::ptr base)
+{
+	if (base->entry_id != patch->base_entry_id) {
+		throw PayloadPatchError("base entry mismatch");
+	}
+	PayloadDocumentEntry::ptr entry = base->clone();
+	patch->apply_to(entry->document);
+	entry->entry_id = entry_id;
+	entry->patch = patch; // passed on as-is when the owner distributes the change
+	return entry;
+}
+
+// Binary encoding: one tag byte per value, lengths and integers as
+// base-128 varints (integers zigzag-encoded), doubles as 8 bytes (IEEE 754,
+// little endian). Arrays consisting only of doubles are packed.
+#define IPAACA_BIN_FORMAT_VERSION 1
+#define IPAACA_BIN_NULL   0
+#define IPAACA_BIN_FALSE  1
+#define IPAACA_BIN_TRUE   2
+#define IPAACA_BIN_INT    3
+#define IPAACA_BIN_UINT   4
+#define IPAACA_BIN_DOUBLE 5
+#define IPAACA_BIN_STRING 6
+#define IPAACA_BIN_ARRAY  7
+#define IPAACA_BIN_OBJECT 8
+#define IPAACA_BIN_DOUBLE_ARRAY 9
+
+static inline void _bin_put_varint(std::string& out, uint64_t v)
+{
+	while (v >= 0x80) {
+		out.push_back((char) ((v & 0x7f) | 0x80));
+		v >>= 7;
+	}
+	out.push_back((char) v);
+}
+static inline void _bin_put_double(std::string& out, double d)
+{
+	uint64_t bits;
+	memcpy(&bits, &d, sizeof(double));
+	for (int i=0; i<8; ++i) {
+		out.push_back((char) ((bits >> (8*i)) & 0xff));
+	}
+}
+static inline void _bin_put_string(std::string& out, const char* s, size_t len)
+{
+	_bin_put_varint(out, len);
+	out.append(s, len);
+}
+static void _bin_encode_value(std::string& out, const rapidjson::Value& v)
+{
+	if (v.IsNull()) {
+		out.push_back(IPAACA_BIN_NULL);
+	} else if (v.IsFalse()) {
+		out.push_back(IPAACA_BIN_FALSE);
+	} else if (v.IsTrue()) {
+		out.push_back(IPAACA_BIN_TRUE);
+	} else if (v.IsDouble()) {
+		out.push_back(IPAACA_BIN_DOUBLE);
+		_bin_put_double(out, v.GetDouble());
+	} else if (v.IsInt64()) {
+		int64_t i = v.GetInt64();
+		out.push_back(IPAACA_BIN_INT);
+		_bin_put_varint(out, (((uint64_t) i) << 1) ^ (uint64_t) (i >> 63));
+	} else if (v.IsUint64()) {
+		out.push_back(IPAACA_BIN_UINT);
+		_bin_put_varint(out, v.GetUint64());
+	} else if (v.IsString()) {
+		out.push_back(IPAACA_BIN_STRING);
+		_bin_put_string(out, v.GetString(), v.GetStringLength());
+	} else if (v.IsArray()) {
+		bool all_doubles = (v.Size() > 0);
+		for (rapidjson::Value::ConstValueIterator it = v.Begin(); all_doubles && (it != v.End()); ++it) {
+			all_doubles = it->IsDouble();
+		}
+		if (all_doubles) {
+			out.push_back(IPAACA_BIN_DOUBLE_ARRAY);
+			_bin_put_varint(out, v.Size());
+			out.reserve(out.size() + 8*v.Size());
+			for (rapidjson::Value::ConstValueIterator it = v.Begin(); it != v.End(); ++it) {
+				_bin_put_double(out, it->GetDouble());
+			}
+		} else {
+			out.push_back(IPAACA_BIN_ARRAY);
+			_bin_put_varint(out, v.Size());
+			for (rapidjson::Value::ConstValueIterator it = v.Begin(); it != v.End(); ++it) {
+				_bin_encode_value(out, *it);
+			}
+		}
+	} else if (v.IsObject()) {
+		out.push_back(IPAACA_BIN_OBJECT);
+		_bin_put_varint(out, v.MemberCount());
+		for (rapidjson::Value::ConstMemberIterator it = v.MemberBegin(); it != v.MemberEnd(); ++it) {
+			_bin_put_string(out, it->name.GetString(), it->name.GetStringLength());
+			_bin_encode_value(out, it->value);
+		}
+	} else {
+		throw BinaryPayloadError();
+	}
+}
+/// Cursor over binary input, throwing on truncated data
+class BinaryPayloadReader {//{{{
+	protected:
+		const char* _pos;
+		const char* _end;
+	public:
+		BinaryPayloadReader(const std::string& input): _pos(input.data()), _end(input.data() + input.size()) { }
+		inline bool at_end() const { return _pos == _end; }
+		inline unsigned char byte() {
+			if (_pos >= _end) throw BinaryPayloadError();
+			return (unsigned char) *(_pos++);
+		}
+		inline uint64_t varint() {
+			uint64_t v = 0;
+			for (int shift = 0; shift < 64; shift += 7) {
+				unsigned char b = byte();
+				v |= ((uint64_t) (b & 0x7f)) << shift;
+				if (!(b & 0x80)) return v;
+			}
+			throw BinaryPayloadError();
+		}
+		inline double dbl() {
+			if (_end - _pos < 8) throw BinaryPayloadError();
+			uint64_t bits = 0;
+			for (int i=0; i<8; ++i) {
+				bits |= ((uint64_t) (unsigned char) _pos[i]) << (8*i);
+			}
+			_pos += 8;
+			double d;
+			memcpy(&d, &bits, sizeof(double));
+			return d;
+		}
+		inline const char* chars(uint64_t len) {
+			if ((uint64_t) (_end - _pos) < len) throw BinaryPayloadError();
+			const char* s = _pos;
+			_pos += len;
+			return s;
+		}
+		/// element count, checked against the remaining input (at least min_bytes_each per element)
+		inline rapidjson::SizeType count(size_t min_bytes_each) {
+			uint64_t n = varint();
+			if (n * min_bytes_each > (uint64_t) (_end - _pos)) throw BinaryPayloadError();
+			return (rapidjson::SizeType) n;
+		}
+};//}}}
+static void _bin_decode_value(BinaryPayloadReader& in, rapidjson::Value& v, rapidjson::Document::AllocatorType& allocator, int depth)
+{
+	if (depth > 512) throw BinaryPayloadError(); // nesting too deep
+	switch (in.byte()) {
+		case IPAACA_BIN_NULL:
+			v.SetNull();
+			break;
+		case IPAACA_BIN_FALSE:
+			v.SetBool(false);
+			break;
+		case IPAACA_BIN_TRUE:
+			v.SetBool(true);
+			break;
+		case IPAACA_BIN_INT:
+			{
+			uint64_t z = in.varint();
+			v.SetInt64((int64_t) ((z >> 1) ^ (~(z & 1) + 1)));
+			}
+			break;
+		case IPAACA_BIN_UINT:
+			v.SetUint64(in.varint());
+			break;
+		case IPAACA_BIN_DOUBLE:
+			v.SetDouble(in.dbl());
+			break;
+		case IPAACA_BIN_STRING:
+			{
+			uint64_t len = in.varint();
+			const char* s = in.chars(len);
+			v.SetString(s, (rapidjson::SizeType) len, allocator);
+			}
+			break;
+		case IPAACA_BIN_DOUBLE_ARRAY:
+			{
+			rapidjson::SizeType n = in.count(8);
+			v.SetArray();
+			v.Reserve(n, allocator);
+			for (rapidjson::SizeType i=0; i<n; ++i) {
+				rapidjson::Value element(in.dbl());
+				v.PushBack(element, allocator);
+			}
+			}
+			break;
+		case IPAACA_BIN_ARRAY:
+			{
+			rapidjson::SizeType n = in.count(1);
+			v.SetArray();
+			v.Reserve(n, allocator);
+			for (rapidjson::SizeType i=0; i<n; ++i) {
+				rapidjson::Value element;
+				_bin_decode_value(in, element, allocator, depth+1);
+				v.PushBack(element, allocator);
+			}
+			}
+			break;
+		case IPAACA_BIN_OBJECT:
+			{
+			rapidjson::SizeType n = in.count(2);
+			v.SetObject();
+			for (rapidjson::SizeType i=0; i<n; ++i) {
+				uint64_t len = in.varint();
+				const char* s = in.chars(len);
+				rapidjson::Value name(s, (rapidjson::SizeType) len, allocator);
+				rapidjson::Value element;
+				_bin_decode_value(in, element, allocator, depth+1);
+				v.AddMember(name, element, allocator);
+			}
+			}
+			break;
+		default:
+			throw BinaryPayloadError();
+	}
+}
+static void _bin_decode_document(const std::string& input, rapidjson::Document& document)
+{
+	BinaryPayloadReader in(input);
+	if (in.byte() != IPAACA_BIN_FORMAT_VERSION) throw BinaryPayloadError();
+	_bin_decode_value(in, document, document.GetAllocator(), 0);
+	if (!in.at_end()) throw BinaryPayloadError();
+}
+IPAACA_EXPORT std::string PayloadDocumentEntry::to_binary_representation()
+{
+	std::string out;
+	write_binary_representation(out);
+	return out;
+}
+IPAACA_EXPORT void PayloadDocumentEntry::write_binary_representation(std::string& out)
+{
+	if (! is_parsed()) {
+		Locker locker(_parse_lock);
+		if ((! is_parsed()) && (_unparsed_encoding == UNPARSED_BINARY)) {
+			out = _unparsed; // pass on as received
+			return;
+		}
+	}
+	ensure_parsed();
+	out.clear();
+	out.push_back(IPAACA_BIN_FORMAT_VERSION);
+	_bin_encode_value(out, document);
+}
+IPAACA_EXPORT PayloadDocumentEntry::ptr PayloadDocumentEntry::from_binary_representation(const std::string& input)
+{
+	PayloadDocumentEntry::ptr entry = std::make_shared<ipaaca::PayloadDocumentEntry>();
+	_bin_decode_document(input, entry->document);
+	return entry;
+}
+IPAACA_EXPORT size_t PayloadDocumentEntry::estimated_size()
+{
+	if (! is_parsed()) {
+		Locker locker(_parse_lock);
+		if (! is_parsed()) return sizeof(PayloadDocumentEntry) + _unparsed.capacity();
+	}
+	return sizeof(PayloadDocumentEntry) + document.GetAllocator().Size();
+}
+IPAACA_EXPORT void PayloadDocumentEntry::_parse()
+{
+	Locker locker(_parse_lock);
+	if (is_parsed()) return; // another thread was faster
+	if (_unparsed_encoding == UNPARSED_JSON) {
+		if (document.Parse(_unparsed.c_str()).HasParseError()) {
+			throw JsonParsingError();
+		}
+	} else if (_unparsed_encoding == UNPARSED_BINARY) {
+		_bin_decode_document(_unparsed, document);
+	}
+	std::string().swap(_unparsed);
+	_unparsed_encoding = UNPARSED_NONE;
+	_parsed.store(true, std::memory_order_release);
+}
+
 IPAACA_EXPORT rapidjson::Value& PayloadDocumentEntry::get_or_create_nested_value_from_proxy_path(PayloadEntryProxy* pep)
 {
 	if (!(pep->parent)) {
+		ensure_parsed();
 		return document;
 	}
 	rapidjson::Value& parent_value = get_or_create_nested_value_from_proxy_path(pep->parent);
@@ -273,6 +656,194 @@ IPAACA_EXPORT rapidjson::Value& PayloadDocumentEntry::get_or_create_nested_value
 }
 //}}}
 
+// PayloadEntryPatch//{{{
+IPAACA_EXPORT void PayloadEntryPatch::write_operations(std::string& out) const
+{
+	static thread_local rapidjson::StringBuffer buffer;
+	buffer.Clear();
+	rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+	operations.Accept(writer);
+	out.assign(buffer.GetString(), buffer.GetSize());
+}
+IPAACA_EXPORT void PayloadEntryPatch::apply_to(rapidjson::Document& document) const
+{
+	rapidjson::Document::AllocatorType& allocator = document.GetAllocator();
+	for (rapidjson::SizeType i = 0; i < operations.Size(); ++i) {
+		const rapidjson::Value& op = operations[i];
+		if ((! op.IsObject()) || (! op.HasMember("op")) || (! op.HasMember("path")) || (! op.HasMember("value"))
+				|| (! op["op"].IsString()) || (! op["path"].IsString())) {
+			throw PayloadPatchError("malformed operation");
+		}
+		std::string opname = op["op"].GetString();
+		if ((opname != "replace") && (opname != "add")) {
+			throw PayloadPatchError("unsupported operation " + opname);
+		}
+		// split the JSON pointer into unescaped reference tokens
+		std::vector<std::string> tokens;
+		std::string path = op["path"].GetString();
+		if ((! path.empty()) && (path[0] != '/')) {
+			throw PayloadPatchError("invalid path " + path);
+		}
+		for (size_t pos = 0; pos < path.size(); ) {
+			size_t next = path.find('/', pos+1);
+			if (next == std::string::npos) next = path.size();
+			std::string token;
+			for (size_t j = pos+1; j < next; ++j) {
+				if ((path[j] == '~') && (j+1 < next) && ((path[j+1] == '0') || (path[j+1] == '1'))) {
+					token += (path[j+1] == '0') ? '~' : '/';
+					++j;
+				} else {
+					token += path[j];
+				}
+			}
+			tokens.push_back(token);
+			pos = next;
+		}
+		rapidjson::Value newval;
+		newval.CopyFrom(op["value"], allocator);
+		if (tokens.empty()) {
+			document.CopyFrom(newval, allocator); // whole document
+			continue;
+		}
+		rapidjson::Value* current = &document;
+		for (size_t t = 0; t+1 < tokens.size(); ++t) {
+			if (current->IsObject()) {
+				auto it = current->FindMember(tokens[t].c_str());
+				if (it == current->MemberEnd()) throw PayloadPatchError("no member " + tokens[t]);
+				current = &(it->value);
+			} else if (current->IsArray()) {
+				char* end;
+				unsigned long idx = strtoul(tokens[t].c_str(), &end, 10);
+				if (tokens[t].empty() || (*end != '\0') || (idx >= current->Size())) throw PayloadPatchError("no index " + tokens[t]);
+				current = &((*current)[(rapidjson::SizeType) idx]);
+			} else {
+				throw PayloadPatchError("cannot descend into scalar at " + tokens[t]);
+			}
+		}
+		const std::string& last = tokens.back();
+		if (current->IsObject()) {
+			auto it = current->FindMember(last.c_str());
+			if (it != current->MemberEnd()) {
+				it->value = newval;
+			} else {
+				rapidjson::Value key;
+				key.SetString(last, allocator);
+				current->AddMember(key, newval, allocator);
+			}
+		} else if (current->IsArray()) {
+			if ((opname == "add") && (last == "-")) {
+				current->PushBack(newval, allocator);
+			} else if (opname == "add") {
+				throw PayloadPatchError("list insertion not supported");
+			} else {
+				char* end;
+				unsigned long idx = strtoul(last.c_str(), &end, 10);
+				if (last.empty() || (*end != '\0') || (idx >= current->Size())) throw PayloadPatchError("no index " + last);
+				(*current)[(rapidjson::SizeType) idx] = newval;
+			}
+		} else {
+			throw PayloadPatchError("cannot write into scalar at " + last);
+		}
+	}
+}
+//}}}
+
+// PayloadPath//{{{
+IPAACA_EXPORT PayloadPath::PayloadPath(const std::string& pointer)
+{
+	if (pointer.empty() || (pointer[0] != '/')) {
+		IPAACA_WARNING("Payload path must start with '/': " << pointer)
+		throw PayloadAddressingError();
+	}
+	bool first = true;
+	for (size_t pos = 0; pos < pointer.size(); ) {
+		size_t next = pointer.find('/', pos+1);
+		if (next == std::string::npos) next = pointer.size();
+		std::string token;
+		for (size_t j = pos+1; j < next; ++j) {
+			if ((pointer[j] == '~') && (j+1 < next) && ((pointer[j+1] == '0') || (pointer[j+1] == '1'))) {
+				token += (pointer[j+1] == '0') ? '~' : '/';
+				++j;
+			} else {
+				token += pointer[j];
+			}
+		}
+		if (first) {
+			_key = token;
+			first = false;
+		} else {
+			Step step;
+			step.name = token;
+			step.append = (token == "-");
+			step.index = -1;
+			if ((! token.empty()) && (token.find_first_not_of("0123456789") == std::string::npos)) {
+				step.index = strtol(token.c_str(), nullptr, 10);
+			}
+			_steps.push_back(step);
+			_entry_pointer.append(pointer, pos, next-pos); // still escaped
+		}
+		pos = next;
+	}
+}
+IPAACA_EXPORT rapidjson::Value* PayloadPath::_step(rapidjson::Value& value, const Step& step)
+{
+	if (value.IsObject()) {
+		// name refers to the token, no copy
+		auto it = value.FindMember(rapidjson::Value(rapidjson::StringRef(step.name.data(), step.name.size())));
+		if (it == value.MemberEnd()) return nullptr;
+		return &(it->value);
+	} else if (value.IsArray()) {
+		if ((step.index < 0) || (step.index >= (long) value.Size())) return nullptr;
+		return &(value[(rapidjson::SizeType) step.index]);
+	}
+	return nullptr;
+}
+IPAACA_EXPORT const rapidjson::Value* PayloadPath::find(const rapidjson::Value& root) const
+{
+	rapidjson::Value* current = const_cast<rapidjson::Value*>(&root); // only read
+	for (auto& step: _steps) {
+		current = _step(*current, step);
+		if (! current) return nullptr;
+	}
+	return current;
+}
+IPAACA_EXPORT rapidjson::Value& PayloadPath::place(rapidjson::Document& document, rapidjson::Value& value) const
+{
+	rapidjson::Document::AllocatorType& allocator = document.GetAllocator();
+	if (_steps.empty()) {
+		static_cast<rapidjson::Value&>(document) = value;
+		return document;
+	}
+	rapidjson::Value* current = &document;
+	for (size_t i = 0; i+1 < _steps.size(); ++i) {
+		// like in proxy writes, containers above the written value must exist
+		current = _step(*current, _steps[i]);
+		if (! current) throw PayloadAddressingError();
+	}
+	const Step& last = _steps.back();
+	if (current->IsObject()) {
+		auto it = current->FindMember(rapidjson::Value(rapidjson::StringRef(last.name.data(), last.name.size())));
+		if (it != current->MemberEnd()) {
+			it->value = value;
+			return it->value;
+		}
+		rapidjson::Value key;
+		key.SetString(last.name, allocator);
+		current->AddMember(key, value, allocator);
+		return *_step(*current, last);
+	} else if (current->IsArray()) {
+		if (last.append) {
+			current->PushBack(value, allocator);
+			return (*current)[current->Size()-1];
+		}
+		if ((last.index < 0) || (last.index >= (long) current->Size())) throw PayloadAddressingError();
+		(*current)[(rapidjson::SizeType) last.index] = value;
+		return (*current)[(rapidjson::SizeType) last.index];
+	}
+	throw PayloadAddressingError();
+}
+//}}}
+
 // PayloadEntryProxy//{{{
 
 IPAACA_EXPORT PayloadEntryProxy::PayloadEntryProxy(Payload* payload, const std::string& key)
@@ -306,6 +877,15 @@ IPAACA_EXPORT PayloadEntryProxy::PayloadEntryProxy(PayloadEntryProxy* parent_, s
 	existent = true;
 }
 
+IPAACA_EXPORT long PayloadEntryProxy::_entry_refs() const
+{
+	long refs = 0;
+	for (const PayloadEntryProxy* proxy = this; proxy; proxy = proxy->parent) {
+		if (proxy->document_entry == document_entry) refs++;
+	}
+	return refs;
+}
+
 IPAACA_EXPORT PayloadEntryProxy PayloadEntryProxy::operator[](const char* addr_key_)
 {
 	return operator[](std::string(addr_key_));
@@ -350,13 +930,14 @@ IPAACA_EXPORT PayloadEntryProxy PayloadEntryProxy::operator[](int addr_idx_)
 
 IPAACA_EXPORT PayloadEntryProxy& PayloadEntryProxy::operator=(const PayloadEntryProxy& otherproxy)
 {
-	PayloadDocumentEntry::ptr new_entry = document_entry->clone(); // copy-on-write, no lock required
+	// values read from the entry being modified must not move underneath: always copy then
+	PayloadDocumentEntry::ptr new_entry = (otherproxy.document_entry == document_entry) ? document_entry->clone() : _payload->_writable_entry(_key, document_entry, _entry_refs());
 	rapidjson::Value& newval = new_entry->get_or_create_nested_value_from_proxy_path(this);
 	auto valueptr = otherproxy.json_value;
 	if (valueptr) { // only set if value is valid, keep default null value otherwise
 		newval.CopyFrom(*valueptr, new_entry->document.GetAllocator());
 	}
-	_payload->set(_key, new_entry);
+	_payload->_set_written_entry(_key, new_entry);
 	return *this;
 }
 
@@ -458,8 +1039,11 @@ IPAACA_EXPORT void Payload::on_unlock()
 {
 	Locker locker(_payload_operation_mode_lock);
 	IPAACA_DEBUG("... applying payload batch update with " << _collected_modifications.size() << " modifications and " << _collected_removals.size() << " removals ...")
-	_internal_merge_and_remove(_collected_modifications, _collected_removals, _batch_update_writer_name);
+	for (auto& kv: _collected_modifications) {
+		if (kv.second->batch_owned) kv.second->batch_owned = false; // shared from now on
+	}
 	_update_on_every_change = true;
+	_internal_merge_and_remove(_collected_modifications, _collected_removals, _batch_update_writer_name);
 	_batch_update_writer_name = "";
 	_collected_modifications.clear();
 	_collected_removals.clear();
@@ -480,7 +1064,9 @@ IPAACA_EXPORT PayloadEntryProxy Payload::operator[](const std::string& key)
 IPAACA_EXPORT Payload::operator std::map<std::string, std::string>()
 {
 	std::map<std::string, std::string> result;
-	std::for_each(_document_store.begin(), _document_store.end(), [&result](std::pair<std::string, PayloadDocumentEntry::ptr> pair) {
+	auto store = _snapshot();
+	std::for_each(store->begin(), store->end(), [&result](std::pair<std::string, PayloadDocumentEntry::ptr> pair) {
+			pair.second->ensure_parsed();
 			result[pair.first] =  json_value_cast<std::string>(pair.second->document);
 			});
 	return result;
@@ -492,14 +1078,12 @@ IPAACA_EXPORT void Payload::_internal_set(const std::string& k, PayloadDocumentE
 		std::map<std::string, PayloadDocumentEntry::ptr> _new;
 		std::vector<std::string> _remove;
 		_new[k] = v;
-		_iu.lock()->_modify_payload(true, _new, _remove, writer_name );
 		IPAACA_DEBUG(" Setting local payload item \"" << k << "\" to " << v)
-		_document_store[k] = v;
-		mark_revision_change();
+		_iu.lock()->_modify_payload(true, _new, _remove, writer_name );
 	} else {
 		IPAACA_DEBUG("queueing a payload set operation")
 		_batch_update_writer_name = writer_name;
-		_collected_modifications[k] = v;
+		_collect_modification(k, v);
 		// revoke deletions of this updated key
 		//_collected_removals.erase(k);
 		std::vector<std::string> new_removals;
@@ -516,8 +1100,6 @@ IPAACA_EXPORT void Payload::_internal_remove(const std::string& k, const std::st
 		std::vector<std::string> _remove;
 		_remove.push_back(k);
 		_iu.lock()->_modify_payload(true, _new, _remove, writer_name );
-		_document_store.erase(k);
-		mark_revision_change();
 	} else {
 		IPAACA_DEBUG("queueing a payload remove operation")
 		_batch_update_writer_name = writer_name;
@@ -527,23 +1109,57 @@ IPAACA_EXPORT void Payload::_internal_remove(const std::string& k, const std::st
 		_collected_modifications.erase(k);
 	}
 }
+/// whether replacing an entry by another one would change the value
+static bool _entries_equal(PayloadDocumentEntry::ptr a, PayloadDocumentEntry::ptr b)
+{
+	if (a == b) return true;
+	a->ensure_parsed();
+	b->ensure_parsed();
+	return a->document == b->document;
+}
 IPAACA_EXPORT void Payload::_internal_replace_all(const std::map<std::string, PayloadDocumentEntry::ptr>& new_contents, const std::string& writer_name)
 {
 	Locker locker(_payload_operation_mode_lock);
+	auto current = _snapshot();
 	if (_update_on_every_change) {
-		std::vector<std::string> _remove;
-		_iu.lock()->_modify_payload(false, new_contents, _remove, writer_name );
-		_document_store = new_contents;
-		mark_revision_change();
+		// send only the difference to the current contents, if that is smaller
+		std::map<std::string, PayloadDocumentEntry::ptr> changed;
+		std::vector<std::string> removed;
+		for (auto& kv: new_contents) {
+			auto it = current->find(kv.first);
+			if ((it == current->end()) || !_entries_equal(it->second, kv.second)) {
+				changed[kv.first] = kv.second;
+			}
+		}
+		for (auto& kv: *current) {
+			if (! new_contents.count(kv.first)) removed.push_back(kv.first);
+		}
+		if (changed.size() + removed.size() < new_contents.size()) {
+			IPAACA_DEBUG("Sending replace_all as delta: " << changed.size() << " changed, " << removed.size() << " removed")
+			// unchanged keys keep their current entries (and entry ids)
+			_iu.lock()->_modify_payload(true, changed, removed, writer_name );
+		} else {
+			std::vector<std::string> _remove;
+			_iu.lock()->_modify_payload(false, new_contents, _remove, writer_name );
+		}
 	} else {
 		IPAACA_DEBUG("queueing a payload replace_all operation")
 		_batch_update_writer_name = writer_name;
 		_collected_modifications.clear();
 		for (auto& kv: new_contents) {
-			_collected_modifications[kv.first] = kv.second;
+			// the batch is sent as a delta anyway: leave out keys that keep their value
+			auto it = current->find(kv.first);
+			if ((it != current->end()) && _entries_equal(it->second, kv.second)) continue;
+			_collect_modification(kv.first, kv.second);
+		}
+		// revoke earlier deletions of keys that are present again
+		std::vector<std::string> new_removals;
+		for (auto& rk: _collected_removals) {
+			if (! new_contents.count(rk)) new_removals.push_back(rk);
 		}
+		_collected_removals = new_removals;
 		// take all existing keys and flag to remove them, unless overridden in current update
-		for (auto& kv: _document_store) {
+		for (auto& kv: *current) {
 			if (! new_contents.count(kv.first)) {
 				_collected_removals.push_back(kv.first);
 				//_collected_removals.insert(kv.first);
@@ -558,16 +1174,12 @@ IPAACA_EXPORT void Payload::_internal_merge(const std::map<std::string, PayloadD
 	if (_update_on_every_change) {
 		std::vector<std::string> _remove;
 		_iu.lock()->_modify_payload(true, contents_to_merge, _remove, writer_name );
-		for (auto& kv: contents_to_merge) {
-			_document_store[kv.first] = kv.second;
-		}
-		mark_revision_change();
 	} else {
 		IPAACA_DEBUG("queueing a payload merge operation")
 		std::set<std::string> updated_keys;
 		_batch_update_writer_name = writer_name;
 		for (auto& kv: contents_to_merge) {
-			_collected_modifications[kv.first] = kv.second;
+			_collect_modification(kv.first, kv.second);
 			//_collected_removals.erase(kv.first); // moved here
 			updated_keys.insert(kv.first);
 		}
@@ -581,15 +1193,105 @@ IPAACA_EXPORT void Payload::_internal_merge(const std::map<std::string, PayloadD
 }
 IPAACA_EXPORT void Payload::_internal_merge_and_remove(const std::map<std::string, PayloadDocumentEntry::ptr>& contents_to_merge, const std::vector<std::string>& keys_to_remove, const std::string& writer_name)
 {
-	// this function is called by exiting the batch update mode only, so no extra locking here
-	_iu.lock()->_modify_payload(true, contents_to_merge, keys_to_remove, writer_name );
-	for (auto& k: keys_to_remove) {
-		_document_store.erase(k);
+	Locker locker(_payload_operation_mode_lock);
+	if (_update_on_every_change) {
+		_iu.lock()->_modify_payload(true, contents_to_merge, keys_to_remove, writer_name );
+	} else {
+		IPAACA_DEBUG("queueing a payload merge and remove operation")
+		for (auto& k: keys_to_remove) {
+			_internal_remove(k, writer_name);
+		}
+		_internal_merge(contents_to_merge, writer_name);
 	}
-	for (auto& kv: contents_to_merge) {
-		_document_store[kv.first] = kv.second;
+}
+IPAACA_EXPORT bool Payload::has(const PayloadPath& path)
+{
+	PayloadDocumentEntry::ptr entry = get_entry(path.key());
+	const rapidjson::Value* value = path.find(entry->document);
+	return value && !value->IsNull();
+}
+IPAACA_EXPORT PayloadDocumentEntry::ptr Payload::_writable_entry(const std::string& k, const PayloadDocumentEntry::ptr& current, long writer_refs)
+{
+	if (current->batch_owned) {
+		Locker locker(_payload_operation_mode_lock);
+		if (! _update_on_every_change) {
+			std::stringstream ss;
+			ss << boost::this_thread::get_id();
+			auto it = _collected_modifications.find(k);
+			// further references (child proxies, proxy copies) point into the json tree, which must not move underneath them
+			if ((_writing_thread_id == ss.str()) && (it != _collected_modifications.end()) && (it->second == current) && (current.use_count() <= writer_refs + 1)) {
+				return current;
+			}
+		}
 	}
-	mark_revision_change();
+	return current->clone(); // copy-on-write, no lock required
+}
+IPAACA_EXPORT void Payload::_set_written_entry(const std::string& k, PayloadDocumentEntry::ptr entry)
+{
+	Locker locker(_payload_operation_mode_lock);
+	// the entry is a fresh copy (or already batch_owned) - nobody else can see it before the batch ends
+	if (! _update_on_every_change) entry->batch_owned = true;
+	_internal_set(k, entry);
+}
+IPAACA_EXPORT void Payload::_collect_modification(const std::string& k, PayloadDocumentEntry::ptr v)
+{
+	if (v->patch) {
+		// receivers only know the state before the batch
+		auto it = _collected_modifications.find(k);
+		if ((it != _collected_modifications.end()) && (it->second->entry_id == v->patch->base_entry_id)) {
+			if (it->second->patch) {
+				auto combined = std::make_shared<PayloadEntryPatch>(it->second->patch->base_entry_id);
+				rapidjson::Document::AllocatorType& allocator = combined->operations.GetAllocator();
+				for (auto patch: {it->second->patch, v->patch}) {
+					for (rapidjson::SizeType i = 0; i < patch->operations.Size(); ++i) {
+						rapidjson::Value op;
+						op.CopyFrom(patch->operations[i], allocator);
+						combined->operations.PushBack(op, allocator);
+					}
+				}
+				v->patch = combined;
+			} else {
+				v->patch.reset(); // predecessor would have been sent whole
+			}
+		} else {
+			auto store = _snapshot();
+			auto st = store->find(k);
+			if ((st == store->end()) || (st->second->entry_id != v->patch->base_entry_id)) {
+				v->patch.reset();
+			}
+		}
+	}
+	_collected_modifications[k] = v;
+}
+IPAACA_EXPORT bool Payload::_resolve_patches(const std::map<std::string, PayloadDocumentEntry::ptr>& items, std::map<std::string, PayloadDocumentEntry::ptr>& resolved)
+{
+	bool complete = true;
+	auto store = _snapshot();
+	for (auto& kv: items) {
+		if (! kv.second->is_unresolved_patch()) {
+			resolved[kv.first] = kv.second;
+			continue;
+		}
+		auto it = store->find(kv.first);
+		if (it != store->end()) {
+			if (it->second->entry_id == kv.second->entry_id) {
+				// already in the target state
+				resolved[kv.first] = it->second;
+				continue;
+			}
+			if (it->second->entry_id == kv.second->patch->base_entry_id) {
+				try {
+					resolved[kv.first] = kv.second->resolve_patch(it->second);
+					continue;
+				} catch (Exception& ex) {
+					IPAACA_WARNING("Could not apply payload patch for key " << kv.first << ": " << ex.what())
+				}
+			}
+		}
+		IPAACA_DEBUG("Payload patch for key " << kv.first << " does not match the current entry")
+		complete = false;
+	}
+	return complete;
 }
 IPAACA_EXPORT PayloadDocumentEntry::ptr Payload::get_entry(const std::string& k) {
 	if (! _update_on_every_change) {
@@ -610,16 +1312,22 @@ IPAACA_EXPORT PayloadDocumentEntry::ptr Payload::get_entry(const std::string& k)
 			auto it = _collected_modifications.find(k);
 			if (it!=_collected_modifications.end()) {
 				IPAACA_DEBUG("Key updated, returning current version")
+				it->second->ensure_parsed();
 				return it->second;
 			}
 			// case 3: key not in the caches yet, just continue below
 		}
 	}
-	if (_document_store.count(k)>0) return _document_store[k];
+	auto store = _snapshot();
+	auto it = store->find(k);
+	if (it != store->end()) {
+		it->second->ensure_parsed(); // received entries are parsed on first access
+		return it->second;
+	}
 	else return PayloadDocumentEntry::create_null();  // contains Document with 'null' value
 }
 IPAACA_EXPORT std::string Payload::get(const std::string& k) { // DEPRECATED
-	if (_document_store.count(k)>0) return _document_store[k]->document.GetString();
+	if (_snapshot()->count(k)>0) return get_entry(k)->document.GetString();
 	return "";
 }
 
@@ -632,71 +1340,141 @@ IPAACA_EXPORT void Payload::set(const std::map<std::string, std::string>& all_el
 	_internal_replace_all(newmap);
 }
 
-IPAACA_EXPORT void Payload::_remotely_enforced_wipe()
+IPAACA_EXPORT void Payload::_replace_store(PayloadDocumentStore::const_ptr store)
 {
-	_document_store.clear();
+	Locker locker(_store_write_lock);
+	std::atomic_store(&_document_store, store);
 	mark_revision_change();
 }
+IPAACA_EXPORT size_t Payload::estimated_size() const
+{
+	size_t bytes = 0;
+	for (auto& kv: *_snapshot()) {
+		bytes += kv.first.size() + kv.second->estimated_size();
+	}
+	return bytes;
+}
+
+IPAACA_EXPORT void Payload::_remotely_enforced_wipe()
+{
+	_replace_store(std::make_shared<PayloadDocumentStore>());
+}
 IPAACA_EXPORT void Payload::_remotely_enforced_delitem(const std::string& k)
 {
-	_document_store.erase(k);
-	mark_revision_change();
+	_update_store([&](PayloadDocumentStore& store) { store.erase(k); });
 }
 IPAACA_EXPORT void Payload::_remotely_enforced_setitem(const std::string& k, PayloadDocumentEntry::ptr entry)
 {
-	_document_store[k] = entry;
-	mark_revision_change();
+	_update_store([&](PayloadDocumentStore& store) { store[k] = entry; });
+}
+IPAACA_EXPORT void Payload::_apply_update(bool is_delta, const std::map<std::string, PayloadDocumentEntry::ptr>& new_items, const std::vector<std::string>& keys_to_remove)
+{
+	if (! is_delta) {
+		_replace_store(std::make_shared<PayloadDocumentStore>(new_items));
+		return;
+	}
+	_update_store([&](PayloadDocumentStore& store) {
+		for (auto& k: keys_to_remove) {
+			store.erase(k);
+		}
+		for (auto& kv: new_items) {
+			store[kv.first] = kv.second;
+		}
+	});
 }
 IPAACA_EXPORT PayloadIterator Payload::begin()
 {
-	return PayloadIterator(this, _document_store.begin());
+	return PayloadIterator(this, false);
 }
 IPAACA_EXPORT PayloadIterator Payload::end()
 {
-	return PayloadIterator(this, _document_store.end());
+	return PayloadIterator(this, true);
+}
+IPAACA_EXPORT PayloadView Payload::view()
+{
+	return PayloadView(_snapshot());
 }
 
 //}}}
 
 // PayloadIterator//{{{
-IPAACA_EXPORT PayloadIterator::PayloadIterator(Payload* payload, PayloadDocumentStore::iterator&& ref_it)
-: _payload(payload), reference_payload_revision(payload->internal_revision), raw_iterator(std::move(ref_it))
+IPAACA_EXPORT PayloadIterator::PayloadIterator(Payload* payload, bool is_end)
+: _payload(payload)
 {
+	if (! is_end) {
+		// iterate over the entries as of now, concurrent writes publish new versions
+		_store = payload->_snapshot();
+		raw_iterator = _store->begin();
+	}
 }
 IPAACA_EXPORT PayloadIterator::PayloadIterator(const PayloadIterator& iter)
-: _payload(iter._payload), reference_payload_revision(iter.reference_payload_revision), raw_iterator(iter.raw_iterator)
+: _payload(iter._payload), _store(iter._store), raw_iterator(iter.raw_iterator)
 {
 }
 
 IPAACA_EXPORT PayloadIterator& PayloadIterator::operator++()
 {
-	if (_payload->revision_changed(reference_payload_revision)) throw PayloadIteratorInvalidError();
+	if (_at_end()) throw PayloadIteratorInvalidError();
 	++raw_iterator;
 	return *this;
 }
 
 IPAACA_EXPORT std::pair<std::string, PayloadEntryProxy> PayloadIterator::operator*()
 {
-	if (_payload->revision_changed(reference_payload_revision)) throw PayloadIteratorInvalidError();
-	if (raw_iterator == _payload->_document_store.end()) throw PayloadIteratorInvalidError();
+	if (_at_end()) throw PayloadIteratorInvalidError();
 	return std::pair<std::string, PayloadEntryProxy>(raw_iterator->first, PayloadEntryProxy(_payload, raw_iterator->first));
 }
 IPAACA_EXPORT std::shared_ptr<std::pair<std::string, PayloadEntryProxy> > PayloadIterator::operator->()
 {
-	if (_payload->revision_changed(reference_payload_revision)) throw PayloadIteratorInvalidError();
-	if (raw_iterator == _payload->_document_store.end()) throw PayloadIteratorInvalidError();
+	if (_at_end()) throw PayloadIteratorInvalidError();
 	return std::make_shared<std::pair<std::string, PayloadEntryProxy> >(raw_iterator->first, PayloadEntryProxy(_payload, raw_iterator->first));
 }
 
 IPAACA_EXPORT bool PayloadIterator::operator==(const PayloadIterator& ref)
 {
-	if (_payload->revision_changed(reference_payload_revision)) throw PayloadIteratorInvalidError();
-	return (raw_iterator==ref.raw_iterator);
+	if (_at_end() || ref._at_end()) return _at_end() && ref._at_end();
+	return (_store==ref._store) && (raw_iterator==ref.raw_iterator);
 }
 IPAACA_EXPORT bool PayloadIterator::operator!=(const PayloadIterator& ref)
 {
-	if (_payload->revision_changed(reference_payload_revision)) throw PayloadIteratorInvalidError();
-	return (raw_iterator!=ref.raw_iterator);
+	return !(*this == ref);
+}
+//}}}
+
+// PayloadView, PayloadValueView//{{{
+IPAACA_EXPORT PayloadValueView PayloadView::operator[](const std::string& key) const
+{
+	auto it = _store->find(key);
+	if (it == _store->end()) return PayloadValueView();
+	return PayloadItemView(&*it).value();
+}
+IPAACA_EXPORT size_t PayloadValueView::size() const
+{
+	if (is_list()) return _value->Size();
+	if (is_map()) return _value->MemberCount();
+	return 0;
+}
+IPAACA_EXPORT PayloadValueView PayloadValueView::operator[](size_t index) const
+{
+	if ((! is_list()) || (index >= _value->Size())) return PayloadValueView();
+	return PayloadValueView(&((*_value)[(rapidjson::SizeType) index]));
+}
+IPAACA_EXPORT PayloadValueView PayloadValueView::operator[](const char* key) const
+{
+	if (! is_map()) return PayloadValueView();
+	auto it = _value->FindMember(key);
+	if (it == _value->MemberEnd()) return PayloadValueView();
+	return PayloadValueView(&(it->value));
+}
+IPAACA_EXPORT PayloadViewRange<PayloadValueView::element_iterator> PayloadValueView::elements() const
+{
+	if (! is_list()) return PayloadViewRange<element_iterator>(element_iterator(nullptr), element_iterator(nullptr));
+	return PayloadViewRange<element_iterator>(element_iterator(_value->Begin()), element_iterator(_value->End()));
+}
+IPAACA_EXPORT PayloadViewRange<PayloadValueView::member_iterator> PayloadValueView::members() const
+{
+	if (! is_map()) return PayloadViewRange<member_iterator>(member_iterator(rapidjson::Value::ConstMemberIterator()), member_iterator(rapidjson::Value::ConstMemberIterator()));
+	return PayloadViewRange<member_iterator>(member_iterator(_value->MemberBegin()), member_iterator(_value->MemberEnd()));
 }
 //}}}
 
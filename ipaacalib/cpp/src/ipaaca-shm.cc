@@ -0,0 +1,406 @@
+/*
+ * This file is part of IPAACA, the
+ *  "Incremental Processing Architecture
+ *   for Artificial Conversational Agents".
+ *
+ * Copyright (c) 2009-2015 Social Cognitive Systems Group
+ *                         (formerly the Sociable Agents Group)
+ *                         CITEC, Bielefeld University
+ *
+ * http://opensource.cit-ec.de/projects/ipaaca/
+ * http://purl.org/net/ipaaca
+ *
+ * This file may be licensed under the terms of of the
+ * GNU Lesser General Public License Version 3 (the ``LGPL''),
+ * or (at your option) any later version.
+ *
+ * Software distributed under the License is distributed
+ * on an ``AS IS'' basis, WITHOUT WARRANTY OF ANY KIND, either
+ * express or implied. See the LGPL for the specific language
+ * governing rights and limitations.
+ *
+ * You should have received a copy of the LGPL along with this
+ * program. If not, go to http://www.gnu.org/licenses/lgpl.html
+ * or write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * The development of this software was supported by the
+ * Excellence Cluster EXC 277 Cognitive Interaction Technology.
+ * The Excellence Cluster EXC 277 is a grant of the Deutsche
+ * Forschungsgemeinschaft (DFG) in the context of the German
+ * Excellence Initiative.
+ */
+
+#include <ipaaca/ipaaca.h>
+
+#if _WIN32 || _WIN64
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <pthread.h>
+#endif
+
+namespace ipaaca {
+
+using namespace rsb;
+using namespace rsb::converter;
+
+#define IPAACA_SHM_MAGIC 0x49504131u // "IPA1"
+#define IPAACA_SHM_WRAP_MARKER 0xffffffffu
+
+#if _WIN32 || _WIN64
+struct ShmRingHeader { };
+// ShmRing (unsupported on Windows)//{{{
+IPAACA_EXPORT ShmRing::ShmRing(const std::string& name, uint64_t capacity, bool create)
+: _name(name), _header(NULL), _data(NULL), _mapped_size(0)
+{
+	throw ShmTransportError("shared memory transport is not available on Windows");
+}
+IPAACA_EXPORT ShmRing::~ShmRing() { }
+IPAACA_EXPORT void ShmRing::write(const std::string& record) { }
+IPAACA_EXPORT uint64_t ShmRing::head() { return 0; }
+IPAACA_EXPORT bool ShmRing::read(uint64_t& read_pos, std::string& record, long timeout_ms) { return false; }
+//}}}
+#else
+struct ShmRingHeader {
+	volatile uint32_t magic; // set last by the creating process
+	uint32_t reserved;
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	uint64_t capacity;
+	uint64_t head; // total number of bytes ever written (absolute position)
+};
+
+/// Lock the process-shared mutex, recovering it if its owner died
+static void _shm_lock(ShmRingHeader* header)
+{
+	int res = pthread_mutex_lock(&header->mutex);
+	if (res == EOWNERDEAD) {
+		IPAACA_WARNING("Recovering shared memory ring lock from a terminated process")
+		pthread_mutex_consistent(&header->mutex);
+	} else if (res != 0) {
+		throw ShmTransportError("cannot lock ring mutex");
+	}
+}
+
+// ShmRing//{{{
+IPAACA_EXPORT ShmRing::ShmRing(const std::string& name, uint64_t capacity, bool create)
+: _name(name), _header(NULL), _data(NULL), _mapped_size(0)
+{
+	bool creator = create;
+	int fd = create ? shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, IPAACA_SHM_SEGMENT_MODE) : -1;
+	if (fd < 0) {
+		if (create && (errno != EEXIST)) throw ShmTransportError("shm_open failed for " + name + ": " + strerror(errno));
+		creator = false;
+		fd = shm_open(name.c_str(), O_RDWR, IPAACA_SHM_SEGMENT_MODE);
+		if (fd < 0) throw ShmTransportError("shm_open failed for " + name + ": " + strerror(errno));
+	}
+	if (creator) {
+		_mapped_size = sizeof(ShmRingHeader) + capacity;
+		if (ftruncate(fd, _mapped_size) != 0) {
+			close(fd);
+			shm_unlink(name.c_str());
+			throw ShmTransportError("cannot size segment " + name);
+		}
+	} else {
+		// the creating process may still be setting the segment up
+		struct stat st;
+		for (int i=0; i<1000; ++i) {
+			if ((fstat(fd, &st) == 0) && ((size_t) st.st_size > sizeof(ShmRingHeader))) break;
+			usleep(1000);
+		}
+		_mapped_size = st.st_size;
+		if (_mapped_size <= sizeof(ShmRingHeader)) {
+			close(fd);
+			throw ShmTransportError("segment " + name + " was never initialized");
+		}
+	}
+	void* addr = mmap(NULL, _mapped_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (addr == MAP_FAILED) throw ShmTransportError("mmap failed for " + name);
+	_header = static_cast<ShmRingHeader*>(addr);
+	_data = static_cast<char*>(addr) + sizeof(ShmRingHeader);
+	if (creator) {
+		pthread_mutexattr_t mattr;
+		pthread_mutexattr_init(&mattr);
+		pthread_mutexattr_setpshared(&mattr, PTHREAD_PROCESS_SHARED);
+		pthread_mutexattr_setrobust(&mattr, PTHREAD_MUTEX_ROBUST);
+		pthread_mutex_init(&_header->mutex, &mattr);
+		pthread_mutexattr_destroy(&mattr);
+		pthread_condattr_t cattr;
+		pthread_condattr_init(&cattr);
+		pthread_condattr_setpshared(&cattr, PTHREAD_PROCESS_SHARED);
+		pthread_condattr_setclock(&cattr, CLOCK_MONOTONIC);
+		pthread_cond_init(&_header->cond, &cattr);
+		pthread_condattr_destroy(&cattr);
+		_header->capacity = capacity;
+		_header->head = 0;
+		__atomic_store_n(&_header->magic, IPAACA_SHM_MAGIC, __ATOMIC_RELEASE);
+	} else {
+		for (int i=0; i<1000; ++i) {
+			if (__atomic_load_n(&_header->magic, __ATOMIC_ACQUIRE) == IPAACA_SHM_MAGIC) break;
+			usleep(1000);
+		}
+		if ((__atomic_load_n(&_header->magic, __ATOMIC_ACQUIRE) != IPAACA_SHM_MAGIC)
+				|| (sizeof(ShmRingHeader) + _header->capacity > _mapped_size)) {
+			munmap(addr, _mapped_size);
+			throw ShmTransportError("segment " + name + " has an incompatible layout");
+		}
+	}
+	IPAACA_INFO("Mapped shared memory ring " << name << " (" << _header->capacity << " bytes)")
+}
+IPAACA_EXPORT ShmRing::~ShmRing()
+{
+	// the segment itself is kept for the other processes on the host
+	if (_header) munmap(_header, _mapped_size);
+}
+IPAACA_EXPORT uint64_t ShmRing::head()
+{
+	_shm_lock(_header);
+	uint64_t head = _header->head;
+	pthread_mutex_unlock(&_header->mutex);
+	return head;
+}
+IPAACA_EXPORT void ShmRing::write(const std::string& record)
+{
+	const uint64_t capacity = _header->capacity;
+	const uint32_t len = record.size();
+	if (record.size() + 2*sizeof(uint32_t) > capacity / 2) {
+		IPAACA_ERROR("Dropping event of " << record.size() << " bytes, too large for shared memory ring " << _name)
+		return;
+	}
+	_shm_lock(_header);
+	uint64_t head = _header->head;
+	uint64_t offset = head % capacity;
+	// records are never split: pad the tail of the ring and continue at the start
+	if (capacity - offset < sizeof(uint32_t) + len) {
+		if (capacity - offset >= sizeof(uint32_t)) {
+			const uint32_t marker = IPAACA_SHM_WRAP_MARKER;
+			memcpy(_data + offset, &marker, sizeof(uint32_t));
+		}
+		head += capacity - offset;
+		offset = 0;
+	}
+	memcpy(_data + offset, &len, sizeof(uint32_t));
+	memcpy(_data + offset + sizeof(uint32_t), record.data(), len);
+	head += sizeof(uint32_t) + len;
+	// keep records 4-aligned
+	head = (head + 3) & ~((uint64_t) 3);
+	_header->head = head;
+	pthread_cond_broadcast(&_header->cond);
+	pthread_mutex_unlock(&_header->mutex);
+}
+IPAACA_EXPORT bool ShmRing::read(uint64_t& read_pos, std::string& record, long timeout_ms)
+{
+	const uint64_t capacity = _header->capacity;
+	_shm_lock(_header);
+	if (read_pos == _header->head) {
+		struct timespec deadline;
+		clock_gettime(CLOCK_MONOTONIC, &deadline);
+		deadline.tv_sec += timeout_ms / 1000;
+		deadline.tv_nsec += (timeout_ms % 1000) * 1000000L;
+		if (deadline.tv_nsec >= 1000000000L) {
+			deadline.tv_sec += 1;
+			deadline.tv_nsec -= 1000000000L;
+		}
+		while (read_pos == _header->head) {
+			int res = pthread_cond_timedwait(&_header->cond, &_header->mutex, &deadline);
+			if (res == EOWNERDEAD) {
+				pthread_mutex_consistent(&_header->mutex);
+			} else if (res == ETIMEDOUT) {
+				break;
+			}
+		}
+		if (read_pos == _header->head) {
+			pthread_mutex_unlock(&_header->mutex);
+			return false;
+		}
+	}
+	if (_header->head - read_pos > capacity) {
+		IPAACA_WARNING("Reader of shared memory ring " << _name << " fell behind, lost " << (_header->head - read_pos - capacity) << "+ bytes of events")
+		read_pos = _header->head;
+		pthread_mutex_unlock(&_header->mutex);
+		return false;
+	}
+	uint64_t offset = read_pos % capacity;
+	uint32_t len = IPAACA_SHM_WRAP_MARKER;
+	if (capacity - offset >= sizeof(uint32_t)) {
+		memcpy(&len, _data + offset, sizeof(uint32_t));
+	}
+	if (len == IPAACA_SHM_WRAP_MARKER) {
+		read_pos += capacity - offset;
+		offset = 0;
+		memcpy(&len, _data, sizeof(uint32_t));
+	}
+	record.assign(_data + offset + sizeof(uint32_t), len);
+	read_pos += sizeof(uint32_t) + len;
+	read_pos = (read_pos + 3) & ~((uint64_t) 3);
+	pthread_mutex_unlock(&_header->mutex);
+	return true;
+}
+//}}}
+#endif
+
+// ShmReader//{{{
+IPAACA_EXPORT ShmReader::ShmReader(InputBuffer* buffer, ShmRing::ptr ring)
+: _buffer(buffer), _ring(ring), _running(false)
+{
+	// only events published from now on are received (as with RSB listeners)
+	_read_pos = _ring->head();
+}
+IPAACA_EXPORT void ShmReader::start()
+{
+	_running = true;
+	_thread = boost::thread(boost::bind(&ShmReader::_run, shared_from_this()));
+}
+IPAACA_EXPORT void ShmReader::stop()
+{
+	if (!_running) return;
+	_running = false;
+	if (boost::this_thread::get_id() == _thread.get_id()) {
+		_thread.detach();
+	} else {
+		_thread.join();
+	}
+}
+IPAACA_EXPORT void ShmReader::_run()
+{
+	std::string record;
+	while (_running) {
+		// wake up periodically to notice stop()
+		if (!_ring->read(_read_pos, record, 200)) continue;
+		if (!_running) return;
+		try {
+			EventPtr event = ShmTransport::instance().decode(record);
+			if (event) _buffer->_handle_iu_events(event);
+		} catch (std::exception& ex) {
+			IPAACA_ERROR("Exception while handling event from shared memory: " << ex.what())
+		}
+	}
+}
+//}}}
+
+// ShmTransport//{{{
+IPAACA_EXPORT ShmTransport::ShmTransport()
+{
+	_process_token = generate_uuid_string();
+}
+IPAACA_EXPORT ShmTransport& ShmTransport::instance()
+{
+	static ShmTransport transport;
+	return transport;
+}
+IPAACA_EXPORT bool ShmTransport::enabled()
+{
+#if _WIN32 || _WIN64
+	return false;
+#else
+	return __ipaaca_static_option_rsb_transport == "shm";
+#endif
+}
+IPAACA_EXPORT std::string ShmTransport::_segment_name(const std::string& scope)
+{
+	// POSIX shm names: one leading slash, no others; a hash of the raw scope keeps sanitized names unique
+	uint32_t hash = 2166136261u;
+	std::string name = "/ipaaca-";
+	for (char c: scope.substr(16)) {
+		hash = (hash ^ (unsigned char) c) * 16777619u;
+		if (name.size() < 200) name += (isalnum(c) || (c=='-') || (c=='_') || (c=='.')) ? c : '_';
+	}
+	std::stringstream ss;
+	ss << name << "-" << std::hex << hash;
+	return ss.str();
+}
+IPAACA_EXPORT ShmRing::ptr ShmTransport::ring(const std::string& channel, const std::string& category)
+{
+	std::string scope = "/ipaaca/channel/" + channel + "/category/" + category;
+	Locker locker(_lock);
+	std::map<std::string, ShmRing::ptr>::iterator it = _rings.find(scope);
+	if (it != _rings.end()) return it->second;
+	ShmRing::ptr ring = ShmRing::ptr(new ShmRing(_segment_name(scope), IPAACA_SHM_RING_CAPACITY));
+	_rings[scope] = ring;
+	return ring;
+}
+IPAACA_EXPORT void ShmTransport::unlink_ring(const std::string& channel, const std::string& category)
+{
+	std::string scope = "/ipaaca/channel/" + channel + "/category/" + category;
+	Locker locker(_lock);
+	_rings.erase(scope); // (still mapped by its last users)
+#if !(_WIN32 || _WIN64)
+	shm_unlink(_segment_name(scope).c_str());
+#endif
+}
+/// record layout: [u16 len][process token][u16 len][wire schema][serialized data]
+static void _append_string_field(std::string& record, const std::string& s)
+{
+	uint16_t len = s.size();
+	record.append(reinterpret_cast<const char*>(&len), sizeof(uint16_t));
+	record.append(s);
+}
+static bool _consume_string_field(const std::string& record, size_t& pos, std::string& s)
+{
+	uint16_t len;
+	if (pos + sizeof(uint16_t) > record.size()) return false;
+	memcpy(&len, record.data() + pos, sizeof(uint16_t));
+	pos += sizeof(uint16_t);
+	if (pos + len > record.size()) return false;
+	s.assign(record, pos, len);
+	pos += len;
+	return true;
+}
+IPAACA_EXPORT void ShmTransport::publish(const std::string& channel, const std::string& category, const std::string& type, VoidPtr data, bool private_scope)
+{
+	std::string wire, wire_schema;
+	if (!ConverterRegistry::instance().serialize(type, data, wire_schema, wire)) {
+		IPAACA_ERROR("No converter for event type " << type << " - not sent via shared memory")
+		return;
+	}
+	std::string record;
+	record.reserve(wire.size() + _process_token.size() + wire_schema.size() + 2*sizeof(uint16_t));
+	_append_string_field(record, _process_token);
+	_append_string_field(record, wire_schema);
+	record.append(wire);
+	if (! private_scope) {
+		ring(channel, category)->write(record);
+		return;
+	}
+	// the ring of a single InputBuffer: do not keep it mapped, and never recreate it after its owner removed it
+	ShmRing::ptr private_ring;
+	try {
+		private_ring = ShmRing::ptr(new ShmRing(_segment_name("/ipaaca/channel/" + channel + "/category/" + category), IPAACA_SHM_RING_CAPACITY, false));
+	} catch (ShmTransportError& ex) {
+		IPAACA_WARNING("Not sending " << type << " to " << category << ", its receiver is gone: " << ex.what())
+		return;
+	}
+	private_ring->write(record);
+}
+IPAACA_EXPORT EventPtr ShmTransport::decode(const std::string& record)
+{
+	size_t pos = 0;
+	std::string token, wire_schema;
+	if (!(_consume_string_field(record, pos, token) && _consume_string_field(record, pos, wire_schema))) {
+		IPAACA_ERROR("Malformed record in shared memory ring")
+		return EventPtr();
+	}
+	if ((token == _process_token) && LoopbackHub::enabled()) {
+		// already delivered in-process
+		return EventPtr();
+	}
+	AnnotatedData annotated;
+	if (!ConverterRegistry::instance().deserialize(wire_schema, record.substr(pos), annotated)) {
+		IPAACA_WARNING("No converter for wire schema " << wire_schema << " - event ignored")
+		return EventPtr();
+	}
+	EventPtr event(new Event());
+	event->setType(annotated.first);
+	event->setData(annotated.second);
+	return event;
+}
+//}}}
+
+} // of namespace ipaaca
+
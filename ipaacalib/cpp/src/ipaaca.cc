@@ -72,6 +72,134 @@ IPAACA_EXPORT std::string generate_uuid_string()//{{{
 #endif
 }//}}}
 
+// IUId//{{{
+/// lowercase only: to_string() must give back the exact UID string, so other spellings are hashed
+static inline int _hex_digit_value(char c)
+{
+	if ((c >= '0') && (c <= '9')) return c - '0';
+	if ((c >= 'a') && (c <= 'f')) return c - 'a' + 10;
+	return -1;
+}
+IPAACA_EXPORT bool IUId::parse(const std::string& uid, IUId& result)
+{
+	if (uid.size() != 36) return false;
+	uint64_t words[2] = {0, 0};
+	int nibbles = 0;
+	for (size_t i = 0; i < 36; ++i) {
+		if ((i == 8) || (i == 13) || (i == 18) || (i == 23)) {
+			if (uid[i] != '-') return false;
+			continue;
+		}
+		int v = _hex_digit_value(uid[i]);
+		if (v < 0) return false;
+		words[nibbles / 16] = (words[nibbles / 16] << 4) | (uint64_t) v;
+		nibbles++;
+	}
+	result.high = words[0];
+	result.low = words[1];
+	return true;
+}
+IPAACA_EXPORT IUId::IUId(const std::string& uid)
+: high(0), low(0)
+{
+	if (! parse(uid, *this)) {
+		// two independent 64-bit FNV-1a digests (different offset bases)
+		uint64_t h1 = 14695981039346656037ULL;
+		uint64_t h2 = 0x6c62272e07bb0142ULL;
+		for (unsigned char c: uid) {
+			h1 = (h1 ^ c) * 1099511628211ULL;
+			h2 = (h2 ^ c) * 1099511628211ULL;
+			h2 ^= (h2 >> 29);
+		}
+		high = h1;
+		low = h2;
+	}
+}
+IPAACA_EXPORT std::string IUId::to_string() const
+{
+	static const char* digits = "0123456789abcdef";
+	std::string result(36, '-');
+	int nibble = 0;
+	for (size_t i = 0; i < 36; ++i) {
+		if ((i == 8) || (i == 13) || (i == 18) || (i == 23)) continue;
+		uint64_t word = (nibble < 16) ? high : low;
+		result[i] = digits[(word >> (60 - 4 * (nibble % 16))) & 0xf];
+		nibble++;
+	}
+	return result;
+}
+IPAACA_EXPORT std::string generate_iu_uid(IUId& binary_uid)
+{
+	if (__ipaaca_static_option_uid_mode == "counter") {
+		// random per-process prefix (from one UUID), plus a process-wide counter
+		static const uint64_t prefix = IUId(generate_uuid_string()).high;
+		static std::atomic<uint64_t> counter(0);
+		binary_uid = IUId(prefix, ++counter);
+		return binary_uid.to_string();
+	}
+	std::string uid = generate_uuid_string();
+	binary_uid = IUId(uid);
+	return uid;
+}
+//}}}
+// InternedString//{{{
+typedef std::unordered_map<std::string, std::weak_ptr<const std::string> > InternTable;
+// never destroyed: handles may still be released during static destruction
+static InternTable& _intern_table()
+{
+	static InternTable* table = new InternTable();
+	return *table;
+}
+static boost::shared_mutex& _intern_table_mutex()
+{
+	static boost::shared_mutex* table_mutex = new boost::shared_mutex();
+	return *table_mutex;
+}
+/// Deleter of interned strings: removes the table entry along with the last handle
+static void _release_interned(const std::string* str)
+{
+	{
+		boost::unique_lock<boost::shared_mutex> lock(_intern_table_mutex());
+		auto it = _intern_table().find(*str);
+		// the string may have been interned anew after this instance expired
+		if ((it != _intern_table().end()) && it->second.expired()) {
+			_intern_table().erase(it);
+		}
+	}
+	delete str;
+}
+IPAACA_EXPORT std::shared_ptr<const std::string> InternedString::_intern(const std::string& str)
+{
+	if (str.empty()) return std::shared_ptr<const std::string>();
+	{
+		boost::shared_lock<boost::shared_mutex> lock(_intern_table_mutex());
+		auto it = _intern_table().find(str);
+		if (it != _intern_table().end()) {
+			std::shared_ptr<const std::string> interned = it->second.lock();
+			if (interned) return interned;
+		}
+	}
+	boost::unique_lock<boost::shared_mutex> lock(_intern_table_mutex());
+	std::weak_ptr<const std::string>& entry = _intern_table()[str];
+	std::shared_ptr<const std::string> interned = entry.lock();
+	if (! interned) {
+		interned = std::shared_ptr<const std::string>(new std::string(str), &_release_interned);
+		entry = interned;
+	}
+	return interned;
+}
+IPAACA_EXPORT size_t InternedString::table_size()
+{
+	boost::shared_lock<boost::shared_mutex> lock(_intern_table_mutex());
+	return _intern_table().size();
+}
+IPAACA_EXPORT const std::string& InternedString::_empty()
+{
+	static const std::string empty;
+	return empty;
+}
+//}}}
+
 IPAACA_EXPORT std::string __ipaaca_static_option_default_payload_type("JSON");
 IPAACA_EXPORT std::string __ipaaca_static_option_default_channel("default");
 IPAACA_EXPORT unsigned int __ipaaca_static_option_log_level(IPAACA_LOG_LEVEL_WARNING);
@@ -80,6 +208,10 @@ IPAACA_EXPORT std::string __ipaaca_static_option_rsb_host("");
 IPAACA_EXPORT std::string __ipaaca_static_option_rsb_port("");
 IPAACA_EXPORT std::string __ipaaca_static_option_rsb_transport("");
 IPAACA_EXPORT std::string __ipaaca_static_option_rsb_socketserver("");
+IPAACA_EXPORT std::string __ipaaca_static_option_loopback("off");
+IPAACA_EXPORT std::string __ipaaca_static_option_binary_payload("off");
+IPAACA_EXPORT std::string __ipaaca_static_option_uid_mode("uuid");
+IPAACA_EXPORT std::string __ipaaca_static_option_payload_patches("off");
 
 } // of namespace ipaaca
 
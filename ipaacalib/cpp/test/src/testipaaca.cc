@@ -32,12 +32,71 @@
 
 #include <ipaaca/ipaaca.h>
 #include <typeinfo>
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #define BOOST_TEST_MODULE TestIpaacaCpp
 #include <boost/test/unit_test.hpp>
 
 using namespace ipaaca;
 
+/// Set a static option for the lifetime of the object (restored even if a check throws)
+class ScopedOption {
+	public:
+		ScopedOption(std::string& option, const std::string& value): _option(option), _saved(option) { _option = value; }
+		~ScopedOption() { _option = _saved; }
+	protected:
+		std::string& _option;
+		std::string _saved;
+};
+
+/// Poll until condition() holds (true) or timeout_ms has elapsed (false)
+template<class F> bool wait_until(F condition, long timeout_ms=5000)
+{
+	boost::system_time deadline = boost::get_system_time() + boost::posix_time::milliseconds(timeout_ms);
+	while (! condition()) {
+		if (boost::get_system_time() >= deadline) return false;
+		boost::this_thread::sleep(boost::posix_time::milliseconds(5));
+	}
+	return true;
+}
+
+/// Records the payload value "n" at every IU event of a buffer, in handling order
+class EventRecorder {
+	public:
+		void handle(IUInterface::ptr iu, IUEventType event_type, bool local)
+		{
+			boost::mutex::scoped_lock lock(_mutex);
+			_values.push_back((long) iu->payload()["n"]);
+		}
+		std::vector<long> values()
+		{
+			boost::mutex::scoped_lock lock(_mutex);
+			return _values;
+		}
+	protected:
+		boost::mutex _mutex;
+		std::vector<long> _values;
+};
+
+/// Shared memory segments whose names start with prefix, with their access modes (Linux)
+std::map<std::string, mode_t> shm_segments(const std::string& prefix)
+{
+	std::map<std::string, mode_t> segments;
+	DIR* dir = opendir("/dev/shm");
+	if (! dir) return segments;
+	while (struct dirent* entry = readdir(dir)) {
+		std::string name(entry->d_name);
+		struct stat st;
+		if ((name.compare(0, prefix.size(), prefix) == 0) && (stat(("/dev/shm/" + name).c_str(), &st) == 0)) {
+			segments[name] = st.st_mode & 0777;
+		}
+	}
+	closedir(dir);
+	return segments;
+}
+
 class TestReceiver {
 	public:
 		InputBuffer::ptr  _ib;
@@ -118,5 +177,566 @@ BOOST_AUTO_TEST_CASE( testIpaacaCpp01 )
 	std::cout << "Complete." << std::endl;
 }
 
+BOOST_AUTO_TEST_CASE( testIpaacaCppLoopback )
+{
+	ScopedOption loopback(ipaaca::__ipaaca_static_option_loopback, "on");
+	TestSender sender;
+	TestReceiver receiver;
+	std::cout << "Publishing one message in-process and waiting for replies." << std::endl;
+	sender.publish_one_message();
+	BOOST_REQUIRE( wait_until([&]() { return sender.num_replies == 1; }) );
+	BOOST_CHECK( receiver.received_info == "OK" );
+	BOOST_CHECK( sender.comment == "OK" );
+	BOOST_CHECK( sender.double_vec.size() == 3 );
+}
+
+BOOST_AUTO_TEST_CASE( testIpaacaCppShmTransport )
+{
+	ScopedOption transport(ipaaca::__ipaaca_static_option_rsb_transport, "shm");
+	const std::string channel = "cppShm" + ipaaca::generate_uuid_string().substr(0, 8);
+	{
+		ipaaca::InputBuffer::ptr ib = ipaaca::InputBuffer::create(ipaaca::BufferConfiguration("ShmReceiver").set_channel(channel).add_category_interest("cppShmCategory"));
+		ipaaca::InputBuffer::ptr ib2 = ipaaca::InputBuffer::create(ipaaca::BufferConfiguration("ShmReceiver2").set_channel(channel).add_category_interest("cppShmCategory"));
+		ipaaca::OutputBuffer::ptr ob = ipaaca::OutputBuffer::create(ipaaca::BufferConfiguration("ShmSender").set_channel(channel));
+		ipaaca::IU::ptr iu = ipaaca::IU::create("cppShmCategory");
+		iu->payload()["word"] = "shm";
+		ob->add(iu);
+		BOOST_CHECK( wait_until([&]() { return (bool) ib->get(iu->uid()); }) );
+		BOOST_CHECK( wait_until([&]() { return (bool) ib2->get(iu->uid()); }) );
+	}
+	std::map<std::string, mode_t> segments = shm_segments("ipaaca-" + channel + "_");
+	// one ring for the category, none per InputBuffer
+	BOOST_CHECK( segments.size() == 1 );
+	for (auto& kv: segments) {
+		BOOST_CHECK( kv.second == 0600 );
+		shm_unlink(("/" + kv.first).c_str());
+	}
+}
+
+BOOST_AUTO_TEST_CASE( testIpaacaCppAsyncPublish )
+{
+	ScopedOption loopback(ipaaca::__ipaaca_static_option_loopback, "on");
+	EventRecorder recorder;
+	ipaaca::InputBuffer::ptr ib = ipaaca::InputBuffer::create("AsyncPublishReceiver", "cppAsyncPublishCategory");
+	ib->register_handler(boost::bind(&EventRecorder::handle, &recorder, _1, _2, _3));
+	ipaaca::OutputBuffer::ptr ob = ipaaca::OutputBuffer::create(ipaaca::BufferConfiguration("AsyncPublishSender").set_async_publish(true));
+	ipaaca::IU::ptr iu = ipaaca::IU::create("cppAsyncPublishCategory");
+	iu->payload()["n"] = 0;
+	ob->add(iu);
+	for (long i = 1; i < 10; ++i) {
+		iu->payload()["n"] = i; // each update is sent with the state at the time of the call
+	}
+	ob->flush();
+	BOOST_REQUIRE( wait_until([&]() { return recorder.values().size() == 10; }) );
+	std::vector<long> values = recorder.values();
+	for (long i = 0; i < 10; ++i) {
+		BOOST_CHECK( values[i] == i );
+	}
+}
+
+BOOST_AUTO_TEST_CASE( testIpaacaCppEventBatching )
+{
+	// shm without loopback: frames are serialized and unpacked within this process
+	ScopedOption transport(ipaaca::__ipaaca_static_option_rsb_transport, "shm");
+	ScopedOption loopback(ipaaca::__ipaaca_static_option_loopback, "off");
+	const std::string channel = "cppBatch" + ipaaca::generate_uuid_string().substr(0, 8);
+	{
+		EventRecorder recorder;
+		ipaaca::InputBuffer::ptr ib = ipaaca::InputBuffer::create(ipaaca::BufferConfiguration("BatchReceiver").set_channel(channel).add_category_interest("cppBatchCategory"));
+		ib->register_handler(boost::bind(&EventRecorder::handle, &recorder, _1, _2, _3));
+		// (window long enough that only flush() sends the frame)
+		ipaaca::OutputBuffer::ptr ob = ipaaca::OutputBuffer::create(ipaaca::BufferConfiguration("BatchSender").set_channel(channel).set_batch_window_ms(60000));
+		ipaaca::IU::ptr iu = ipaaca::IU::create("cppBatchCategory");
+		iu->payload()["n"] = 0;
+		ob->add(iu);
+		for (long i = 1; i < 10; ++i) {
+			iu->payload()["n"] = i;
+		}
+		BOOST_CHECK( ! wait_until([&]() { return recorder.values().size() > 0; }, 200) );
+		ob->flush();
+		BOOST_REQUIRE( wait_until([&]() { return recorder.values().size() == 10; }) );
+		std::vector<long> values = recorder.values();
+		for (long i = 0; i < 10; ++i) {
+			BOOST_CHECK( values[i] == i );
+		}
+	}
+	for (auto& kv: shm_segments("ipaaca-" + channel + "_")) {
+		shm_unlink(("/" + kv.first).c_str());
+	}
+}
+
+BOOST_AUTO_TEST_CASE( testIpaacaCppAsyncWrites )
+{
+	ScopedOption loopback(ipaaca::__ipaaca_static_option_loopback, "on");
+	ipaaca::OutputBuffer::ptr ob = ipaaca::OutputBuffer::create("AsyncWriteOwner");
+	ipaaca::InputBuffer::ptr ib = ipaaca::InputBuffer::create("AsyncWriter", "cppAsyncWriteCategory");
+	// holds the receiver thread on an update carrying "hold", so later owner updates stay queued
+	std::atomic<bool> holding(false), released(false);
+	ib->register_handler([&](ipaaca::IUInterface::ptr iu, ipaaca::IUEventType event_type, bool local) {
+		if ((event_type == IU_UPDATED) && ((std::string) iu->payload()["hold"] == "yes")) {
+			holding = true;
+			wait_until([&]() { return (bool) released; });
+		}
+	});
+	ipaaca::IU::ptr iu = ipaaca::IU::create("cppAsyncWriteCategory");
+	ob->add(iu);
+	BOOST_REQUIRE( wait_until([&]() { return (bool) ib->get(iu->uid()); }) );
+	boost::shared_ptr<ipaaca::RemotePushIU> remote = boost::static_pointer_cast<ipaaca::RemotePushIU>(ib->get(iu->uid()));
+	remote->set_async_writes(true);
+	for (long i = 0; i < 5; ++i) {
+		remote->payload()["n"] = i;
+	}
+	remote->wait_for_writes();
+	BOOST_CHECK( (long) iu->payload()["n"] == 4 );
+	BOOST_CHECK( remote->last_write().get() == iu->revision() );
+	// the owner changes the IU, the writer has not seen it yet: its next write is out of date
+	iu->payload()["hold"] = "yes";
+	BOOST_REQUIRE( wait_until([&]() { return (bool) holding; }) );
+	iu->payload()["n"] = 10;
+	remote->payload()["n"] = 20;
+	BOOST_CHECK_THROW( remote->last_write().get(), ipaaca::IUUpdateFailedError );
+	BOOST_CHECK_THROW( remote->wait_for_writes(), ipaaca::IUUpdateFailedError );
+	BOOST_CHECK( (long) iu->payload()["n"] == 10 );
+	released = true;
+	BOOST_CHECK( wait_until([&]() { return remote->revision() == iu->revision(); }) );
+}
+
+BOOST_AUTO_TEST_CASE( testIpaacaCppPipelinedWrites )
+{
+	// over RSB, so that several writes are really in flight at the same time
+	ScopedOption loopback(ipaaca::__ipaaca_static_option_loopback, "off");
+	const std::string channel = "cppPipeline" + ipaaca::generate_uuid_string().substr(0, 8);
+	ipaaca::OutputBuffer::ptr ob = ipaaca::OutputBuffer::create(ipaaca::BufferConfiguration("PipelineOwner").set_channel(channel));
+	ipaaca::InputBuffer::ptr ib = ipaaca::InputBuffer::create(ipaaca::BufferConfiguration("PipelineWriter").set_channel(channel).add_category_interest("cppPipelineCategory"));
+	// the owner answers the write carrying "hold" only after the writer has sent the next one
+	std::atomic<bool> owner_changes(false), next_sent(false);
+	ob->register_handler([&](ipaaca::IUInterface::ptr iu, ipaaca::IUEventType event_type, bool local) {
+		if ((event_type == IU_UPDATED) && ((std::string) iu->payload()["hold"] == "yes")) {
+			if (owner_changes) iu->payload()["owner"] = "changed";
+			wait_until([&]() { return (bool) next_sent; });
+		}
+	});
+	ipaaca::IU::ptr iu = ipaaca::IU::create("cppPipelineCategory");
+	ob->add(iu);
+	BOOST_REQUIRE( wait_until([&]() { return (bool) ib->get(iu->uid()); }) );
+	boost::shared_ptr<ipaaca::RemotePushIU> remote = boost::static_pointer_cast<ipaaca::RemotePushIU>(ib->get(iu->uid()));
+	remote->set_async_writes(true);
+	// pipelined writes with removals, merges and links all pass their revision check
+	remote->payload()["hold"] = "yes";
+	remote->payload()["a"] = 1;
+	remote->payload().remove("a");
+	remote->add_link("grin", "IU-x");
+	next_sent = true;
+	remote->wait_for_writes();
+	BOOST_CHECK( iu->payload().view()["a"].is_null() );
+	BOOST_CHECK( iu->get_links("grin").size() == 1 );
+	BOOST_CHECK( remote->revision() == iu->revision() );
+	// the owner changes the IU while the next write is in flight: that write is rejected
+	owner_changes = true;
+	next_sent = false;
+	remote->payload()["hold"] = "yes";
+	remote->payload()["b"] = 2;
+	next_sent = true;
+	BOOST_CHECK_THROW( remote->wait_for_writes(), ipaaca::IUUpdateFailedError );
+	BOOST_CHECK( (std::string) iu->payload()["owner"] == "changed" );
+	BOOST_CHECK( iu->payload().view()["b"].is_null() );
+}
+
+BOOST_AUTO_TEST_CASE( testIpaacaCppRemoteWriteBatch )
+{
+	ScopedOption loopback(ipaaca::__ipaaca_static_option_loopback, "on");
+	ipaaca::OutputBuffer::ptr ob = ipaaca::OutputBuffer::create("WriteBatchOwner");
+	ipaaca::InputBuffer::ptr ib = ipaaca::InputBuffer::create("WriteBatchWriter", "cppWriteBatchCategory");
+	ipaaca::IU::ptr a = ipaaca::IU::create("cppWriteBatchCategory");
+	ipaaca::IU::ptr b = ipaaca::IU::create("cppWriteBatchCategory");
+	ob->add(a);
+	ob->add(b);
+	BOOST_REQUIRE( wait_until([&]() { return ib->get(a->uid()) && ib->get(b->uid()); }) );
+	boost::shared_ptr<ipaaca::RemotePushIU> remote_a = boost::static_pointer_cast<ipaaca::RemotePushIU>(ib->get(a->uid()));
+	boost::shared_ptr<ipaaca::RemotePushIU> remote_b = boost::static_pointer_cast<ipaaca::RemotePushIU>(ib->get(b->uid()));
+	ipaaca::revision_t revision_a = a->revision();
+	ib->begin_remote_write_batch();
+	remote_a->payload()["n"] = 1;
+	remote_b->payload()["n"] = 2;
+	remote_b->commit(); // (does not wait for the flush)
+	BOOST_CHECK( a->revision() == revision_a );
+	BOOST_CHECK( ! b->committed() );
+	BOOST_CHECK( ib->flush_remote_write_batch() == 0 );
+	BOOST_CHECK( (long) a->payload()["n"] == 1 );
+	BOOST_CHECK( (long) b->payload()["n"] == 2 );
+	BOOST_CHECK( b->committed() );
+	remote_a->wait_for_writes();
+	remote_b->wait_for_writes();
+	// a batched write that is out of date by the time of the flush fails on its own
+	ib->begin_remote_write_batch();
+	remote_a->payload()["n"] = 3;
+	a->payload()["n"] = 10;
+	BOOST_CHECK( ib->flush_remote_write_batch() == 1 );
+	BOOST_CHECK_THROW( remote_a->last_write().get(), ipaaca::IUUpdateFailedError );
+	BOOST_CHECK_THROW( remote_a->wait_for_writes(), ipaaca::IUUpdateFailedError );
+	BOOST_CHECK( (long) a->payload()["n"] == 10 );
+}
+
+BOOST_AUTO_TEST_CASE( testIpaacaCppBinaryPayload )
+{
+	const char* samples[] = {
+		"null", "[1.5, 2.25, -3.0e10]", "\"\"",
+		"{\"a\": [1, -2, 3000000000, 18446744073709551615], \"b\": \"text\", \"c\": {\"d\": [1.0, \"s\", null, false]}}"
+	};
+	for (const char* sample: samples) {
+		ipaaca::PayloadDocumentEntry::ptr entry = ipaaca::PayloadDocumentEntry::from_json_string_representation(sample);
+		std::string binary = entry->to_binary_representation();
+		ipaaca::PayloadDocumentEntry::ptr decoded = ipaaca::PayloadDocumentEntry::from_binary_representation(binary);
+		BOOST_CHECK( decoded->to_json_string_representation() == entry->to_json_string_representation() );
+		BOOST_CHECK_THROW( ipaaca::PayloadDocumentEntry::from_binary_representation(binary.substr(0, binary.size()-1)), ipaaca::BinaryPayloadError );
+	}
+}
+
+BOOST_AUTO_TEST_CASE( testIpaacaCppResendDuringWrites )
+{
+	// resends serialize the live IU (and fill its wire cache) on the server thread while the owner writes to it
+	ScopedOption loopback(ipaaca::__ipaaca_static_option_loopback, "off");
+	const std::string channel = "cppResend" + ipaaca::generate_uuid_string().substr(0, 8);
+	ipaaca::OutputBuffer::ptr ob = ipaaca::OutputBuffer::create(ipaaca::BufferConfiguration("ResendSender").set_channel(channel));
+	ipaaca::IU::ptr iu = ipaaca::IU::create("cppResendCategory");
+	iu->payload()["n"] = 0;
+	ob->add(iu);
+	const revision_t base = iu->revision(); // every write below increases the revision by one
+	boost::mutex mutex;
+	long resent = 0;
+	long mismatches = 0;
+	auto check = [&](ipaaca::IUInterface::ptr received, ipaaca::IUEventType event_type, bool local) {
+		if (event_type != IU_ADDED) return;
+		boost::mutex::scoped_lock lock(mutex);
+		resent++;
+		if (base + (long) received->payload()["n"] != received->revision()) mismatches++;
+	};
+	std::vector<ipaaca::InputBuffer::ptr> late_joiners;
+	for (long i = 1; i <= 2000; ++i) {
+		iu->payload()["n"] = i;
+		if (i % 200 == 100) {
+			// misses the IU, requests a resend on the next update
+			ipaaca::InputBuffer::ptr ib = ipaaca::InputBuffer::create(ipaaca::BufferConfiguration("ResendReceiver").set_channel(channel).add_category_interest("cppResendCategory"));
+			ib->set_resend(true);
+			ib->register_handler(check);
+			late_joiners.push_back(ib);
+		}
+	}
+	BOOST_REQUIRE( wait_until([&]() { boost::mutex::scoped_lock lock(mutex); return resent == (long) late_joiners.size(); }) );
+	BOOST_CHECK( mismatches == 0 );
+	for (auto& ib: late_joiners) {
+		BOOST_CHECK( wait_until([&]() { return ib->get(iu->uid())->revision() == iu->revision(); }) );
+		BOOST_CHECK( (long) ib->get(iu->uid())->payload()["n"] == 2000 );
+	}
+}
+
+BOOST_AUTO_TEST_CASE( testIpaacaCppInternedString )
+{
+	size_t table_size = ipaaca::InternedString::table_size();
+	{
+		ipaaca::InternedString a(std::string("cppInternedTestString"));
+		ipaaca::InternedString b("cppInternedTestString");
+		BOOST_CHECK( a == b );
+		BOOST_CHECK( a.str() == "cppInternedTestString" );
+		BOOST_CHECK( ipaaca::InternedString::table_size() == table_size + 1 );
+		ipaaca::OutputBuffer::ptr ob = ipaaca::OutputBuffer::create("InternedOwner");
+		ipaaca::IU::ptr iu = ipaaca::IU::create("cppInternedCategory");
+		ob->add(iu);
+		BOOST_CHECK( iu->owner_name() == ob->unique_name() );
+		BOOST_CHECK( ipaaca::InternedString::table_size() > table_size + 1 );
+	}
+	// owner name, category etc. leave the table with their last handle
+	BOOST_CHECK( wait_until([&]() { return ipaaca::InternedString::table_size() == table_size; }) );
+}
+
+BOOST_AUTO_TEST_CASE( testIpaacaCppIUId )
+{
+	std::string uuid = ipaaca::generate_uuid_string();
+	BOOST_CHECK( ipaaca::IUId(uuid).to_string() == uuid );
+	BOOST_CHECK( ipaaca::IUId("not-a-uuid") == ipaaca::IUId("not-a-uuid") );
+	BOOST_CHECK( ipaaca::IUId("not-a-uuid") != ipaaca::IUId("not-a-uuid2") );
+	std::string upper = uuid;
+	std::transform(upper.begin(), upper.end(), upper.begin(), ::toupper);
+	ipaaca::IUId parsed;
+	BOOST_CHECK( ! ipaaca::IUId::parse(upper, parsed) );
+	BOOST_CHECK( ipaaca::IUId(upper) != ipaaca::IUId(uuid) ); // (different UID strings)
+	std::string previous_mode = ipaaca::__ipaaca_static_option_uid_mode;
+	ipaaca::__ipaaca_static_option_uid_mode = "counter";
+	ipaaca::IU::ptr iu1 = ipaaca::IU::create("testcategory");
+	ipaaca::IU::ptr iu2 = ipaaca::IU::create("testcategory");
+	ipaaca::__ipaaca_static_option_uid_mode = previous_mode;
+	BOOST_CHECK( iu1->binary_uid() != iu2->binary_uid() );
+	BOOST_CHECK( ipaaca::IUId(iu2->uid()) == iu2->binary_uid() );
+}
+
+BOOST_AUTO_TEST_CASE( testIpaacaCppPayloadPatch )
+{
+	ipaaca::PayloadDocumentEntry::ptr base = ipaaca::PayloadDocumentEntry::from_json_string_representation("{\"a/b\": [1, 2], \"c\": {\"d\": 1}}");
+	ipaaca::PayloadDocumentEntry::ptr patch = ipaaca::PayloadDocumentEntry::from_unresolved_patch(
+			"[{\"op\": \"replace\", \"path\": \"/a~1b/0\", \"value\": 10}, {\"op\": \"add\", \"path\": \"/a~1b/-\", \"value\": 3}, {\"op\": \"add\", \"path\": \"/c/e\", \"value\": \"x\"}]",
+			base->entry_id, 42);
+	ipaaca::PayloadDocumentEntry::ptr resolved = patch->resolve_patch(base);
+	BOOST_CHECK( resolved->to_json_string_representation() == "{\"a/b\":[10,2,3],\"c\":{\"d\":1,\"e\":\"x\"}}" );
+	BOOST_CHECK( resolved->entry_id == 42 );
+	BOOST_CHECK( base->to_json_string_representation() == "{\"a/b\":[1,2],\"c\":{\"d\":1}}" );
+	BOOST_CHECK_THROW( patch->resolve_patch(resolved), ipaaca::PayloadPatchError );
+}
+
+BOOST_AUTO_TEST_CASE( testIpaacaCppReplaceAllDelta )
+{
+	ScopedOption loopback(ipaaca::__ipaaca_static_option_loopback, "on");
+	ipaaca::OutputBuffer::ptr ob = ipaaca::OutputBuffer::create("ReplaceAllOwner");
+	ipaaca::InputBuffer::ptr ib = ipaaca::InputBuffer::create("ReplaceAllReceiver", "cppReplaceAllCategory");
+	std::atomic<long> updates(0);
+	ib->register_handler([&](ipaaca::IUInterface::ptr iu, ipaaca::IUEventType event_type, bool local) {
+		if (event_type == IU_UPDATED) updates++;
+	});
+	std::map<std::string, std::string> contents { {"a", "1"}, {"b", "2"}, {"c", "3"}, {"d", "4"} };
+	ipaaca::IU::ptr iu = ipaaca::IU::create("cppReplaceAllCategory");
+	iu->payload().set(contents);
+	ob->add(iu);
+	BOOST_REQUIRE( wait_until([&]() { return (bool) ib->get(iu->uid()); }) );
+	ipaaca::IUInterface::ptr remote = ib->get(iu->uid());
+	// the view keeps the received entries alive: an entry at the same address later is the same entry (same entry_id)
+	ipaaca::PayloadView received = remote->payload().view();
+	// one changed key: sent as a delta, the receiver keeps the other entries
+	contents["c"] = "30";
+	iu->payload().set(contents);
+	BOOST_REQUIRE( wait_until([&]() { return (updates == 1) && (remote->revision() == iu->revision()); }) );
+	ipaaca::PayloadView updated = remote->payload().view();
+	BOOST_CHECK( updated["a"].json_value() == received["a"].json_value() );
+	BOOST_CHECK( updated["b"].json_value() == received["b"].json_value() );
+	BOOST_CHECK( updated["d"].json_value() == received["d"].json_value() );
+	BOOST_CHECK( updated["c"].json_value() != received["c"].json_value() );
+	BOOST_CHECK( updated["c"].as<std::string>() == "30" );
+	// in a batch, re-setting the payload revokes the earlier removal of a key it contains
+	{
+		ipaaca::Locker locker(iu->payload());
+		iu->payload().remove("b");
+		contents["d"] = "40";
+		iu->payload().set(contents);
+	}
+	BOOST_REQUIRE( wait_until([&]() { return (updates == 2) && (remote->revision() == iu->revision()); }) );
+	ipaaca::PayloadView batched = remote->payload().view();
+	BOOST_CHECK( batched["a"].json_value() == received["a"].json_value() );
+	BOOST_CHECK( batched["b"].json_value() == received["b"].json_value() );
+	BOOST_CHECK( batched["d"].as<std::string>() == "40" );
+}
+
+BOOST_AUTO_TEST_CASE( testIpaacaCppBatchAppend )
+{
+	ipaaca::IU::ptr iu = ipaaca::IU::create("testcategory");
+	iu->payload()["words"] = std::vector<std::string>{"a"};
+	{
+		ipaaca::Locker locker(iu->payload());
+		for (long i = 0; i < 100; ++i) {
+			iu->payload()["words"].push_back(i);
+		}
+		iu->payload()["words"][0] = "b";
+	}
+	BOOST_CHECK( iu->payload()["words"].size() == 101 );
+	BOOST_CHECK( (std::string) iu->payload()["words"][0] == "b" );
+	BOOST_CHECK( (long) iu->payload()["words"][100] == 99 );
+}
+
+BOOST_AUTO_TEST_CASE( testIpaacaCppBatchAppendChildProxy )
+{
+	ipaaca::IU::ptr iu = ipaaca::IU::create("testcategory");
+	iu->payload()["words"] = std::vector<std::string>{"a"};
+	{
+		ipaaca::Locker locker(iu->payload());
+		iu->payload()["words"].push_back("b");
+		auto words = iu->payload()["words"];
+		auto first = words[0];
+		for (long i = 0; i < 100; ++i) {
+			iu->payload()["words"].push_back(i); // (must not move the value first refers to)
+		}
+		BOOST_CHECK( (std::string) first == "a" );
+		BOOST_CHECK( first.view().as<std::string>() == "a" );
+	}
+	BOOST_CHECK( iu->payload()["words"].size() == 102 );
+	BOOST_CHECK( (std::string) iu->payload()["words"][1] == "b" );
+}
+
+BOOST_AUTO_TEST_CASE( testIpaacaCppPayloadPath )
+{
+	ipaaca::IU::ptr iu = ipaaca::IU::create("testcategory");
+	iu->payload()["a"] = std::map<std::string, std::vector<long> > { {"b/c", {1, 2}} };
+	ipaaca::PayloadPath path("/a/b~1c/1");
+	BOOST_CHECK( iu->payload().get<long>(path) == 2 );
+	iu->payload().set(path, 5);
+	BOOST_CHECK( (long) iu->payload()["a"]["b/c"][1] == 5 );
+	iu->payload().set(ipaaca::PayloadPath("/a/b~1c/-"), 7);
+	BOOST_CHECK( iu->payload()["a"]["b/c"].size() == 3 );
+	BOOST_CHECK( ! iu->payload().has(ipaaca::PayloadPath("/a/x")) );
+	BOOST_CHECK_THROW( iu->payload().set(ipaaca::PayloadPath("/a/x/y"), 1), ipaaca::PayloadAddressingError );
+}
+
+BOOST_AUTO_TEST_CASE( testIpaacaCppPayloadSnapshot )
+{
+	ipaaca::IU::ptr iu = ipaaca::IU::create("testcategory");
+	iu->payload()["a"] = 1;
+	iu->payload()["b"] = 2;
+	std::vector<std::string> keys;
+	for (auto it = iu->payload().begin(); it != iu->payload().end(); ++it) {
+		keys.push_back(it->first);
+		iu->payload()["c" + it->first] = 3; // iteration continues over the state before the writes
+	}
+	BOOST_CHECK( keys.size() == 2 );
+	BOOST_CHECK( (long) iu->payload()["cb"] == 3 );
+}
+
+BOOST_AUTO_TEST_CASE( testIpaacaCppPayloadView )
+{
+	ipaaca::IU::ptr iu = ipaaca::IU::create("testcategory");
+	iu->payload()["list"] = std::vector<double> { 1.0, 2.0, 3.0 };
+	iu->payload()["map"] = std::map<std::string, std::string> { {"x", "y"} };
+	double sum = 0.0;
+	std::string members;
+	for (auto item: iu->payload().view()) {
+		for (auto v: item.value().elements()) sum += v.as<double>();
+		for (auto m: item.value().members()) members += std::string(m.key()) + "=" + m.value().as<std::string>();
+	}
+	BOOST_CHECK( sum == 6.0 );
+	BOOST_CHECK( members == "x=y" );
+	BOOST_CHECK( iu->payload().view()["list"][0].as<double>() == 1.0 );
+	BOOST_CHECK( iu->payload().view()["missing"]["a"].is_null() );
+}
+
+BOOST_AUTO_TEST_CASE( testIpaacaCppInputBufferRetention )
+{
+	ScopedOption loopback(ipaaca::__ipaaca_static_option_loopback, "on");
+	ipaaca::OutputBuffer::ptr ob = ipaaca::OutputBuffer::create("RetentionSender");
+	ipaaca::InputBuffer::ptr ib = ipaaca::InputBuffer::create(ipaaca::BufferConfiguration("RetentionReceiver").add_category_interest("cppRetentionCategory").set_retention_max_ius(2));
+	std::vector<ipaaca::IU::ptr> ius;
+	for (int i = 0; i < 5; ++i) {
+		ipaaca::IU::ptr iu = ipaaca::IU::create("cppRetentionCategory");
+		iu->payload()["n"] = i;
+		ob->add(iu);
+		ius.push_back(iu);
+	}
+	BOOST_REQUIRE( wait_until([&]() { return (bool) ib->get(ius[4]->uid()); }) );
+	BOOST_CHECK( ib->retained_iu_count() == 2 );
+	BOOST_CHECK( ! ib->get(ius[0]->uid()) );
+	ius[0]->payload()["n"] = 10; // update of an evicted IU: ignored
+	ius[4]->payload()["n"] = 14; // (handled after the one above)
+	BOOST_CHECK( wait_until([&]() { return (long) ib->get(ius[4]->uid())->payload()["n"] == 14; }) );
+	BOOST_CHECK( ib->retained_iu_count() == 2 );
+	BOOST_CHECK( ! ib->get(ius[0]->uid()) );
+}
+
+BOOST_AUTO_TEST_CASE( testIpaacaCppOutputBufferRetirement )
+{
+	ScopedOption loopback(ipaaca::__ipaaca_static_option_loopback, "on");
+	ipaaca::InputBuffer::ptr ib = ipaaca::InputBuffer::create("RetirementReceiver", "cppRetirementCategory");
+	ipaaca::OutputBuffer::ptr ob = ipaaca::OutputBuffer::create(ipaaca::BufferConfiguration("RetirementSender").set_retire_after_commit_ms(100));
+	for (int i = 0; i < 3; ++i) {
+		ipaaca::IU::ptr iu = ipaaca::IU::create("cppRetirementCategory");
+		ob->add(iu);
+		iu->commit();
+	}
+	ipaaca::IU::ptr open_iu = ipaaca::IU::create("cppRetirementCategory");
+	ob->add(open_iu);
+	BOOST_CHECK( wait_until([&]() { return ob->get_ius().size() == 1; }) );
+	BOOST_CHECK( ob->get(open_iu->uid()) );
+	BOOST_CHECK( wait_until([&]() {
+		long retracted = 0;
+		for (auto& iu: ib->get_ius()) {
+			if (iu->retracted()) retracted++;
+		}
+		return retracted == 3;
+	}) );
+}
+
+BOOST_AUTO_TEST_CASE( testIpaacaCppOutputBufferInactivityRetirement )
+{
+	ipaaca::OutputBuffer::ptr ob = ipaaca::OutputBuffer::create(ipaaca::BufferConfiguration("InactivitySender").set_retire_after_inactivity_ms(200));
+	ipaaca::IU::ptr active = ipaaca::IU::create("cppInactivityCategory");
+	ipaaca::IU::ptr idle = ipaaca::IU::create("cppInactivityCategory");
+	ob->add(active);
+	ob->add(idle);
+	for (long i = 0; i < 10; ++i) {
+		boost::this_thread::sleep(boost::posix_time::milliseconds(50));
+		active->payload()["n"] = i; // (restarts the inactivity period)
+	}
+	BOOST_CHECK( ob->get(active->uid()) );
+	BOOST_CHECK( ! ob->get(idle->uid()) );
+	BOOST_CHECK( idle->retracted() );
+	BOOST_CHECK( wait_until([&]() { return ! ob->get(active->uid()); }) );
+}
+
+BOOST_AUTO_TEST_CASE( testIpaacaCppShardedIUStore )
+{
+	ipaaca::ShardedIUStore<long> store;
+	std::atomic<long> mismatches(0); // (BOOST_CHECK is not thread-safe)
+	std::vector<boost::thread> threads;
+	for (long t = 0; t < 4; ++t) {
+		threads.push_back(boost::thread([&store, &mismatches, t]() {
+			for (long i = 0; i < 1000; ++i) {
+				ipaaca::IUId uid(t, i);
+				store.insert(uid, boost::shared_ptr<long>(new long(i)));
+				if (*store.find(uid) != i) mismatches++;
+				if (i % 2) store.erase(uid);
+			}
+		}));
+	}
+	for (auto& thread: threads) thread.join();
+	BOOST_CHECK( mismatches == 0 );
+	BOOST_CHECK( store.size() == 2000 );
+	BOOST_CHECK( ! store.insert(ipaaca::IUId(0, 0), boost::shared_ptr<long>(new long(1))) );
+	BOOST_CHECK( ! store.find(ipaaca::IUId(0, 1)) );
+}
+
+BOOST_AUTO_TEST_CASE( testIpaacaCppBufferQueries )
+{
+	ipaaca::OutputBuffer::ptr ob = ipaaca::OutputBuffer::create("QuerySender");
+	ipaaca::IU::ptr a = ipaaca::IU::create("cppQueryA");
+	ipaaca::IU::ptr b = ipaaca::IU::create("cppQueryB");
+	ipaaca::IU::ptr c = ipaaca::IU::create("cppQueryB");
+	ob->add(a);
+	ob->add(b);
+	ob->add(c);
+	ipaaca::IUQueryResult result = ob->query_category("cppQueryB");
+	BOOST_CHECK( result.size() == 2 );
+	BOOST_CHECK( ob->query_category("cppQueryA")[0] == a );
+	BOOST_CHECK( ob->query_owner(ob->unique_name()).size() == 3 );
+	b->add_link("grounded_in", a->uid());
+	b->commit();
+	BOOST_CHECK( ob->query_linking_to(a->uid()).size() == 1 );
+	BOOST_CHECK( ob->query_state(ipaaca::IU_STATE_COMMITTED)[0] == b );
+	BOOST_CHECK( ob->query_state(ipaaca::IU_STATE_OPEN).size() == 2 );
+	ob->remove(c);
+	BOOST_CHECK( ob->query_category("cppQueryB").size() == 1 );
+	BOOST_CHECK( result.size() == 2 ); // (snapshot)
+	BOOST_CHECK( ob->query_all().size() == 2 );
+	ipaaca::IUQueryResult all = ob->query_all();
+	BOOST_CHECK( &all[0] == &ob->query_all()[0] ); // (shared, not copied)
+}
+
+BOOST_AUTO_TEST_CASE( testIpaacaCppReverseLinkClosure )
+{
+	ipaaca::OutputBuffer::ptr ob = ipaaca::OutputBuffer::create("LinkClosureSender");
+	std::vector<ipaaca::IU::ptr> chain;
+	for (int i = 0; i < 4; ++i) {
+		chain.push_back(ipaaca::IU::create("cppLinkClosure"));
+		ob->add(chain.back());
+		if (i > 0) chain[i]->add_link("grounded_in", chain[i-1]->uid());
+	}
+	chain[0]->add_link("grounded_in", chain[3]->uid()); // (cycle)
+	ipaaca::IU::ptr other = ipaaca::IU::create("cppLinkClosure");
+	ob->add(other);
+	other->add_link("related", chain[1]->uid());
+	BOOST_CHECK( ob->query_linking_to(chain[1]->uid(), "grounded_in").size() == 1 );
+	BOOST_CHECK( ob->query_linking_to(chain[1]->uid()).size() == 2 );
+	ipaaca::IUQueryResult closure = ob->query_linking_to_closure(chain[1]->uid(), "grounded_in", 2);
+	BOOST_CHECK( closure.size() == 2 );
+	BOOST_CHECK( closure[0] == chain[2] );
+	BOOST_CHECK( closure[1] == chain[3] );
+	BOOST_CHECK( ob->query_linking_to_closure(chain[1]->uid(), "grounded_in", 10).size() == 3 );
+	BOOST_CHECK( ob->query_linking_to_closure(chain[1]->uid(), "", 1).size() == 2 );
+	chain[2]->remove_link("grounded_in", chain[1]->uid());
+	BOOST_CHECK( ob->query_linking_to_closure(chain[1]->uid(), "grounded_in", 10).size() == 0 );
+}
+
 BOOST_AUTO_TEST_SUITE_END( )
 